@@ -8,5 +8,8 @@ void main() {
 
   texcoords = vertTex;
 
-  gl_Position = P * V * M * vec4(vertTex, 1.0);
-}
\ No newline at end of file
+  // Rotation only, so the sky stays infinitely far away, and z = w, so it
+  // lands exactly on the far plane
+  vec4 pos = P * mat4(mat3(V)) * M * vec4(vertTex, 1.0);
+  gl_Position = pos.xyww;
+}
@@ -0,0 +1,13 @@
+#version 330 core
+in vec2 vTexCoord;
+in vec4 vColor;
+
+// Glyph coverage in red; one cell is solid, for plain quads
+uniform sampler2D font;
+
+out vec4 color;
+
+void main()
+{
+	color = vec4(vColor.rgb, vColor.a * texture(font, vTexCoord).r);
+}
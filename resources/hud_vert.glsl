@@ -0,0 +1,18 @@
+#version 330 core
+layout(location = 0) in vec2 vertPos;
+layout(location = 1) in vec2 vertTex;
+layout(location = 2) in vec4 vertColor;
+
+// Window size in pixels; vertPos is in pixels from the top left
+uniform vec2 screenSize;
+
+out vec2 vTexCoord;
+out vec4 vColor;
+
+void main()
+{
+	vec2 ndc = vertPos / screenSize * 2.0 - 1.0;
+	gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+	vTexCoord = vertTex;
+	vColor = vertColor;
+}
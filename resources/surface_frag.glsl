@@ -0,0 +1,131 @@
+#version 330 core
+// See surface_vert.glsl for the feature flags.
+
+#ifdef TEXTURED
+uniform sampler2D Texture0;
+in vec2 vTexCoord;
+#endif
+uniform vec3 MatDif;
+#ifdef LIT
+in vec3 vNor;
+in vec3 vPos;
+uniform vec3 MatAmb;
+uniform vec3 MatSpec;
+uniform float shine;
+
+// Filled by LightSet, in view space (see LightSet.h and LightClusters.h)
+layout(std140) uniform Lights
+{
+	// x: directional lights, which come first in LightData
+	ivec4 lightCounts;
+	// Clusters in x, y and depth
+	ivec4 clusterGrid;
+	// xy: clusters per pixel; depth d is in slice log(d) * z + w
+	vec4 clusterScale;
+};
+// Two texels per light: position (w 1) or direction towards it (w 0), and
+// color with the range in a
+uniform samplerBuffer LightData;
+// Per cluster, the offset and length of its list in ClusterLights
+uniform usamplerBuffer ClusterCells;
+uniform usamplerBuffer ClusterLights;
+
+// Filled by ShadowMaps: cascades for one of the directional lights
+layout(std140) uniform Shadows
+{
+	// x: cascades, 0 for no shadows; y: the directional light they are for
+	ivec4 shadowParams;
+	// View depth each cascade ends at
+	vec4 cascadeEnds;
+	// View space to a cascade's texture coordinates and depth
+	mat4 shadowMatrices[4];
+};
+uniform sampler2DArrayShadow ShadowMap;
+
+// 1 lit, 0 in shadow, from the nearest cascade that covers this fragment
+float shadowFactor()
+{
+	float depth = -vPos.z;
+	int last = shadowParams.x - 1;
+	if (depth > cascadeEnds[last])
+	{
+		return 1.0;
+	}
+	int cascade = 0;
+	while (cascade < last && depth > cascadeEnds[cascade])
+	{
+		cascade++;
+	}
+	vec4 coord = shadowMatrices[cascade] * vec4(vPos, 1.0);
+	return texture(ShadowMap, vec4(coord.xy, float(cascade), min(coord.z, 1.0)));
+}
+
+// Blinn-Phong for one light
+vec3 shadeLight(int i, vec3 normal, vec3 cameraDir, vec3 diffuse)
+{
+	vec4 light = texelFetch(LightData, 2 * i);
+	vec4 lightColor = texelFetch(LightData, 2 * i + 1);
+	vec3 toLight = light.xyz - vPos * light.w;
+	float falloff = 1.0;
+	if (light.w != 0.0)
+	{
+		// Smooth to zero at the range
+		float x = min(dot(toLight, toLight) / (lightColor.a * lightColor.a), 1.0);
+		falloff = (1.0 - x) * (1.0 - x);
+	}
+	vec3 lightDir = normalize(toLight);
+	vec3 halfVector = normalize(lightDir + cameraDir);
+	float lambert = max(dot(normal, lightDir), 0.0);
+	float highlight = pow(max(dot(normal, halfVector), 0.0), shine);
+	return falloff * lightColor.rgb * (lambert * diffuse + highlight * MatSpec);
+}
+
+// Summed over the directional lights and the point lights of this
+// fragment's cluster
+vec3 shade(vec3 ambient, vec3 diffuse)
+{
+	vec3 normal = normalize(vNor);
+	// The camera is at the origin of view space
+	vec3 cameraDir = normalize(-vPos);
+	vec3 result = ambient;
+	for (int i = 0; i < lightCounts.x; i++)
+	{
+		vec3 lit = shadeLight(i, normal, cameraDir, diffuse);
+		if (i == shadowParams.y && shadowParams.x > 0)
+		{
+			lit *= shadowFactor();
+		}
+		result += lit;
+	}
+
+	ivec3 cluster = ivec3(vec3(gl_FragCoord.xy * clusterScale.xy, log(-vPos.z) * clusterScale.z + clusterScale.w));
+	cluster = clamp(cluster, ivec3(0), clusterGrid.xyz - 1);
+	uvec2 cell = texelFetch(ClusterCells, cluster.x + clusterGrid.x * (cluster.y + clusterGrid.y * cluster.z)).xy;
+	for (uint i = 0u; i < cell.y; i++)
+	{
+		result += shadeLight(int(texelFetch(ClusterLights, int(cell.x + i)).r), normal, cameraDir, diffuse);
+	}
+	return result;
+}
+#endif
+
+out vec4 color;
+
+void main()
+{
+#ifdef TEXTURED
+	vec4 texColor = texture(Texture0, vTexCoord);
+#ifdef LIT
+	// The texture tints the material
+	color = vec4(shade(MatAmb * texColor.rgb, MatDif * texColor.rgb), texColor.a);
+#else
+	color = vec4(texColor.rgb, 1.0);
+#endif
+
+#elif defined(LIT)
+	color = vec4(shade(MatAmb, MatDif), 1.0);
+
+#else
+	color = vec4(MatDif, 1.0);
+#endif
+}
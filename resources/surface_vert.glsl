@@ -0,0 +1,70 @@
+#version 330 core
+// One template for every mesh shader. ShaderVariants #defines the features a
+// variant has after the #version line: TEXTURED, LIT, INSTANCED, SKINNED.
+
+layout(location = 0) in vec3 vertPos;
+#ifdef LIT
+layout(location = 1) in vec3 vertNor;
+#endif
+#ifdef TEXTURED
+layout(location = 2) in vec2 vertTex;
+#endif
+#ifdef INSTANCED
+// Model matrix per instance, instead of M (locations 3-6)
+layout(location = 3) in mat4 instanceM;
+#endif
+#ifdef SKINNED
+layout(location = 7) in ivec4 vertBones;
+layout(location = 8) in vec4 vertWeights;
+uniform mat4 Bones[MAX_BONES];
+#endif
+
+uniform mat4 P;
+uniform mat4 V;
+#ifndef INSTANCED
+uniform mat4 M;
+#endif
+#if defined(LIT) && !defined(INSTANCED) && !defined(SKINNED)
+// Normal matrix, inverse transpose of V * M, from the CPU
+uniform mat3 N;
+#endif
+
+#ifdef TEXTURED
+out vec2 vTexCoord;
+#endif
+#ifdef LIT
+// View space, where the lights are
+out vec3 vNor;
+out vec3 vPos;
+#endif
+
+// Same position from every variant, so the depth pre-pass matches exactly
+invariant gl_Position;
+
+void main()
+{
+#ifdef INSTANCED
+	mat4 model = instanceM;
+#else
+	mat4 model = M;
+#endif
+#ifdef SKINNED
+	model = model * (vertWeights.x * Bones[vertBones.x] + vertWeights.y * Bones[vertBones.y] +
+		vertWeights.z * Bones[vertBones.z] + vertWeights.w * Bones[vertBones.w]);
+#endif
+	vec4 pos = V * model * vec4(vertPos, 1.0);
+	gl_Position = P * pos;
+
+#ifdef TEXTURED
+	vTexCoord = vertTex;
+#endif
+#ifdef LIT
+#if defined(INSTANCED) || defined(SKINNED)
+	// The model matrix is only known here
+	mat3 N = transpose(inverse(mat3(V * model)));
+#endif
+	// Normalized per fragment
+	vNor = N * vertNor;
+	vPos = pos.xyz;
+#endif
+}
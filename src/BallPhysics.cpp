@@ -0,0 +1,173 @@
+#include "BallPhysics.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace glm;
+
+// Bounces off solids within one step before the rest of the step is dropped
+static const int MAX_BOUNCES = 4;
+// Slower bounces off the ground than this just settle
+static const float SETTLE_SPEED = .5f;
+
+
+bool BallPhysics::sweep(const vec3 &start, const vec3 &displacement, float r, const vec3 &other, float otherR, float &t)
+{
+	vec3 m = start - other;
+	float b = dot(m, displacement);
+	if (b >= 0.f)
+	{
+		// Not getting any closer (this also lets a ball resting against a
+		// sphere leave it)
+		return false;
+	}
+	float reach = r + otherR;
+	float c = dot(m, m) - reach * reach;
+	if (c <= 0.f)
+	{
+		t = 0.f;
+		return true;
+	}
+	float a = dot(displacement, displacement);
+	float discriminant = b * b - a * c;
+	if (discriminant < 0.f)
+	{
+		return false;
+	}
+	t = (-b - std::sqrt(discriminant)) / a;
+	return t <= 1.f;
+}
+
+// Reflects the part of v that moves into a surface with normal n, which
+// itself moves at surfaceVelocity
+static void bounce(vec3 &v, const vec3 &n, const vec3 &surfaceVelocity, float restitution)
+{
+	float approach = dot(v - surfaceVelocity, n);
+	if (approach < 0.f)
+	{
+		v -= (1.f + restitution) * approach * n;
+	}
+}
+
+void BallPhysics::step(EntityStore &store, Entity ball, const std::vector<Obstacle> &obstacles, float dt, std::vector<Hit> &hits) const
+{
+	vec3 p = store.getPosition(ball);
+	vec3 v = store.getVelocity(ball);
+	float r = store.getRadius(ball);
+
+	// Forces
+	bool grounded = p.y <= params.groundY && v.y <= 0.f;
+	if (! grounded)
+	{
+		v.y -= params.gravity * dt;
+	}
+	v *= std::max(0.f, 1.f - params.drag * dt);
+	if (grounded)
+	{
+		float speed = std::sqrt(v.x * v.x + v.z * v.z);
+		float slowed = std::max(0.f, speed - params.rollingFriction * dt);
+		float scale = speed > 0.f ? slowed / speed : 0.f;
+		v = vec3(v.x * scale, 0.f, v.z * scale);
+	}
+	float speed = length(v);
+	if (speed > params.maxSpeed)
+	{
+		v *= params.maxSpeed / speed;
+	}
+
+	std::vector<bool> touched(obstacles.size(), false);
+	const size_t firstHit = hits.size();
+	auto report = [&](size_t k, float time)
+	{
+		if (! touched[k])
+		{
+			touched[k] = true;
+			Hit hit;
+			hit.entity = obstacles[k].entity;
+			hit.time = time;
+			hits.push_back(hit);
+		}
+	};
+
+	// Something may have moved into the ball since the last step (a running
+	// player); push the ball out of it first. A ball resting in a trigger
+	// still touches it.
+	for (size_t k = 0; k < obstacles.size(); k++)
+	{
+		vec3 c = store.getPosition(obstacles[k].entity);
+		float reach = r + store.getRadius(obstacles[k].entity);
+		vec3 d = p - c;
+		float distance = length(d);
+		if (! obstacles[k].solid)
+		{
+			if (distance <= reach)
+			{
+				report(k, 0.f);
+			}
+		}
+		else if (distance < reach)
+		{
+			vec3 n = distance > 0.f ? d / distance : vec3(0.f, 1.f, 0.f);
+			p = c + n * reach;
+			bounce(v, n, store.getVelocity(obstacles[k].entity), params.restitution);
+			report(k, 0.f);
+		}
+	}
+
+	// Sweep along the path, bouncing off the first solid in the way each time
+	float done = 0.f;
+	for (int i = 0; i < MAX_BOUNCES && done < 1.f; i++)
+	{
+		float remaining = 1.f - done;
+		vec3 displacement = v * (dt * remaining);
+
+		float first = 1.f;
+		int blocker = -1;
+		for (size_t k = 0; k < obstacles.size(); k++)
+		{
+			float t;
+			if (obstacles[k].solid && sweep(p, displacement, r, store.getPosition(obstacles[k].entity), store.getRadius(obstacles[k].entity), t) && t < first)
+			{
+				first = t;
+				blocker = (int) k;
+			}
+		}
+		for (size_t k = 0; k < obstacles.size(); k++)
+		{
+			float t;
+			if (! obstacles[k].solid && sweep(p, displacement, r, store.getPosition(obstacles[k].entity), store.getRadius(obstacles[k].entity), t) && t <= first)
+			{
+				report(k, done + t * remaining);
+			}
+		}
+
+		p += displacement * first;
+		if (blocker < 0)
+		{
+			break;
+		}
+		Entity e = obstacles[blocker].entity;
+		report(blocker, done + first * remaining);
+		bounce(v, normalize(p - store.getPosition(e)), store.getVelocity(e), params.restitution);
+		done += first * remaining;
+	}
+
+	// Ground
+	if (p.y < params.groundY)
+	{
+		p.y = params.groundY;
+		if (v.y < 0.f)
+		{
+			v.y = -v.y * params.restitution;
+			if (v.y < SETTLE_SPEED)
+			{
+				v.y = 0.f;
+			}
+		}
+	}
+
+	// Keep the hits in the order they happened
+	std::stable_sort(hits.begin() + firstHit, hits.end(), [](const Hit &a, const Hit &b) { return a.time < b.time; });
+
+	store.setPosition(ball, p);
+	store.setVelocity(ball, v);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef LAB471_BALLPHYSICS_H_INCLUDED
+#define LAB471_BALLPHYSICS_H_INCLUDED
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "EntityStore.h"
+
+
+/**
+ * Moves a ball by its velocity (EntityStore vel*) under gravity, air drag and
+ * rolling friction, bouncing off the ground and off solid spheres.
+ *
+ * The ball is swept along its path each step, so it can't tunnel through a
+ * sphere however fast it goes: it stops at the first sphere it would touch,
+ * bounces and carries on with the rest of the step. Triggers (the goals) are
+ * swept too but only reported.
+ *
+ * Other spheres are treated as immovable, with the velocity in their vel*
+ * components; a player running into the ball pushes it along.
+ *
+ * There is no randomness and everything runs in a fixed order, so the same
+ * steps from the same state give the same result (as long as the compiler
+ * isn't told to reorder float math, e.g. -ffast-math).
+ */
+class BallPhysics
+{
+
+public:
+
+	struct Params
+	{
+		float gravity = 9.8f;
+		// Fraction of its speed the ball loses per second to the air
+		float drag = .5f;
+		// Deceleration while rolling on the ground, units per second^2
+		float rollingFriction = 3.f;
+		// Fraction of the approach speed kept after a bounce
+		float restitution = .6f;
+		// Height of the ball's centre when it rests on the ground
+		float groundY = 0.f;
+		float maxSpeed = 30.f;
+	};
+
+	struct Obstacle
+	{
+		Entity entity;
+		// Bounced off if solid, only reported if not
+		bool solid = true;
+	};
+
+	struct Hit
+	{
+		Entity entity;
+		// When in the step the ball first touched it, 0 to 1
+		float time;
+	};
+
+	Params params;
+
+	// Advances ball by dt seconds against the obstacles and appends every
+	// obstacle it touched (solid or not) to hits
+	void step(EntityStore &store, Entity ball, const std::vector<Obstacle> &obstacles, float dt, std::vector<Hit> &hits) const;
+
+	// Earliest t in [0, 1] at which a sphere of radius r moving from start
+	// by displacement touches a still sphere of radius otherR at other.
+	// Returns false if it never does. Starting inside gives t = 0.
+	static bool sweep(const glm::vec3 &start, const glm::vec3 &displacement, float r, const glm::vec3 &other, float otherR, float &t);
+
+};
+
+#endif // LAB471_BALLPHYSICS_H_INCLUDED
@@ -0,0 +1,184 @@
+#include "BroadPhase.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace glm;
+
+static const uint32_t NONE = ~0u;
+
+
+BroadPhase::BroadPhase(const vec2 &minXZ, const vec2 &maxXZ, float cellSize)
+{
+	setGrid(minXZ, maxXZ, cellSize);
+}
+
+void BroadPhase::setGrid(const vec2 &minXZ, const vec2 &maxXZ, float cellSize)
+{
+	origin = minXZ;
+	invCellSize = 1.f / cellSize;
+	columns = std::max(1, (int) std::ceil((maxXZ.x - minXZ.x) * invCellSize));
+	rows = std::max(1, (int) std::ceil((maxXZ.y - minXZ.y) * invCellSize));
+	cells.assign(columns * rows, std::vector<uint32_t>());
+
+	// Re-file everything on the new grid
+	for (uint32_t p = 0; p < proxies.size(); p++)
+	{
+		proxies[p].cells = CellRange();
+	}
+}
+
+int BroadPhase::cellX(float x) const
+{
+	return std::min(std::max((int) std::floor((x - origin.x) * invCellSize), 0), columns - 1);
+}
+
+int BroadPhase::cellZ(float z) const
+{
+	return std::min(std::max((int) std::floor((z - origin.y) * invCellSize), 0), rows - 1);
+}
+
+void BroadPhase::add(Entity e)
+{
+	if (contains(e))
+	{
+		return;
+	}
+	if (e.index >= proxyOf.size())
+	{
+		proxyOf.resize(e.index + 1, NONE);
+	}
+	proxyOf[e.index] = (uint32_t) proxies.size();
+	Proxy proxy;
+	proxy.entity = e;
+	proxies.push_back(proxy);
+}
+
+void BroadPhase::remove(Entity e)
+{
+	if (contains(e))
+	{
+		removeProxy(proxyOf[e.index]);
+	}
+}
+
+bool BroadPhase::contains(Entity e) const
+{
+	return e.index < proxyOf.size() && proxyOf[e.index] != NONE && proxies[proxyOf[e.index]].entity == e;
+}
+
+void BroadPhase::insertCells(uint32_t proxy)
+{
+	const CellRange &r = proxies[proxy].cells;
+	for (int z = r.z0; z <= r.z1; z++)
+	{
+		for (int x = r.x0; x <= r.x1; x++)
+		{
+			cells[z * columns + x].push_back(proxy);
+		}
+	}
+}
+
+void BroadPhase::removeCells(uint32_t proxy)
+{
+	const CellRange &r = proxies[proxy].cells;
+	for (int z = r.z0; z <= r.z1; z++)
+	{
+		for (int x = r.x0; x <= r.x1; x++)
+		{
+			std::vector<uint32_t> &cell = cells[z * columns + x];
+			std::vector<uint32_t>::iterator it = std::find(cell.begin(), cell.end(), proxy);
+			if (it != cell.end())
+			{
+				*it = cell.back();
+				cell.pop_back();
+			}
+		}
+	}
+}
+
+void BroadPhase::removeProxy(uint32_t proxy)
+{
+	removeCells(proxy);
+	proxyOf[proxies[proxy].entity.index] = NONE;
+
+	// Move the last proxy into the hole, renaming it in its cells
+	uint32_t last = (uint32_t) proxies.size() - 1;
+	if (proxy != last)
+	{
+		removeCells(last);
+		proxies[proxy] = proxies[last];
+		proxyOf[proxies[proxy].entity.index] = proxy;
+		insertCells(proxy);
+	}
+	proxies.pop_back();
+}
+
+void BroadPhase::update(const EntityStore &store)
+{
+	stats.refiled = 0;
+	for (uint32_t p = 0; p < proxies.size(); )
+	{
+		Proxy &proxy = proxies[p];
+		if (! store.isAlive(proxy.entity))
+		{
+			removeProxy(p);
+			continue;
+		}
+
+		size_t i = store.indexOf(proxy.entity);
+		float r = store.radius[i] + .5f * margin;
+		proxy.min = vec2(store.posX[i] - r, store.posZ[i] - r);
+		proxy.max = vec2(store.posX[i] + r, store.posZ[i] + r);
+
+		CellRange range;
+		range.x0 = cellX(proxy.min.x);
+		range.z0 = cellZ(proxy.min.y);
+		range.x1 = cellX(proxy.max.x);
+		range.z1 = cellZ(proxy.max.y);
+		if (! (range == proxy.cells))
+		{
+			removeCells(p);
+			proxy.cells = range;
+			insertCells(p);
+			stats.refiled++;
+		}
+		p++;
+	}
+	stats.entities = (int) proxies.size();
+}
+
+void BroadPhase::findPairs(std::vector<Pair> &pairs)
+{
+	pairs.clear();
+	for (int z = 0; z < rows; z++)
+	{
+		for (int x = 0; x < columns; x++)
+		{
+			const std::vector<uint32_t> &cell = cells[z * columns + x];
+			for (size_t i = 0; i < cell.size(); i++)
+			{
+				const Proxy &a = proxies[cell[i]];
+				for (size_t j = i + 1; j < cell.size(); j++)
+				{
+					const Proxy &b = proxies[cell[j]];
+					// Two entities can share several cells; report the pair
+					// only from the first of them (the min corner of their
+					// shared range).
+					if (x != std::max(a.cells.x0, b.cells.x0) || z != std::max(a.cells.z0, b.cells.z0))
+					{
+						continue;
+					}
+					if (a.max.x < b.min.x || b.max.x < a.min.x || a.max.y < b.min.y || b.max.y < a.min.y)
+					{
+						continue;
+					}
+					Pair pair;
+					pair.a = a.entity;
+					pair.b = b.entity;
+					pairs.push_back(pair);
+				}
+			}
+		}
+	}
+	stats.candidatePairs = (int) pairs.size();
+}
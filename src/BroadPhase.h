@@ -0,0 +1,100 @@
+#pragma once
+
+#ifndef LAB471_BROADPHASE_H_INCLUDED
+#define LAB471_BROADPHASE_H_INCLUDED
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "EntityStore.h"
+
+
+/**
+ * Broad-phase collision over the pitch: a uniform grid in x/z.
+ *
+ * Each tracked entity covers the cells its bounding sphere overlaps. update()
+ * re-files only the entities whose cell range changed since the last tick, so
+ * a tick costs O(moved entities) on top of a pass reading the positions.
+ * findPairs() then lists every pair whose x/z bounds overlap, each pair once,
+ * for the narrow phase (NarrowPhase) to confirm.
+ *
+ * Positions outside the grid bounds are clamped into the border cells, so
+ * nothing is lost; it is just slower out there.
+ */
+class BroadPhase
+{
+
+public:
+
+	struct Pair
+	{
+		Entity a, b;
+	};
+
+	struct Stats
+	{
+		int entities = 0;
+		int refiled = 0;        // last update()
+		int candidatePairs = 0; // last findPairs()
+	};
+
+	BroadPhase(const glm::vec2 &minXZ = glm::vec2(-32.f), const glm::vec2 &maxXZ = glm::vec2(32.f), float cellSize = 2.f);
+
+	// cellSize should be about the diameter of a typical entity
+	void setGrid(const glm::vec2 &minXZ, const glm::vec2 &maxXZ, float cellSize);
+
+	// Also pair up entities up to margin apart, for contacts with a margin
+	void setMargin(float distance) { margin = distance; }
+
+	void add(Entity e);
+	void remove(Entity e);
+	bool contains(Entity e) const;
+
+	// Picks up the entities' new positions and radii. Entities destroyed in
+	// the store since the last update are dropped.
+	void update(const EntityStore &store);
+
+	// Replaces pairs with the candidates as of the last update()
+	void findPairs(std::vector<Pair> &pairs);
+
+	const Stats & getStats() const { return stats; }
+
+private:
+
+	struct CellRange
+	{
+		int x0 = 0, z0 = 0, x1 = -1, z1 = -1;
+
+		bool operator==(const CellRange &other) const
+		{
+			return x0 == other.x0 && z0 == other.z0 && x1 == other.x1 && z1 == other.z1;
+		}
+	};
+
+	struct Proxy
+	{
+		Entity entity;
+		glm::vec2 min, max;
+		CellRange cells;
+	};
+
+	int cellX(float x) const;
+	int cellZ(float z) const;
+	void insertCells(uint32_t proxy);
+	void removeCells(uint32_t proxy);
+	void removeProxy(uint32_t proxy);
+
+	glm::vec2 origin;
+	float invCellSize = .5f;
+	float margin = 0.f;
+	int columns = 0, rows = 0;
+
+	std::vector<Proxy> proxies;
+	// Per entity handle index: its proxy, or NONE
+	std::vector<uint32_t> proxyOf;
+	// Per cell (row-major, x fastest): the proxies overlapping it
+	std::vector<std::vector<uint32_t>> cells;
+	Stats stats;
+
+};
+
+#endif // LAB471_BROADPHASE_H_INCLUDED
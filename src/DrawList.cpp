@@ -0,0 +1,73 @@
+#include "DrawList.h"
+#include "Shape.h"
+#include <algorithm>
+
+using namespace std;
+using namespace glm;
+
+void DrawList::add(const shared_ptr<Program> &program, const shared_ptr<Shape> &shape, const mat4 &model, int material, bool dynamic)
+{
+	Item item;
+	item.program = program;
+	item.shape = shape;
+	item.model = model;
+	item.material = material;
+	item.dynamic = dynamic;
+	item.depth = 0.f;
+	item.lod = 0;
+	items.push_back(item);
+}
+
+void DrawList::sort(const mat4 &V, bool byState)
+{
+	for (Item &item : items)
+	{
+		vec4 centre = V * item.model * vec4((item.shape->min + item.shape->max) * .5f, 1.f);
+		item.depth = -centre.z;
+	}
+
+	// Stable, so equal keys keep the scene's order and frames don't flicker
+	if (byState)
+	{
+		stable_sort(items.begin(), items.end(), [](const Item &a, const Item &b)
+		{
+			if (a.program != b.program)
+			{
+				return a.program < b.program;
+			}
+			if (a.material != b.material)
+			{
+				return a.material < b.material;
+			}
+			return a.depth < b.depth;
+		});
+	}
+	else
+	{
+		stable_sort(items.begin(), items.end(), [](const Item &a, const Item &b)
+		{
+			return a.depth < b.depth;
+		});
+	}
+}
+
+void DrawList::pickLods(const mat4 &V, float pixelsPerUnit, float maxPixels)
+{
+	map<const Shape *, int> seen;
+	for (Item &item : items)
+	{
+		const Shape *shape = item.shape.get();
+		int &lod = lods[make_pair(shape, seen[shape]++)];
+
+		// The largest scale of the model matrix, and the distance to the
+		// nearest point of the shape's bounding sphere
+		mat3 linear(item.model);
+		float scale = std::max(length(linear[0]), std::max(length(linear[1]), length(linear[2])));
+		vec3 centre = vec3(V * item.model * vec4((shape->min + shape->max) * .5f, 1.f));
+		float radius = .5f * length(shape->max - shape->min) * scale;
+		float distance = std::max(length(centre) - radius, 1e-3f);
+
+		lod = shape->pickLod(pixelsPerUnit * scale / distance, maxPixels, lod);
+		item.lod = lod;
+	}
+}
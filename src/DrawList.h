@@ -0,0 +1,68 @@
+#pragma once
+
+#ifndef LAB471_DRAWLIST_H_INCLUDED
+#define LAB471_DRAWLIST_H_INCLUDED
+
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+class Program;
+class Shape;
+
+
+/**
+ * The opaque draws of a frame, collected first and submitted in a better
+ * order than the order the scene code happens to produce them in.
+ *
+ * Without a depth pre-pass, nearest first: later draws then fail the depth
+ * test on covered pixels instead of shading them again. With one, the
+ * depth buffer already rejects every hidden fragment, so draws are grouped
+ * by program and material to change state as seldom as possible.
+ */
+class DrawList
+{
+
+public:
+
+	struct Item
+	{
+		std::shared_ptr<Program> program;
+		std::shared_ptr<Shape> shape;
+		glm::mat4 model;
+		// Whatever the caller uses to set per-draw uniforms; -1 for none
+		int material;
+		// Moves from frame to frame; static draws only cast into the cached
+		// shadow maps
+		bool dynamic;
+		// View depth of the shape's centre
+		float depth;
+		// The shape's level of detail, 0 for full
+		int lod;
+	};
+
+	void clear() { items.clear(); }
+	void add(const std::shared_ptr<Program> &program, const std::shared_ptr<Shape> &shape, const glm::mat4 &model, int material = -1, bool dynamic = true);
+
+	// Front to back for this view, or by state if byState
+	void sort(const glm::mat4 &V, bool byState);
+	// Picks each draw's level of detail from how big it is on screen: the
+	// coarsest whose error is at most maxPixels. pixelsPerUnit is the
+	// screen size of one unit at distance 1. Call before sort(), with the
+	// draws added in the same order every frame; a draw remembers its level
+	// by its shape and how many times the shape came before it.
+	void pickLods(const glm::mat4 &V, float pixelsPerUnit, float maxPixels);
+
+	const std::vector<Item> & getItems() const { return items; }
+
+private:
+
+	std::vector<Item> items;
+	// Last frame's level of each draw, for hysteresis
+	std::map<std::pair<const Shape *, int>, int> lods;
+
+};
+
+#endif // LAB471_DRAWLIST_H_INCLUDED
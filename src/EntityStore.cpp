@@ -0,0 +1,223 @@
+#include "EntityStore.h"
+#include <cmath>
+
+using namespace glm;
+
+
+template <typename F>
+void EntityStore::forEachComponent(F f)
+{
+	std::vector<float> *arrays[] = {
+		&posX, &posY, &posZ, &velX, &velY, &velZ, &accX, &accY, &accZ,
+		&sizeX, &sizeY, &sizeZ, &rotX, &rotY, &rotZ, &radius, &speed, &turnSpeed,
+		&stepX, &stepZ
+	};
+	for (std::vector<float> *a : arrays)
+	{
+		f(*a);
+	}
+}
+
+Entity EntityStore::create()
+{
+	Entity e;
+	if (! freeIndices.empty())
+	{
+		e.index = freeIndices.back();
+		freeIndices.pop_back();
+	}
+	else
+	{
+		e.index = (uint32_t) generations.size();
+		generations.push_back(0);
+		dense.push_back(0);
+	}
+	e.generation = generations[e.index];
+
+	dense[e.index] = (uint32_t) size();
+	owners.push_back(e.index);
+	forEachComponent([](std::vector<float> &a) { a.push_back(0.f); });
+	return e;
+}
+
+void EntityStore::destroy(Entity e)
+{
+	if (! isAlive(e))
+	{
+		return;
+	}
+
+	// Fill the hole with the last entity so the arrays stay packed
+	uint32_t hole = dense[e.index];
+	uint32_t last = (uint32_t) size() - 1;
+	if (hole != last)
+	{
+		forEachComponent([hole, last](std::vector<float> &a) { a[hole] = a[last]; });
+		owners[hole] = owners[last];
+		dense[owners[hole]] = hole;
+	}
+	forEachComponent([](std::vector<float> &a) { a.pop_back(); });
+	owners.pop_back();
+
+	generations[e.index]++;
+	freeIndices.push_back(e.index);
+}
+
+bool EntityStore::isAlive(Entity e) const
+{
+	return e.index < generations.size() && generations[e.index] == e.generation;
+}
+
+void EntityStore::reserve(size_t n)
+{
+	forEachComponent([n](std::vector<float> &a) { a.reserve(n); });
+	owners.reserve(n);
+}
+
+vec3 EntityStore::getPosition(Entity e) const
+{
+	size_t i = indexOf(e);
+	return vec3(posX[i], posY[i], posZ[i]);
+}
+
+void EntityStore::setPosition(Entity e, const vec3 &p)
+{
+	size_t i = indexOf(e);
+	posX[i] = p.x;
+	posY[i] = p.y;
+	posZ[i] = p.z;
+}
+
+void EntityStore::translate(Entity e, const vec3 &d)
+{
+	size_t i = indexOf(e);
+	posX[i] += d.x;
+	posY[i] += d.y;
+	posZ[i] += d.z;
+}
+
+vec3 EntityStore::getVelocity(Entity e) const
+{
+	size_t i = indexOf(e);
+	return vec3(velX[i], velY[i], velZ[i]);
+}
+
+void EntityStore::setVelocity(Entity e, const vec3 &v)
+{
+	size_t i = indexOf(e);
+	velX[i] = v.x;
+	velY[i] = v.y;
+	velZ[i] = v.z;
+}
+
+vec3 EntityStore::getAcceleration(Entity e) const
+{
+	size_t i = indexOf(e);
+	return vec3(accX[i], accY[i], accZ[i]);
+}
+
+void EntityStore::setAcceleration(Entity e, const vec3 &a)
+{
+	size_t i = indexOf(e);
+	accX[i] = a.x;
+	accY[i] = a.y;
+	accZ[i] = a.z;
+}
+
+vec3 EntityStore::getSize(Entity e) const
+{
+	size_t i = indexOf(e);
+	return vec3(sizeX[i], sizeY[i], sizeZ[i]);
+}
+
+void EntityStore::setSize(Entity e, const vec3 &s)
+{
+	size_t i = indexOf(e);
+	sizeX[i] = s.x;
+	sizeY[i] = s.y;
+	sizeZ[i] = s.z;
+}
+
+vec3 EntityStore::getRotation(Entity e) const
+{
+	size_t i = indexOf(e);
+	return vec3(rotX[i], rotY[i], rotZ[i]);
+}
+
+void EntityStore::setRotation(Entity e, const vec3 &r)
+{
+	size_t i = indexOf(e);
+	rotX[i] = r.x;
+	rotY[i] = r.y;
+	rotZ[i] = r.z;
+}
+
+vec3 EntityStore::getLastStep(Entity e) const
+{
+	size_t i = indexOf(e);
+	return vec3(stepX[i], 0.f, stepZ[i]);
+}
+
+// sin and cos of x radians, written with selects only so loops calling it
+// vectorize (libm's sinf/cosf don't). Error is ~1e-7 near 0, growing to ~1e-5
+// at thousands of degrees from the float range reduction.
+static inline void sinCos(float x, float &s, float &c)
+{
+	const float PI = 3.14159265f;
+	// Reduce to [-pi, pi], then fold into [-pi/2, pi/2] where cos >= 0
+	float k = (float) (int) (x * (.5f / PI) + (x >= 0.f ? .5f : -.5f));
+	float y = x - k * (2.f * PI);
+	float sign = 1.f;
+	float folded = y > PI / 2.f ? PI - y : (y < -PI / 2.f ? -PI - y : y);
+	sign = folded != y ? -1.f : sign;
+	y = folded;
+
+	float y2 = y * y;
+	s = y * (1.f + y2 * (-1.f / 6 + y2 * (1.f / 120 + y2 * (-1.f / 5040 + y2 * (1.f / 362880 + y2 * (-1.f / 39916800))))));
+	c = sign * (1.f + y2 * (-.5f + y2 * (1.f / 24 + y2 * (-1.f / 720 + y2 * (1.f / 40320 + y2 * (-1.f / 3628800 + y2 * (1.f / 479001600)))))));
+}
+
+void EntityStore::move(float dt)
+{
+	const size_t n = size();
+	const float degToRad = 3.14159265f / 180.f;
+	float *__restrict px = posX.data();
+	float *__restrict pz = posZ.data();
+	float *__restrict ry = rotY.data();
+	float *__restrict sx = stepX.data();
+	float *__restrict sz = stepZ.data();
+	const float *__restrict sp = speed.data();
+	const float *__restrict ts = turnSpeed.data();
+
+	// Branch-free so the compiler can run it 4 or 8 entities at a time
+	for (size_t i = 0; i < n; i++)
+	{
+		ry[i] += ts[i] * dt;
+		float distance = sp[i] * dt;
+		float sinY, cosY;
+		sinCos(ry[i] * degToRad, sinY, cosY);
+		float dx = distance * cosY;
+		float dz = distance * sinY;
+		bool moving = sp[i] != 0.f || ts[i] != 0.f;
+		sx[i] = moving ? dx : sx[i];
+		sz[i] = moving ? dz : sz[i];
+		px[i] += dx;
+		pz[i] += dz;
+	}
+}
+
+static void integrateAxis(float *__restrict p, float *__restrict v, const float *__restrict a, size_t n, float dt)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		v[i] += a[i] * dt;
+		p[i] += v[i] * dt;
+	}
+}
+
+void EntityStore::integrate(float dt)
+{
+	integrateAxis(posX.data(), velX.data(), accX.data(), size(), dt);
+	integrateAxis(posY.data(), velY.data(), accY.data(), size(), dt);
+	integrateAxis(posZ.data(), velZ.data(), accZ.data(), size(), dt);
+}
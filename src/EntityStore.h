@@ -0,0 +1,102 @@
+#pragma once
+
+#ifndef LAB471_ENTITYSTORE_H_INCLUDED
+#define LAB471_ENTITYSTORE_H_INCLUDED
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+
+// Handle to an entity. Stays valid (and keeps referring to the same entity)
+// while other entities are created and destroyed; once its entity is
+// destroyed the handle is recognisably stale.
+struct Entity
+{
+	uint32_t index = ~0u;
+	uint32_t generation = 0;
+
+	bool operator==(const Entity &other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Entity &other) const { return ! (*this == other); }
+};
+
+/**
+ * Structure-of-arrays storage for the game's moving objects (players, balls,
+ * feet, goals).
+ *
+ * Each component is its own tightly packed float array, and live entities
+ * always occupy indices [0, size()), so a system is one straight loop over
+ * a few arrays. Destroying an entity moves the last one into its slot; the
+ * handles hide that.
+ */
+class EntityStore
+{
+
+public:
+
+	Entity create();
+	void destroy(Entity e);
+	bool isAlive(Entity e) const;
+	size_t size() const { return posX.size(); }
+	void reserve(size_t n);
+
+	// Packed index of a live entity, for reading the component arrays
+	size_t indexOf(Entity e) const { return dense[e.index]; }
+
+	glm::vec3 getPosition(Entity e) const;
+	void setPosition(Entity e, const glm::vec3 &p);
+	void translate(Entity e, const glm::vec3 &d);
+	glm::vec3 getVelocity(Entity e) const;
+	void setVelocity(Entity e, const glm::vec3 &v);
+	glm::vec3 getAcceleration(Entity e) const;
+	void setAcceleration(Entity e, const glm::vec3 &a);
+	glm::vec3 getSize(Entity e) const;
+	void setSize(Entity e, const glm::vec3 &s);
+	// Euler angles in degrees
+	glm::vec3 getRotation(Entity e) const;
+	void setRotation(Entity e, const glm::vec3 &r);
+
+	float getRadius(Entity e) const { return radius[indexOf(e)]; }
+	void setRadius(Entity e, float r) { radius[indexOf(e)] = r; }
+	// Forward speed along the heading (rotation.y), units per second
+	float getSpeed(Entity e) const { return speed[indexOf(e)]; }
+	void setSpeed(Entity e, float s) { speed[indexOf(e)] = s; }
+	// Degrees per second around y
+	float getTurnSpeed(Entity e) const { return turnSpeed[indexOf(e)]; }
+	void setTurnSpeed(Entity e, float s) { turnSpeed[indexOf(e)] = s; }
+	// Distance moved by the last move() in which the entity was moving
+	glm::vec3 getLastStep(Entity e) const;
+
+	// Systems, applied to every entity at once.
+
+	// Turns by turnSpeed and walks speed along the heading (the old
+	// GameObject::Move). Entities with no speed and no turn keep their last step.
+	void move(float dt);
+	// velocity += acceleration * dt, position += velocity * dt
+	void integrate(float dt);
+
+	// Components, all indexed by indexOf()
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> velX, velY, velZ;
+	std::vector<float> accX, accY, accZ;
+	std::vector<float> sizeX, sizeY, sizeZ;
+	std::vector<float> rotX, rotY, rotZ;
+	std::vector<float> radius;
+	std::vector<float> speed, turnSpeed;
+	std::vector<float> stepX, stepZ;
+
+private:
+
+	template <typename F>
+	void forEachComponent(F f);
+
+	// Per handle index: its generation and where its data is packed
+	std::vector<uint32_t> generations;
+	std::vector<uint32_t> dense;
+	// Per packed index: which handle index lives there
+	std::vector<uint32_t> owners;
+	std::vector<uint32_t> freeIndices;
+
+};
+
+#endif // LAB471_ENTITYSTORE_H_INCLUDED
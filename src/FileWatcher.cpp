@@ -0,0 +1,116 @@
+#include "FileWatcher.h"
+#include <algorithm>
+#include <chrono>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using namespace std;
+
+// Seconds between modification time scans
+static const double SCAN_INTERVAL = .25;
+
+static time_t modificationTime(const string &path)
+{
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 ? info.st_mtime : 0;
+}
+
+static double now()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (inotifyFd >= 0)
+	{
+		close(inotifyFd);
+	}
+#endif
+}
+
+void FileWatcher::watch(const string &path)
+{
+	if (files.count(path))
+	{
+		return;
+	}
+	files[path] = modificationTime(path);
+
+#ifdef __linux__
+	if (! inotifyTried)
+	{
+		inotifyTried = true;
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	}
+	if (inotifyFd >= 0)
+	{
+		// Keep the directory as spelled, so event paths match watched ones
+		size_t slash = path.find_last_of('/');
+		string prefix = slash == string::npos ? "" : path.substr(0, slash + 1);
+		// Adding a directory twice returns the same descriptor
+		int wd = inotify_add_watch(inotifyFd, prefix.empty() ? "." : prefix.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (wd >= 0)
+		{
+			directories[wd] = prefix;
+		}
+	}
+#endif
+}
+
+void FileWatcher::poll(vector<string> &changed)
+{
+	changed.clear();
+
+#ifdef __linux__
+	if (inotifyFd >= 0)
+	{
+		alignas(inotify_event) char buffer[4096];
+		for (;;)
+		{
+			ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+			if (length <= 0)
+			{
+				break;
+			}
+			for (char *p = buffer; p < buffer + length; )
+			{
+				const inotify_event *event = (const inotify_event *) p;
+				map<int, string>::const_iterator directory = directories.find(event->wd);
+				if (event->len > 0 && directory != directories.end())
+				{
+					string path = directory->second + event->name;
+					if (files.count(path) && find(changed.begin(), changed.end(), path) == changed.end())
+					{
+						changed.push_back(path);
+					}
+				}
+				p += sizeof(inotify_event) + event->len;
+			}
+		}
+		return;
+	}
+#endif
+
+	double time = now();
+	if (time - lastScan < SCAN_INTERVAL)
+	{
+		return;
+	}
+	lastScan = time;
+	for (map<string, time_t>::iterator file = files.begin(); file != files.end(); ++file)
+	{
+		time_t modified = modificationTime(file->first);
+		if (modified != file->second)
+		{
+			file->second = modified;
+			changed.push_back(file->first);
+		}
+	}
+}
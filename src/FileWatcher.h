@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef LAB471_FILEWATCHER_H_INCLUDED
+#define LAB471_FILEWATCHER_H_INCLUDED
+
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+
+/**
+ * Reports which of a set of files were written since it last looked.
+ *
+ * On Linux it watches their directories with inotify, so editors that save
+ * by writing a new file and renaming it over the old one are seen too.
+ * Elsewhere (or if inotify is unavailable) it compares modification times,
+ * at most a few times a second.
+ */
+class FileWatcher
+{
+
+public:
+
+	FileWatcher() = default;
+	FileWatcher(const FileWatcher &) = delete;
+	FileWatcher & operator=(const FileWatcher &) = delete;
+	~FileWatcher();
+
+	void watch(const std::string &path);
+	// Never blocks. Each changed path is reported once, as given to watch().
+	void poll(std::vector<std::string> &changed);
+
+private:
+
+	// path -> last modification time seen
+	std::map<std::string, time_t> files;
+	double lastScan = 0.0;
+
+	int inotifyFd = -1;
+	bool inotifyTried = false;
+	// Watch descriptor -> directory with its trailing slash, as spelled in
+	// the watched paths
+	std::map<int, std::string> directories;
+
+};
+
+#endif // LAB471_FILEWATCHER_H_INCLUDED
@@ -0,0 +1,25 @@
+#include "FixedTimestep.h"
+
+
+int FixedTimestep::advance(double elapsed)
+{
+	if (elapsed < 0.0)
+	{
+		elapsed = 0.0;
+	}
+	accumulator += elapsed;
+
+	int steps = 0;
+	while (accumulator >= step)
+	{
+		if (steps == maxSteps)
+		{
+			accumulator = 0.0;
+			break;
+		}
+		accumulator -= step;
+		steps++;
+	}
+	ticks += steps;
+	return steps;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef LAB471_FIXEDTIMESTEP_H_INCLUDED
+#define LAB471_FIXEDTIMESTEP_H_INCLUDED
+
+
+/**
+ * Accumulator for running a simulation at a fixed rate, independent of how
+ * fast frames are rendered.
+ *
+ * Each frame, advance() is given the time the frame took and returns how
+ * many whole steps to simulate. What is left over is returned by getAlpha()
+ * as a fraction of a step, for interpolating between the last two simulated
+ * states when drawing.
+ */
+class FixedTimestep
+{
+
+public:
+
+	explicit FixedTimestep(double step = 1.0 / 60.0, int maxSteps = 8) : step(step), maxSteps(maxSteps) {}
+
+	// Returns how many steps to run for elapsed seconds of real time. After a
+	// long stall at most maxSteps are run and the rest of the time is dropped,
+	// so a slow frame can't snowball into ever slower ones.
+	int advance(double elapsed);
+
+	double getStep() const { return step; }
+	float getAlpha() const { return (float) (accumulator / step); }
+	long long getTicks() const { return ticks; }
+
+private:
+
+	double step;
+	int maxSteps;
+	double accumulator = 0.0;
+	long long ticks = 0;
+
+};
+
+#endif // LAB471_FIXEDTIMESTEP_H_INCLUDED
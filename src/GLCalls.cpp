@@ -0,0 +1,414 @@
+#include "GLCalls.h"
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+namespace GLCalls
+{
+
+static bool installed = false;
+static Counts frame;
+static Counts lastFrame;
+static Counts startup;
+static Counts total;
+static long long frameCount = 0;
+static std::ofstream log;
+
+static const char *CATEGORY_NAMES[CATEGORY_COUNT] = {
+	"draw", "state", "uniform", "upload", "other"
+};
+
+static const char *BYTE_KIND_NAMES[BYTE_KIND_COUNT] = {
+	"buffer", "texture", "uniform"
+};
+
+long long Counts::totalCalls() const
+{
+	long long sum = 0;
+	for (int i = 0; i < CATEGORY_COUNT; i++)
+	{
+		sum += calls[i];
+	}
+	return sum;
+}
+
+long long Counts::totalBytes() const
+{
+	long long sum = 0;
+	for (int i = 0; i < BYTE_KIND_COUNT; i++)
+	{
+		sum += bytes[i];
+	}
+	return sum;
+}
+
+Counts & Counts::operator+=(const Counts &other)
+{
+	for (int i = 0; i < CATEGORY_COUNT; i++)
+	{
+		calls[i] += other.calls[i];
+	}
+	for (int i = 0; i < BYTE_KIND_COUNT; i++)
+	{
+		bytes[i] += other.bytes[i];
+	}
+	return *this;
+}
+
+// Bytes in one pixel of client data
+static long long pixelSize(GLenum format, GLenum type)
+{
+	switch (type)
+	{
+	case GL_UNSIGNED_BYTE_3_3_2:
+	case GL_UNSIGNED_BYTE_2_3_3_REV:
+		return 1;
+	case GL_UNSIGNED_SHORT_5_6_5:
+	case GL_UNSIGNED_SHORT_5_6_5_REV:
+	case GL_UNSIGNED_SHORT_4_4_4_4:
+	case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+	case GL_UNSIGNED_SHORT_5_5_5_1:
+	case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+		return 2;
+	case GL_UNSIGNED_INT_8_8_8_8:
+	case GL_UNSIGNED_INT_8_8_8_8_REV:
+	case GL_UNSIGNED_INT_10_10_10_2:
+	case GL_UNSIGNED_INT_2_10_10_10_REV:
+	case GL_UNSIGNED_INT_24_8:
+	case GL_UNSIGNED_INT_10F_11F_11F_REV:
+	case GL_UNSIGNED_INT_5_9_9_9_REV:
+		return 4;
+	case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+		return 8;
+	}
+
+	long long components = 4;
+	switch (format)
+	{
+	case GL_RED:
+	case GL_RED_INTEGER:
+	case GL_DEPTH_COMPONENT:
+	case GL_STENCIL_INDEX:
+		components = 1;
+		break;
+	case GL_RG:
+	case GL_RG_INTEGER:
+	case GL_DEPTH_STENCIL:
+		components = 2;
+		break;
+	case GL_RGB:
+	case GL_BGR:
+	case GL_RGB_INTEGER:
+	case GL_BGR_INTEGER:
+		components = 3;
+		break;
+	}
+
+	switch (type)
+	{
+	case GL_SHORT:
+	case GL_UNSIGNED_SHORT:
+	case GL_HALF_FLOAT:
+		return 2 * components;
+	case GL_INT:
+	case GL_UNSIGNED_INT:
+	case GL_FLOAT:
+		return 4 * components;
+	default:
+		return components;
+	}
+}
+
+static long long imageSize(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *pixels)
+{
+	// No client data means allocation only (nothing here uploads from a
+	// pixel unpack buffer)
+	if (! pixels)
+	{
+		return 0;
+	}
+	return (long long) width * height * depth * pixelSize(format, type);
+}
+
+
+// Each wrapper counts the call and forwards it to the entry point glad
+// loaded, which install() keeps in real<Name>
+
+#define FORWARD(Name, Category, Params, Args) \
+	static decltype(glad_gl##Name) real##Name; \
+	static void APIENTRY count##Name Params \
+	{ \
+		frame.calls[Category]++; \
+		real##Name Args; \
+	}
+
+#define FORWARD_BYTES(Name, Category, Kind, Bytes, Params, Args) \
+	static decltype(glad_gl##Name) real##Name; \
+	static void APIENTRY count##Name Params \
+	{ \
+		frame.calls[Category]++; \
+		frame.bytes[Kind] += (Bytes); \
+		real##Name Args; \
+	}
+
+FORWARD(DrawArrays, DRAW, (GLenum mode, GLint first, GLsizei count), (mode, first, count))
+FORWARD(DrawElements, DRAW, (GLenum mode, GLsizei count, GLenum type, const void *indices), (mode, count, type, indices))
+FORWARD(DrawArraysInstanced, DRAW, (GLenum mode, GLint first, GLsizei count, GLsizei instances), (mode, first, count, instances))
+FORWARD(DrawElementsInstanced, DRAW, (GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instances), (mode, count, type, indices, instances))
+FORWARD(DrawElementsBaseVertex, DRAW, (GLenum mode, GLsizei count, GLenum type, const void *indices, GLint base), (mode, count, type, indices, base))
+FORWARD(DrawRangeElements, DRAW, (GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void *indices), (mode, start, end, count, type, indices))
+
+FORWARD(UseProgram, STATE, (GLuint program), (program))
+FORWARD(BindVertexArray, STATE, (GLuint vao), (vao))
+FORWARD(BindBuffer, STATE, (GLenum target, GLuint buffer), (target, buffer))
+FORWARD(BindBufferBase, STATE, (GLenum target, GLuint index, GLuint buffer), (target, index, buffer))
+FORWARD(ActiveTexture, STATE, (GLenum unit), (unit))
+FORWARD(BindTexture, STATE, (GLenum target, GLuint texture), (target, texture))
+FORWARD(BindFramebuffer, STATE, (GLenum target, GLuint framebuffer), (target, framebuffer))
+FORWARD(Enable, STATE, (GLenum cap), (cap))
+FORWARD(Disable, STATE, (GLenum cap), (cap))
+FORWARD(DepthMask, STATE, (GLboolean flag), (flag))
+FORWARD(DepthFunc, STATE, (GLenum func), (func))
+FORWARD(BlendFunc, STATE, (GLenum src, GLenum dst), (src, dst))
+FORWARD(CullFace, STATE, (GLenum mode), (mode))
+FORWARD(Viewport, STATE, (GLint x, GLint y, GLsizei width, GLsizei height), (x, y, width, height))
+FORWARD(VertexAttribPointer, STATE, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer), (index, size, type, normalized, stride, pointer))
+FORWARD(EnableVertexAttribArray, STATE, (GLuint index), (index))
+FORWARD(DisableVertexAttribArray, STATE, (GLuint index), (index))
+
+FORWARD_BYTES(Uniform1i, UNIFORM, UNIFORM_BYTES, 4, (GLint location, GLint v0), (location, v0))
+FORWARD_BYTES(Uniform1f, UNIFORM, UNIFORM_BYTES, 4, (GLint location, GLfloat v0), (location, v0))
+FORWARD_BYTES(Uniform2f, UNIFORM, UNIFORM_BYTES, 8, (GLint location, GLfloat v0, GLfloat v1), (location, v0, v1))
+FORWARD_BYTES(Uniform3f, UNIFORM, UNIFORM_BYTES, 12, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2), (location, v0, v1, v2))
+FORWARD_BYTES(Uniform4f, UNIFORM, UNIFORM_BYTES, 16, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3), (location, v0, v1, v2, v3))
+FORWARD_BYTES(Uniform1iv, UNIFORM, UNIFORM_BYTES, 4LL * count, (GLint location, GLsizei count, const GLint *value), (location, count, value))
+FORWARD_BYTES(Uniform1fv, UNIFORM, UNIFORM_BYTES, 4LL * count, (GLint location, GLsizei count, const GLfloat *value), (location, count, value))
+FORWARD_BYTES(Uniform2fv, UNIFORM, UNIFORM_BYTES, 8LL * count, (GLint location, GLsizei count, const GLfloat *value), (location, count, value))
+FORWARD_BYTES(Uniform3fv, UNIFORM, UNIFORM_BYTES, 12LL * count, (GLint location, GLsizei count, const GLfloat *value), (location, count, value))
+FORWARD_BYTES(Uniform4fv, UNIFORM, UNIFORM_BYTES, 16LL * count, (GLint location, GLsizei count, const GLfloat *value), (location, count, value))
+FORWARD_BYTES(UniformMatrix3fv, UNIFORM, UNIFORM_BYTES, 36LL * count, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), (location, count, transpose, value))
+FORWARD_BYTES(UniformMatrix4fv, UNIFORM, UNIFORM_BYTES, 64LL * count, (GLint location, GLsizei count, GLboolean transpose, const GLfloat *value), (location, count, transpose, value))
+
+FORWARD_BYTES(BufferData, UPLOAD, BUFFER_BYTES, data ? (long long) size : 0, (GLenum target, GLsizeiptr size, const void *data, GLenum usage), (target, size, data, usage))
+FORWARD_BYTES(BufferSubData, UPLOAD, BUFFER_BYTES, (long long) size, (GLenum target, GLintptr offset, GLsizeiptr size, const void *data), (target, offset, size, data))
+FORWARD_BYTES(TexImage2D, UPLOAD, TEXTURE_BYTES, imageSize(width, height, 1, format, type, pixels),
+	(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels),
+	(target, level, internalformat, width, height, border, format, type, pixels))
+FORWARD_BYTES(TexSubImage2D, UPLOAD, TEXTURE_BYTES, imageSize(width, height, 1, format, type, pixels),
+	(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *pixels),
+	(target, level, x, y, width, height, format, type, pixels))
+FORWARD_BYTES(TexImage3D, UPLOAD, TEXTURE_BYTES, imageSize(width, height, depth, format, type, pixels),
+	(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void *pixels),
+	(target, level, internalformat, width, height, depth, border, format, type, pixels))
+FORWARD_BYTES(TexSubImage3D, UPLOAD, TEXTURE_BYTES, imageSize(width, height, depth, format, type, pixels),
+	(GLenum target, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *pixels),
+	(target, level, x, y, z, width, height, depth, format, type, pixels))
+FORWARD_BYTES(CompressedTexImage2D, UPLOAD, TEXTURE_BYTES, data ? (long long) size : 0,
+	(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei size, const void *data),
+	(target, level, internalformat, width, height, border, size, data))
+FORWARD_BYTES(CompressedTexImage3D, UPLOAD, TEXTURE_BYTES, data ? (long long) size : 0,
+	(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLsizei size, const void *data),
+	(target, level, internalformat, width, height, depth, border, size, data))
+FORWARD_BYTES(CompressedTexSubImage2D, UPLOAD, TEXTURE_BYTES, (long long) size,
+	(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLsizei size, const void *data),
+	(target, level, x, y, width, height, format, size, data))
+
+FORWARD(Clear, OTHER, (GLbitfield mask), (mask))
+FORWARD(ClearColor, OTHER, (GLfloat r, GLfloat g, GLfloat b, GLfloat a), (r, g, b, a))
+FORWARD(GenerateMipmap, OTHER, (GLenum target), (target))
+FORWARD(TexParameteri, OTHER, (GLenum target, GLenum name, GLint value), (target, name, value))
+
+#undef FORWARD
+#undef FORWARD_BYTES
+
+// Entry points the driver doesn't have stay null and unwrapped
+#define HOOK(Name) \
+	real##Name = glad_gl##Name; \
+	if (real##Name) \
+	{ \
+		glad_gl##Name = count##Name; \
+	}
+
+void install()
+{
+	if (installed)
+	{
+		return;
+	}
+	HOOK(DrawArrays)
+	HOOK(DrawElements)
+	HOOK(DrawArraysInstanced)
+	HOOK(DrawElementsInstanced)
+	HOOK(DrawElementsBaseVertex)
+	HOOK(DrawRangeElements)
+
+	HOOK(UseProgram)
+	HOOK(BindVertexArray)
+	HOOK(BindBuffer)
+	HOOK(BindBufferBase)
+	HOOK(ActiveTexture)
+	HOOK(BindTexture)
+	HOOK(BindFramebuffer)
+	HOOK(Enable)
+	HOOK(Disable)
+	HOOK(DepthMask)
+	HOOK(DepthFunc)
+	HOOK(BlendFunc)
+	HOOK(CullFace)
+	HOOK(Viewport)
+	HOOK(VertexAttribPointer)
+	HOOK(EnableVertexAttribArray)
+	HOOK(DisableVertexAttribArray)
+
+	HOOK(Uniform1i)
+	HOOK(Uniform1f)
+	HOOK(Uniform2f)
+	HOOK(Uniform3f)
+	HOOK(Uniform4f)
+	HOOK(Uniform1iv)
+	HOOK(Uniform1fv)
+	HOOK(Uniform2fv)
+	HOOK(Uniform3fv)
+	HOOK(Uniform4fv)
+	HOOK(UniformMatrix3fv)
+	HOOK(UniformMatrix4fv)
+
+	HOOK(BufferData)
+	HOOK(BufferSubData)
+	HOOK(TexImage2D)
+	HOOK(TexSubImage2D)
+	HOOK(TexImage3D)
+	HOOK(TexSubImage3D)
+	HOOK(CompressedTexImage2D)
+	HOOK(CompressedTexImage3D)
+	HOOK(CompressedTexSubImage2D)
+
+	HOOK(Clear)
+	HOOK(ClearColor)
+	HOOK(GenerateMipmap)
+	HOOK(TexParameteri)
+	installed = true;
+}
+
+#undef HOOK
+
+bool isInstalled()
+{
+	return installed;
+}
+
+bool openLog(const std::string &path)
+{
+	log.open(path.c_str());
+	if (! log)
+	{
+		std::cerr << "Could not write GL call log " << path << std::endl;
+		return false;
+	}
+	log << "frame";
+	for (int i = 0; i < CATEGORY_COUNT; i++)
+	{
+		log << "," << CATEGORY_NAMES[i] << "_calls";
+	}
+	for (int i = 0; i < BYTE_KIND_COUNT; i++)
+	{
+		log << "," << BYTE_KIND_NAMES[i] << "_bytes";
+	}
+	log << std::endl;
+	return true;
+}
+
+void closeLog()
+{
+	log.close();
+}
+
+void endFrame()
+{
+	if (! installed)
+	{
+		return;
+	}
+	if (log.is_open())
+	{
+		log << frameCount;
+		for (int i = 0; i < CATEGORY_COUNT; i++)
+		{
+			log << "," << frame.calls[i];
+		}
+		for (int i = 0; i < BYTE_KIND_COUNT; i++)
+		{
+			log << "," << frame.bytes[i];
+		}
+		log << "\n";
+	}
+	if (frameCount == 0)
+	{
+		startup = frame;
+	}
+	total += frame;
+	lastFrame = frame;
+	frame = Counts();
+	frameCount++;
+}
+
+const Counts & getLastFrame()
+{
+	return lastFrame;
+}
+
+const Counts & getTotal()
+{
+	return total;
+}
+
+long long getFrameCount()
+{
+	return frameCount;
+}
+
+void printCounts(std::ostream &out, const Counts &counts)
+{
+	out << "  calls:";
+	for (int i = 0; i < CATEGORY_COUNT; i++)
+	{
+		out << " " << CATEGORY_NAMES[i] << " " << counts.calls[i];
+	}
+	out << " (total " << counts.totalCalls() << ")" << std::endl;
+	out << "  bytes:";
+	for (int i = 0; i < BYTE_KIND_COUNT; i++)
+	{
+		out << " " << BYTE_KIND_NAMES[i] << " " << counts.bytes[i];
+	}
+	out << " (total " << counts.totalBytes() << ")" << std::endl;
+}
+
+void printSummary(std::ostream &out)
+{
+	if (! installed)
+	{
+		return;
+	}
+	out << "GL calls last frame:" << std::endl;
+	printCounts(out, lastFrame);
+	if (frameCount > 1)
+	{
+		// Loading is row 0; leave it out of the average
+		Counts frames = total;
+		Counts average;
+		for (int i = 0; i < CATEGORY_COUNT; i++)
+		{
+			average.calls[i] = (frames.calls[i] - startup.calls[i]) / (frameCount - 1);
+		}
+		for (int i = 0; i < BYTE_KIND_COUNT; i++)
+		{
+			average.bytes[i] = (frames.bytes[i] - startup.bytes[i]) / (frameCount - 1);
+		}
+		out << "GL calls per frame, average of " << frameCount - 1 << ":" << std::endl;
+		printCounts(out, average);
+	}
+	out << "GL calls while loading:" << std::endl;
+	printCounts(out, startup);
+}
+
+}
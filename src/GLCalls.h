@@ -0,0 +1,75 @@
+#pragma once
+
+#ifndef LAB471_GLCALLS_H_INCLUDED
+#define LAB471_GLCALLS_H_INCLUDED
+
+#include <glad/glad.h>
+#include <ostream>
+#include <string>
+
+
+/**
+ * Counts the GL calls of each frame by category, and the bytes they send to
+ * the driver in buffer, texture and uniform uploads.
+ *
+ * install() swaps the entry points glad loaded for counting wrappers that
+ * forward to them, so every call in the program is seen without touching
+ * the call sites. Until it is called nothing is wrapped and nothing costs
+ * anything. Only the calls a frame makes are wrapped (draws, binds and
+ * state, uniforms, uploads, clears); queries, creation and deletion are not.
+ *
+ * Texture byte counts assume tightly packed rows.
+ */
+
+namespace GLCalls
+{
+
+	enum Category
+	{
+		DRAW,
+		STATE,
+		UNIFORM,
+		UPLOAD,
+		OTHER,
+		CATEGORY_COUNT
+	};
+
+	enum ByteKind
+	{
+		BUFFER_BYTES,
+		TEXTURE_BYTES,
+		UNIFORM_BYTES,
+		BYTE_KIND_COUNT
+	};
+
+	struct Counts
+	{
+		long long calls[CATEGORY_COUNT] = {};
+		long long bytes[BYTE_KIND_COUNT] = {};
+
+		long long totalCalls() const;
+		long long totalBytes() const;
+		Counts & operator+=(const Counts &other);
+	};
+
+	// Call after gladLoadGL
+	void install();
+	bool isInstalled();
+
+	// Also writes one CSV row per frame to path; row 0 is everything before
+	// the first endFrame() (loading)
+	bool openLog(const std::string &path);
+	void closeLog();
+
+	// Call once per frame; counts then describe the frame just finished
+	void endFrame();
+	const Counts & getLastFrame();
+	const Counts & getTotal();
+	long long getFrameCount();
+
+	void printCounts(std::ostream &out, const Counts &counts);
+	// Last frame, then the average frame
+	void printSummary(std::ostream &out);
+}
+
+#endif // LAB471_GLCALLS_H_INCLUDED
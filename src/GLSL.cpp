@@ -121,6 +121,29 @@ void checkVersion()
 	}
 }
 
+bool isVersionAtLeast(int major, int minor)
+{
+	GLint ctxMajor = 0, ctxMinor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &ctxMajor);
+	glGetIntegerv(GL_MINOR_VERSION, &ctxMinor);
+	return ctxMajor > major || (ctxMajor == major && ctxMinor >= minor);
+}
+
+bool hasExtension(const char *name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const char *ext = (const char *) glGetStringi(GL_EXTENSIONS, i);
+		if (ext && strcmp(ext, name) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 GLint getAttribLocation(const GLuint program, const char varname[], bool verbose)
 {
 	GLint r = glGetAttribLocation(program, varname);
@@ -20,6 +20,8 @@ namespace GLSL
 	void printProgramInfoLog(GLuint program);
 	void printShaderInfoLog(GLuint shader);
 	void checkVersion();
+	bool isVersionAtLeast(int major, int minor);
+	bool hasExtension(const char *name);
 	GLint getAttribLocation(const GLuint program, const char varname[], bool verbose = true);
 	GLint getUniformLocation(const GLuint program, const char varname[], bool verbose = true);
 	void enableVertexAttribArray(const GLint handle);
@@ -0,0 +1,402 @@
+#include "GLState.h"
+#include "GLSL.h"
+#include <map>
+
+namespace GLState
+{
+
+// GL 3.3 guarantees at least 16 combined units per stage; we use far fewer
+static const int MAX_UNITS = 32;
+static const GLuint UNKNOWN = ~0u;
+
+enum TextureSlot
+{
+	SLOT_2D,
+	SLOT_2D_ARRAY,
+	SLOT_CUBE_MAP,
+	SLOT_BUFFER,
+	TEXTURE_SLOTS,
+	SLOT_OTHER = TEXTURE_SLOTS
+};
+
+enum BufferSlot
+{
+	ARRAY,
+	ELEMENT_ARRAY,
+	UNIFORM,
+	BUFFER_SLOTS,
+	OTHER_BUFFER = BUFFER_SLOTS
+};
+
+static bool initialized = false;
+static GLuint currentProgram;
+static GLuint currentVao;
+static GLuint boundBuffers[BUFFER_SLOTS];
+// The element array binding belongs to the VAO, so remember it per VAO
+static std::map<GLuint, GLuint> vaoElementBuffers;
+static GLuint activeUnit;
+static GLuint boundTextures[MAX_UNITS][TEXTURE_SLOTS];
+static int currentDepthMask;
+static GLint currentViewport[4];
+
+static Counters frame;
+static Counters lastFrame;
+
+static const char *KIND_NAMES[KIND_COUNT] = {
+	"program", "vertex array", "buffer", "active texture", "texture", "depth mask", "viewport"
+};
+
+int Counters::totalIssued() const
+{
+	int total = 0;
+	for (int i = 0; i < KIND_COUNT; i++)
+	{
+		total += issued[i];
+	}
+	return total;
+}
+
+int Counters::totalElided() const
+{
+	int total = 0;
+	for (int i = 0; i < KIND_COUNT; i++)
+	{
+		total += elided[i];
+	}
+	return total;
+}
+
+void reset()
+{
+	currentProgram = UNKNOWN;
+	currentVao = UNKNOWN;
+	for (int slot = 0; slot < BUFFER_SLOTS; slot++)
+	{
+		boundBuffers[slot] = UNKNOWN;
+	}
+	vaoElementBuffers.clear();
+	activeUnit = UNKNOWN;
+	for (int unit = 0; unit < MAX_UNITS; unit++)
+	{
+		for (int slot = 0; slot < TEXTURE_SLOTS; slot++)
+		{
+			boundTextures[unit][slot] = UNKNOWN;
+		}
+	}
+	currentDepthMask = -1;
+	for (int i = 0; i < 4; i++)
+	{
+		currentViewport[i] = -1;
+	}
+	initialized = true;
+}
+
+// Decides whether a bind of value over the cached current value must be
+// issued, and counts it either way. Binding 0 over a known object is a
+// no-op here (see the header).
+static bool needsBind(Kind kind, GLuint &current, GLuint value)
+{
+	if (! initialized)
+	{
+		reset();
+	}
+#ifndef DISABLE_GL_STATE_CACHE
+	if (value == current || (value == 0 && current != UNKNOWN))
+	{
+		frame.elided[kind]++;
+		return false;
+	}
+#endif
+	current = value;
+	frame.issued[kind]++;
+	return true;
+}
+
+void useProgram(GLuint program)
+{
+	if (needsBind(PROGRAM, currentProgram, program))
+	{
+		CHECKED_GL_CALL(glUseProgram(program));
+	}
+}
+
+void bindVertexArray(GLuint vao)
+{
+	if (needsBind(VERTEX_ARRAY, currentVao, vao))
+	{
+		CHECKED_GL_CALL(glBindVertexArray(vao));
+		std::map<GLuint, GLuint>::const_iterator it = vaoElementBuffers.find(vao);
+		boundBuffers[ELEMENT_ARRAY] = it != vaoElementBuffers.end() ? it->second : UNKNOWN;
+	}
+}
+
+static BufferSlot bufferSlotFor(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER:
+		return ARRAY;
+	case GL_ELEMENT_ARRAY_BUFFER:
+		return ELEMENT_ARRAY;
+	case GL_UNIFORM_BUFFER:
+		return UNIFORM;
+	default:
+		return OTHER_BUFFER;
+	}
+}
+
+void bindBuffer(GLenum target, GLuint buffer)
+{
+	BufferSlot slot = bufferSlotFor(target);
+	if (slot == OTHER_BUFFER)
+	{
+		frame.issued[BUFFER]++;
+		CHECKED_GL_CALL(glBindBuffer(target, buffer));
+		return;
+	}
+	// Without a known VAO, the element binding can't be attributed to one
+	if (slot == ELEMENT_ARRAY && currentVao == UNKNOWN)
+	{
+		boundBuffers[slot] = UNKNOWN;
+	}
+	if (needsBind(BUFFER, boundBuffers[slot], buffer))
+	{
+		CHECKED_GL_CALL(glBindBuffer(target, buffer));
+		if (slot == ELEMENT_ARRAY && currentVao != UNKNOWN)
+		{
+			vaoElementBuffers[currentVao] = buffer;
+		}
+	}
+}
+
+void bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	if (! initialized)
+	{
+		reset();
+	}
+	CHECKED_GL_CALL(glBindBufferBase(target, index, buffer));
+	frame.issued[BUFFER]++;
+	BufferSlot slot = bufferSlotFor(target);
+	if (slot != OTHER_BUFFER)
+	{
+		boundBuffers[slot] = buffer;
+	}
+}
+
+void activeTexture(GLuint unit)
+{
+	if (! initialized)
+	{
+		reset();
+	}
+#ifndef DISABLE_GL_STATE_CACHE
+	if (unit == activeUnit)
+	{
+		frame.elided[ACTIVE_TEXTURE]++;
+		return;
+	}
+#endif
+	CHECKED_GL_CALL(glActiveTexture(GL_TEXTURE0 + unit));
+	activeUnit = unit;
+	frame.issued[ACTIVE_TEXTURE]++;
+}
+
+static TextureSlot textureSlotFor(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:
+		return SLOT_2D;
+	case GL_TEXTURE_2D_ARRAY:
+		return SLOT_2D_ARRAY;
+	case GL_TEXTURE_CUBE_MAP:
+		return SLOT_CUBE_MAP;
+	case GL_TEXTURE_BUFFER:
+		return SLOT_BUFFER;
+	default:
+		return SLOT_OTHER;
+	}
+}
+
+void bindTexture(GLenum target, GLuint texture)
+{
+	if (! initialized)
+	{
+		reset();
+	}
+	TextureSlot slot = textureSlotFor(target);
+	if (activeUnit >= (GLuint) MAX_UNITS || slot == SLOT_OTHER)
+	{
+		// Untracked: just issue it
+		frame.issued[TEXTURE]++;
+		CHECKED_GL_CALL(glBindTexture(target, texture));
+		return;
+	}
+	if (needsBind(TEXTURE, boundTextures[activeUnit][slot], texture))
+	{
+		CHECKED_GL_CALL(glBindTexture(target, texture));
+	}
+}
+
+void bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	if (! initialized)
+	{
+		reset();
+	}
+	// Skip selecting the unit too when the texture is already there
+#ifndef DISABLE_GL_STATE_CACHE
+	TextureSlot slot = textureSlotFor(target);
+	if (unit < (GLuint) MAX_UNITS && slot != SLOT_OTHER)
+	{
+		GLuint bound = boundTextures[unit][slot];
+		if (bound == texture || (texture == 0 && bound != UNKNOWN))
+		{
+			frame.elided[TEXTURE]++;
+			return;
+		}
+	}
+#endif
+	activeTexture(unit);
+	bindTexture(target, texture);
+}
+
+void depthMask(GLboolean enabled)
+{
+	if (! initialized)
+	{
+		reset();
+	}
+#ifndef DISABLE_GL_STATE_CACHE
+	if (currentDepthMask == (int) enabled)
+	{
+		frame.elided[DEPTH_MASK]++;
+		return;
+	}
+#endif
+	CHECKED_GL_CALL(glDepthMask(enabled));
+	currentDepthMask = enabled;
+	frame.issued[DEPTH_MASK]++;
+}
+
+void viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (! initialized)
+	{
+		reset();
+	}
+#ifndef DISABLE_GL_STATE_CACHE
+	if (currentViewport[0] == x && currentViewport[1] == y && currentViewport[2] == width && currentViewport[3] == height)
+	{
+		frame.elided[VIEWPORT]++;
+		return;
+	}
+#endif
+	CHECKED_GL_CALL(glViewport(x, y, width, height));
+	currentViewport[0] = x;
+	currentViewport[1] = y;
+	currentViewport[2] = width;
+	currentViewport[3] = height;
+	frame.issued[VIEWPORT]++;
+}
+
+void deleteProgram(GLuint program)
+{
+	if (! initialized)
+	{
+		reset();
+	}
+	CHECKED_GL_CALL(glDeleteProgram(program));
+	// A program in use is only deleted once it isn't; its name may come
+	// back for a new one, so the next use must be issued
+	if (currentProgram == program)
+	{
+		currentProgram = UNKNOWN;
+	}
+}
+
+void deleteTexture(GLuint texture)
+{
+	if (! initialized)
+	{
+		reset();
+	}
+	CHECKED_GL_CALL(glDeleteTextures(1, &texture));
+	// GL unbinds a deleted texture from every unit, which now hold 0
+	for (int unit = 0; unit < MAX_UNITS; unit++)
+	{
+		for (int slot = 0; slot < TEXTURE_SLOTS; slot++)
+		{
+			if (boundTextures[unit][slot] == texture)
+			{
+				boundTextures[unit][slot] = 0;
+			}
+		}
+	}
+}
+
+void deleteBuffer(GLuint buffer)
+{
+	if (! initialized)
+	{
+		reset();
+	}
+	CHECKED_GL_CALL(glDeleteBuffers(1, &buffer));
+	for (int slot = 0; slot < BUFFER_SLOTS; slot++)
+	{
+		if (boundBuffers[slot] == buffer)
+		{
+			boundBuffers[slot] = 0;
+		}
+	}
+	for (std::map<GLuint, GLuint>::iterator it = vaoElementBuffers.begin(); it != vaoElementBuffers.end(); ++it)
+	{
+		if (it->second == buffer)
+		{
+			it->second = 0;
+		}
+	}
+}
+
+void deleteVertexArray(GLuint vao)
+{
+	if (! initialized)
+	{
+		reset();
+	}
+	CHECKED_GL_CALL(glDeleteVertexArrays(1, &vao));
+	vaoElementBuffers.erase(vao);
+	if (currentVao == vao)
+	{
+		currentVao = 0;
+		boundBuffers[ELEMENT_ARRAY] = UNKNOWN;
+	}
+}
+
+void endFrame()
+{
+	lastFrame = frame;
+	frame = Counters();
+}
+
+const Counters & getLastFrame()
+{
+	return lastFrame;
+}
+
+void printCounters(std::ostream &out)
+{
+#ifdef DISABLE_GL_STATE_CACHE
+	out << "GL state calls last frame (cache disabled):" << std::endl;
+#else
+	out << "GL state calls last frame:" << std::endl;
+#endif
+	for (int i = 0; i < KIND_COUNT; i++)
+	{
+		out << "  " << KIND_NAMES[i] << ": " << lastFrame.issued[i] << " issued, " << lastFrame.elided[i] << " elided" << std::endl;
+	}
+	out << "  total: " << lastFrame.totalIssued() << " issued, " << lastFrame.totalElided() << " elided" << std::endl;
+}
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#ifndef LAB471_GLSTATE_H_INCLUDED
+#define LAB471_GLSTATE_H_INCLUDED
+
+#include <glad/glad.h>
+#include <ostream>
+
+
+/**
+ * Shadow copy of the GL binding state, so a call that would not change
+ * anything is never sent to the driver.
+ *
+ * This only works if every change of the tracked state goes through here.
+ * Code that changes it behind our back (e.g. GLTextureWriter, which restores
+ * what it found) must either restore it or call reset().
+ *
+ * Binding 0 to a program, vertex array, buffer or texture means "done with
+ * it" in this code base, never "draw with nothing bound", so those unbinds
+ * are dropped and the object simply stays bound until something else is.
+ *
+ * Building with DISABLE_GL_STATE_CACHE (cmake -DGL_STATE_CACHE=OFF) issues
+ * every call as-is, to compare against.
+ */
+
+namespace GLState
+{
+
+	enum Kind
+	{
+		PROGRAM,
+		VERTEX_ARRAY,
+		BUFFER,
+		ACTIVE_TEXTURE,
+		TEXTURE,
+		DEPTH_MASK,
+		VIEWPORT,
+		KIND_COUNT
+	};
+
+	struct Counters
+	{
+		int issued[KIND_COUNT] = {};
+		int elided[KIND_COUNT] = {};
+
+		int totalIssued() const;
+		int totalElided() const;
+	};
+
+	void useProgram(GLuint program);
+	void bindVertexArray(GLuint vao);
+	void bindBuffer(GLenum target, GLuint buffer);
+	// Binds to an indexed binding point (e.g. of uniform blocks). That also
+	// binds the generic target, which is tracked; the indexed points are not.
+	void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	// Selects texture unit GL_TEXTURE0 + unit
+	void activeTexture(GLuint unit);
+	// Binds on the active unit
+	void bindTexture(GLenum target, GLuint texture);
+	void bindTexture(GLuint unit, GLenum target, GLuint texture);
+	void depthMask(GLboolean enabled);
+	void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	// Delete an object and forget it was bound anywhere
+	void deleteProgram(GLuint program);
+	void deleteTexture(GLuint texture);
+	void deleteBuffer(GLuint buffer);
+	void deleteVertexArray(GLuint vao);
+
+	// Forgets everything; the next call of each kind is always issued
+	void reset();
+
+	// Call once per frame; counters then describe the frame just finished
+	void endFrame();
+	const Counters & getLastFrame();
+	void printCounters(std::ostream &out);
+}
+
+#endif // LAB471_GLSTATE_H_INCLUDED
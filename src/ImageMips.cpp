@@ -0,0 +1,317 @@
+
+#include "ImageMips.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGEMIPS_SSE2 1
+#endif
+
+namespace ImageMips
+{
+
+static void boxDownsample(const Level &src, Level &dst)
+{
+	const int sw = src.width, sh = src.height;
+	const int dw = dst.width, dh = dst.height;
+
+	for (int y = 0; y < dh; y++)
+	{
+		const unsigned char *r0 = &src.pixels[(size_t) std::min(2 * y, sh - 1) * sw * 4];
+		const unsigned char *r1 = &src.pixels[(size_t) std::min(2 * y + 1, sh - 1) * sw * 4];
+		unsigned char *out = &dst.pixels[(size_t) y * dw * 4];
+		int x = 0;
+
+#ifdef IMAGEMIPS_SSE2
+		// 8 source pixels -> 4 output pixels per iteration. Averaging rows then
+		// columns with pavgb rounds twice, a +0.5 bias we accept for speed.
+		if (sw == 2 * dw)
+		{
+			for (; x + 4 <= dw; x += 4)
+			{
+				__m128i a0 = _mm_loadu_si128((const __m128i *) (r0 + 8 * x));
+				__m128i a1 = _mm_loadu_si128((const __m128i *) (r0 + 8 * x + 16));
+				__m128i b0 = _mm_loadu_si128((const __m128i *) (r1 + 8 * x));
+				__m128i b1 = _mm_loadu_si128((const __m128i *) (r1 + 8 * x + 16));
+				__m128 v0 = _mm_castsi128_ps(_mm_avg_epu8(a0, b0));
+				__m128 v1 = _mm_castsi128_ps(_mm_avg_epu8(a1, b1));
+				__m128i even = _mm_castps_si128(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0)));
+				__m128i odd = _mm_castps_si128(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1)));
+				_mm_storeu_si128((__m128i *) (out + 4 * x), _mm_avg_epu8(even, odd));
+			}
+		}
+#endif
+
+		// Scalar tail, also handles odd and 1-pixel-wide levels
+		for (; x < dw; x++)
+		{
+			int x0 = std::min(2 * x, sw - 1) * 4;
+			int x1 = std::min(2 * x + 1, sw - 1) * 4;
+			for (int c = 0; c < 4; c++)
+			{
+				out[4 * x + c] = (unsigned char) ((r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c] + 2) >> 2);
+			}
+		}
+	}
+}
+
+// Zeroth order modified Bessel function, for the Kaiser window
+static double besselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 32; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static const int KaiserTaps = 8;
+
+static void kaiserWeights(float weights[KaiserTaps])
+{
+	const double alpha = 4.0;
+	const double halfWidth = KaiserTaps / 4.0;  // in destination pixels
+	const double pi = 3.14159265358979323846;
+	double total = 0.0;
+
+	for (int k = 0; k < KaiserTaps; k++)
+	{
+		// Source pixel centre relative to the destination pixel centre
+		double t = ((k - KaiserTaps / 2) + 0.5) / 2.0;
+		double sinc = t == 0.0 ? 1.0 : sin(pi * t) / (pi * t);
+		double r = t / halfWidth;
+		double window = besselI0(alpha * sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(alpha);
+		weights[k] = (float) (sinc * window);
+		total += weights[k];
+	}
+	for (int k = 0; k < KaiserTaps; k++)
+	{
+		weights[k] = (float) (weights[k] / total);
+	}
+}
+
+static void kaiserDownsample(const Level &src, Level &dst)
+{
+	const int sw = src.width, sh = src.height;
+	const int dw = dst.width, dh = dst.height;
+	float w[KaiserTaps];
+	kaiserWeights(w);
+
+	// A dimension that is not shrinking is copied through unfiltered
+	const bool filterX = dw < sw;
+	const bool filterY = dh < sh;
+
+	// Horizontal pass into a float buffer, then vertical pass. The inner
+	// channel loops are written so the compiler can vectorise them.
+	std::vector<float> tmp((size_t) sh * dw * 4, 0.f);
+	for (int y = 0; y < sh; y++)
+	{
+		const unsigned char *row = &src.pixels[(size_t) y * sw * 4];
+		float *out = &tmp[(size_t) y * dw * 4];
+		for (int x = 0; x < dw; x++)
+		{
+			if (! filterX)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					out[4 * x + c] = row[4 * x + c];
+				}
+				continue;
+			}
+			for (int k = 0; k < KaiserTaps; k++)
+			{
+				int sx = std::min(std::max(2 * x - KaiserTaps / 2 + 1 + k, 0), sw - 1);
+				for (int c = 0; c < 4; c++)
+				{
+					out[4 * x + c] += w[k] * row[4 * sx + c];
+				}
+			}
+		}
+	}
+
+	std::vector<float> acc((size_t) dw * 4);
+	for (int y = 0; y < dh; y++)
+	{
+		std::fill(acc.begin(), acc.end(), 0.f);
+		for (int k = 0; k < KaiserTaps; k++)
+		{
+			int sy = filterY ? std::min(std::max(2 * y - KaiserTaps / 2 + 1 + k, 0), sh - 1) : y;
+			float wk = filterY ? w[k] : (k == 0 ? 1.f : 0.f);
+			const float *row = &tmp[(size_t) sy * dw * 4];
+			for (int i = 0; i < dw * 4; i++)
+			{
+				acc[i] += wk * row[i];
+			}
+		}
+		unsigned char *out = &dst.pixels[(size_t) y * dw * 4];
+		for (int i = 0; i < dw * 4; i++)
+		{
+			out[i] = (unsigned char) std::min(std::max(acc[i] + 0.5f, 0.f), 255.f);
+		}
+	}
+}
+
+void downsample(const Level &src, Filter filter, Level &dst)
+{
+	dst.width = std::max(src.width / 2, 1);
+	dst.height = std::max(src.height / 2, 1);
+	dst.pixels.resize((size_t) dst.width * dst.height * 4);
+
+	if (filter == KAISER)
+	{
+		kaiserDownsample(src, dst);
+	}
+	else
+	{
+		boxDownsample(src, dst);
+	}
+}
+
+void buildChain(const unsigned char *rgba, int width, int height, Filter filter, std::vector<Level> &levels)
+{
+	levels.clear();
+	levels.push_back(Level());
+	levels[0].width = width;
+	levels[0].height = height;
+	levels[0].pixels.assign(rgba, rgba + (size_t) width * height * 4);
+
+	while (levels.back().width > 1 || levels.back().height > 1)
+	{
+		Level next;
+		downsample(levels.back(), filter, next);
+		levels.push_back(std::move(next));
+	}
+}
+
+std::vector<unsigned char> toPaddedRGB(const Level &level)
+{
+	size_t stride = ((size_t) level.width * 3 + 3) & ~size_t(3);
+	std::vector<unsigned char> out(stride * level.height, 0);
+	for (int y = 0; y < level.height; y++)
+	{
+		const unsigned char *src = &level.pixels[(size_t) y * level.width * 4];
+		unsigned char *dst = &out[stride * y];
+		for (int x = 0; x < level.width; x++)
+		{
+			memcpy(dst + 3 * x, src + 4 * x, 3);
+		}
+	}
+	return out;
+}
+
+static uint16_t pack565(const float c[3])
+{
+	int r = (int) std::min(std::max(c[0] * 31.f / 255.f + 0.5f, 0.f), 31.f);
+	int g = (int) std::min(std::max(c[1] * 63.f / 255.f + 0.5f, 0.f), 63.f);
+	int b = (int) std::min(std::max(c[2] * 31.f / 255.f + 0.5f, 0.f), 31.f);
+	return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+static void unpack565(uint16_t v, int c[3])
+{
+	int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+static void encodeBC1Block(const unsigned char block[16][4], unsigned char out[8])
+{
+	// Endpoints from the extreme projections onto the colour bounding box
+	// diagonal: a cheap range fit, good enough for offline baking
+	float lo[3] = { 255.f, 255.f, 255.f }, hi[3] = { 0.f, 0.f, 0.f };
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			lo[c] = std::min(lo[c], (float) block[i][c]);
+			hi[c] = std::max(hi[c], (float) block[i][c]);
+		}
+	}
+	float axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+	float minProj = 1e30f, maxProj = -1e30f;
+	int minIdx = 0, maxIdx = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		float p = block[i][0] * axis[0] + block[i][1] * axis[1] + block[i][2] * axis[2];
+		if (p < minProj) { minProj = p; minIdx = i; }
+		if (p > maxProj) { maxProj = p; maxIdx = i; }
+	}
+	float e0[3] = { (float) block[maxIdx][0], (float) block[maxIdx][1], (float) block[maxIdx][2] };
+	float e1[3] = { (float) block[minIdx][0], (float) block[minIdx][1], (float) block[minIdx][2] };
+	uint16_t c0 = pack565(e0), c1 = pack565(e1);
+
+	// c0 > c1 selects the opaque 4-colour mode
+	if (c0 < c1)
+	{
+		std::swap(c0, c1);
+	}
+
+	uint32_t indices = 0;
+	if (c0 != c1)
+	{
+		int p[4][3];
+		unpack565(c0, p[0]);
+		unpack565(c1, p[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			p[2][c] = (2 * p[0][c] + p[1][c]) / 3;
+			p[3][c] = (p[0][c] + 2 * p[1][c]) / 3;
+		}
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestDist = 1 << 30;
+			for (int j = 0; j < 4; j++)
+			{
+				int dr = block[i][0] - p[j][0], dg = block[i][1] - p[j][1], db = block[i][2] - p[j][2];
+				int d = dr * dr + dg * dg + db * db;
+				if (d < bestDist)
+				{
+					bestDist = d;
+					best = j;
+				}
+			}
+			indices |= (uint32_t) best << (2 * i);
+		}
+	}
+
+	out[0] = (unsigned char) (c0 & 0xFF);
+	out[1] = (unsigned char) (c0 >> 8);
+	out[2] = (unsigned char) (c1 & 0xFF);
+	out[3] = (unsigned char) (c1 >> 8);
+	out[4] = (unsigned char) (indices & 0xFF);
+	out[5] = (unsigned char) ((indices >> 8) & 0xFF);
+	out[6] = (unsigned char) ((indices >> 16) & 0xFF);
+	out[7] = (unsigned char) (indices >> 24);
+}
+
+std::vector<unsigned char> compressBC1(const Level &level)
+{
+	int bw = (level.width + 3) / 4;
+	int bh = (level.height + 3) / 4;
+	std::vector<unsigned char> out((size_t) bw * bh * 8);
+
+	unsigned char block[16][4];
+	for (int by = 0; by < bh; by++)
+	{
+		for (int bx = 0; bx < bw; bx++)
+		{
+			// Edge blocks repeat the last row/column
+			for (int i = 0; i < 16; i++)
+			{
+				int x = std::min(bx * 4 + (i & 3), level.width - 1);
+				int y = std::min(by * 4 + (i >> 2), level.height - 1);
+				memcpy(block[i], &level.pixels[((size_t) y * level.width + x) * 4], 4);
+			}
+			encodeBC1Block(block, &out[((size_t) by * bw + bx) * 8]);
+		}
+	}
+	return out;
+}
+
+}
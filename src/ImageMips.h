@@ -0,0 +1,47 @@
+#pragma once
+
+#ifndef LAB471_IMAGEMIPS_H_INCLUDED
+#define LAB471_IMAGEMIPS_H_INCLUDED
+
+#include <vector>
+
+
+/**
+ * CPU-side mip chain generation and block compression.
+ *
+ * All functions work on tightly packed 8-bit RGBA images. They are shared by
+ * the offline texture baker (tools/texbake.cpp) and Texture, so nothing here
+ * touches GL.
+ */
+
+namespace ImageMips
+{
+
+	enum Filter
+	{
+		BOX,    // 2x2 average, SSE2 accelerated
+		KAISER  // 8-tap Kaiser-windowed sinc, sharper minification
+	};
+
+	struct Level
+	{
+		int width = 0;
+		int height = 0;
+		std::vector<unsigned char> pixels;
+	};
+
+	// Builds levels 1..N from an RGBA level 0 (which is copied as levels[0]),
+	// stopping at 1x1.
+	void buildChain(const unsigned char *rgba, int width, int height, Filter filter, std::vector<Level> &levels);
+
+	// Halves one RGBA level. Odd dimensions are rounded down, minimum 1.
+	void downsample(const Level &src, Filter filter, Level &dst);
+
+	// Drops alpha and pads each row to 4 bytes (GL_UNPACK_ALIGNMENT default).
+	std::vector<unsigned char> toPaddedRGB(const Level &level);
+
+	// Encodes an RGBA level as BC1 (DXT1) blocks, ignoring alpha.
+	std::vector<unsigned char> compressBC1(const Level &level);
+}
+
+#endif // LAB471_IMAGEMIPS_H_INCLUDED
@@ -0,0 +1,386 @@
+#include "InputLog.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+using namespace std;
+
+static const char MAGIC[4] = {'L', 'I', 'R', '1'};
+// Record type on disk that ends a frame; events use their Type value
+static const uint8_t FRAME_RECORD = 0xff;
+
+
+// Little-endian writer/reader for the log's records
+class ByteWriter
+{
+
+public:
+
+	vector<uint8_t> bytes;
+
+	void u8(uint8_t v) { bytes.push_back(v); }
+
+	void u32(uint32_t v)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			bytes.push_back((uint8_t) (v >> (8 * i)));
+		}
+	}
+
+	void i16(int16_t v) { u8((uint8_t) v); u8((uint8_t) ((uint16_t) v >> 8)); }
+
+	void f32(float v)
+	{
+		uint32_t bits;
+		memcpy(&bits, &v, 4);
+		u32(bits);
+	}
+
+	void f64(double v)
+	{
+		uint64_t bits;
+		memcpy(&bits, &v, 8);
+		u32((uint32_t) bits);
+		u32((uint32_t) (bits >> 32));
+	}
+
+};
+
+class ByteReader
+{
+
+public:
+
+	ByteReader(const vector<uint8_t> &bytes) : bytes(bytes) {}
+
+	bool ok() const { return ! overrun; }
+	bool atEnd() const { return pos >= bytes.size(); }
+
+	uint8_t u8()
+	{
+		if (pos >= bytes.size())
+		{
+			overrun = true;
+			return 0;
+		}
+		return bytes[pos++];
+	}
+
+	uint32_t u32()
+	{
+		uint32_t v = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			v |= (uint32_t) u8() << (8 * i);
+		}
+		return v;
+	}
+
+	int16_t i16()
+	{
+		uint16_t lo = u8();
+		return (int16_t) (lo | (uint16_t) (u8() << 8));
+	}
+
+	float f32()
+	{
+		uint32_t bits = u32();
+		float v;
+		memcpy(&v, &bits, 4);
+		return v;
+	}
+
+	double f64()
+	{
+		uint64_t bits = u32();
+		bits |= (uint64_t) u32() << 32;
+		double v;
+		memcpy(&v, &bits, 8);
+		return v;
+	}
+
+private:
+
+	const vector<uint8_t> &bytes;
+	size_t pos = 0;
+	bool overrun = false;
+
+};
+
+
+void InputLog::clear()
+{
+	events.clear();
+	frameTimes.clear();
+}
+
+void InputLog::add(const Event &event)
+{
+	events.push_back(event);
+}
+
+void InputLog::endFrame(double elapsed)
+{
+	frameTimes.push_back(elapsed);
+}
+
+bool InputLog::save(const string &path) const
+{
+	ByteWriter out;
+	out.bytes.insert(out.bytes.end(), MAGIC, MAGIC + 4);
+	// Events after the last whole frame are left out
+	uint32_t eventCount = 0;
+	while (eventCount < events.size() && events[eventCount].frame < getFrameCount())
+	{
+		eventCount++;
+	}
+	out.u32(getFrameCount());
+	out.u32(eventCount);
+
+	size_t e = 0;
+	for (uint32_t frame = 0; frame < getFrameCount(); frame++)
+	{
+		for (; e < events.size() && events[e].frame == frame; e++)
+		{
+			const Event &event = events[e];
+			out.u8((uint8_t) event.type);
+			out.f32((float) event.time);
+			switch (event.type)
+			{
+			case KEY:
+				out.i16((int16_t) event.args[0]);
+				out.u32((uint32_t) event.args[1]);
+				out.u8((uint8_t) event.args[2]);
+				out.u8((uint8_t) event.args[3]);
+				break;
+			case MOUSE:
+				out.u8((uint8_t) event.args[0]);
+				out.u8((uint8_t) event.args[1]);
+				out.u8((uint8_t) event.args[2]);
+				break;
+			case SCROLL:
+			case CURSOR:
+				out.f64(event.x);
+				out.f64(event.y);
+				break;
+			case RESIZE:
+				out.u32((uint32_t) event.args[0]);
+				out.u32((uint32_t) event.args[1]);
+				break;
+			}
+		}
+		out.u8(FRAME_RECORD);
+		out.f64(frameTimes[frame]);
+	}
+
+	ofstream file(path.c_str(), ios::binary);
+	file.write((const char *) out.bytes.data(), out.bytes.size());
+	if (! file)
+	{
+		cerr << "Could not write input log " << path << endl;
+		return false;
+	}
+	return true;
+}
+
+bool InputLog::load(const string &path)
+{
+	clear();
+	ifstream file(path.c_str(), ios::binary);
+	if (! file)
+	{
+		cerr << "Could not open input log " << path << endl;
+		return false;
+	}
+	vector<uint8_t> bytes((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+	if (bytes.size() < 12 || memcmp(bytes.data(), MAGIC, 4) != 0)
+	{
+		cerr << path << " is not an input log" << endl;
+		return false;
+	}
+
+	ByteReader in(bytes);
+	for (int i = 0; i < 4; i++)
+	{
+		in.u8();
+	}
+	uint32_t frameCount = in.u32();
+	// Only checked against what is read, at the end: reserving them up front
+	// would let a corrupt header ask for gigabytes
+	uint32_t eventCount = in.u32();
+
+	while (in.ok() && ! in.atEnd())
+	{
+		uint8_t type = in.u8();
+		if (type == FRAME_RECORD)
+		{
+			frameTimes.push_back(in.f64());
+			continue;
+		}
+
+		Event event;
+		event.type = (Type) type;
+		event.frame = getFrameCount();
+		event.time = in.f32();
+		switch (type)
+		{
+		case KEY:
+			event.args[0] = in.i16();
+			event.args[1] = (int32_t) in.u32();
+			event.args[2] = in.u8();
+			event.args[3] = in.u8();
+			break;
+		case MOUSE:
+			event.args[0] = in.u8();
+			event.args[1] = in.u8();
+			event.args[2] = in.u8();
+			break;
+		case SCROLL:
+		case CURSOR:
+			event.x = in.f64();
+			event.y = in.f64();
+			break;
+		case RESIZE:
+			event.args[0] = (int32_t) in.u32();
+			event.args[1] = (int32_t) in.u32();
+			break;
+		default:
+			cerr << path << ": unknown record type " << (int) type << endl;
+			clear();
+			return false;
+		}
+		events.push_back(event);
+	}
+
+	if (! in.ok() || frameTimes.size() != frameCount || events.size() != eventCount)
+	{
+		cerr << path << " is truncated" << endl;
+		clear();
+		return false;
+	}
+	return true;
+}
+
+
+InputRecorder::InputRecorder(EventCallbacks *target, InputLog &log) :
+	target(target),
+	log(log),
+	startTime(glfwGetTime())
+{
+}
+
+void InputRecorder::beginFrame(double elapsed)
+{
+	if (inFrame)
+	{
+		log.endFrame(frameElapsed);
+		frame++;
+	}
+	frameElapsed = elapsed;
+	inFrame = true;
+}
+
+void InputRecorder::finish()
+{
+	if (inFrame)
+	{
+		log.endFrame(frameElapsed);
+		frame++;
+		inFrame = false;
+	}
+}
+
+void InputRecorder::record(InputLog::Event &event)
+{
+	// Events from before the first frame (e.g. during setup) count as frame 0
+	event.frame = frame;
+	event.time = glfwGetTime() - startTime;
+	log.add(event);
+}
+
+void InputRecorder::keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+	InputLog::Event event;
+	event.type = InputLog::KEY;
+	event.args[0] = key;
+	event.args[1] = scancode;
+	event.args[2] = action;
+	event.args[3] = mods;
+	record(event);
+	target->keyCallback(window, key, scancode, action, mods);
+}
+
+void InputRecorder::mouseCallback(GLFWwindow *window, int button, int action, int mods)
+{
+	InputLog::Event event;
+	event.type = InputLog::MOUSE;
+	event.args[0] = button;
+	event.args[1] = action;
+	event.args[2] = mods;
+	record(event);
+	target->mouseCallback(window, button, action, mods);
+}
+
+void InputRecorder::scrollCallback(GLFWwindow *window, double dX, double dY)
+{
+	InputLog::Event event;
+	event.type = InputLog::SCROLL;
+	event.x = dX;
+	event.y = dY;
+	record(event);
+	target->scrollCallback(window, dX, dY);
+}
+
+void InputRecorder::cursorCallback(GLFWwindow *window, double x, double y)
+{
+	InputLog::Event event;
+	event.type = InputLog::CURSOR;
+	event.x = x;
+	event.y = y;
+	record(event);
+	target->cursorCallback(window, x, y);
+}
+
+void InputRecorder::resizeCallback(GLFWwindow *window, int in_width, int in_height)
+{
+	InputLog::Event event;
+	event.type = InputLog::RESIZE;
+	event.args[0] = in_width;
+	event.args[1] = in_height;
+	record(event);
+	target->resizeCallback(window, in_width, in_height);
+}
+
+
+double InputReplayer::getFrameTime(uint32_t frame) const
+{
+	return frame < log.getFrameCount() ? log.getFrameTimes()[frame] : 0.0;
+}
+
+void InputReplayer::deliver(uint32_t frame, GLFWwindow *window, EventCallbacks *target)
+{
+	const vector<InputLog::Event> &events = log.getEvents();
+	for (; next < events.size() && events[next].frame <= frame; next++)
+	{
+		const InputLog::Event &event = events[next];
+		switch (event.type)
+		{
+		case InputLog::KEY:
+			target->keyCallback(window, event.args[0], event.args[1], event.args[2], event.args[3]);
+			break;
+		case InputLog::MOUSE:
+			target->mouseCallback(window, event.args[0], event.args[1], event.args[2]);
+			break;
+		case InputLog::SCROLL:
+			target->scrollCallback(window, event.x, event.y);
+			break;
+		case InputLog::CURSOR:
+			target->cursorCallback(window, event.x, event.y);
+			break;
+		case InputLog::RESIZE:
+			target->resizeCallback(window, event.args[0], event.args[1]);
+			break;
+		}
+	}
+}
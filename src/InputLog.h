@@ -0,0 +1,121 @@
+#pragma once
+
+#ifndef LAB471_INPUTLOG_H_INCLUDED
+#define LAB471_INPUTLOG_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "WindowManager.h"
+
+
+/**
+ * A recording of every input event and every frame's clock step, so a run
+ * can be played back exactly: same frame times, same events delivered at
+ * the same point of the same frame, through the same callbacks.
+ *
+ * On disk it is a small header followed by one record per event (a type
+ * byte and its arguments) and one per frame (its elapsed time), all little
+ * endian.
+ */
+class InputLog
+{
+
+public:
+
+	enum Type
+	{
+		KEY,
+		MOUSE,
+		SCROLL,
+		CURSOR,
+		RESIZE
+	};
+
+	struct Event
+	{
+		Type type;
+		// Frame whose event poll delivered it
+		uint32_t frame = 0;
+		// Seconds since the recording started
+		double time = 0.0;
+		// KEY: key, scancode, action, mods. MOUSE: button, action, mods.
+		// RESIZE: width, height.
+		int32_t args[4] = {};
+		// SCROLL: dX, dY. CURSOR: x, y.
+		double x = 0.0, y = 0.0;
+	};
+
+	void clear();
+	void add(const Event &event);
+	// Ends the current frame, which advanced the clock by elapsed seconds
+	void endFrame(double elapsed);
+
+	const std::vector<Event> & getEvents() const { return events; }
+	const std::vector<double> & getFrameTimes() const { return frameTimes; }
+	uint32_t getFrameCount() const { return (uint32_t) frameTimes.size(); }
+
+	bool save(const std::string &path) const;
+	bool load(const std::string &path);
+
+private:
+
+	std::vector<Event> events;
+	std::vector<double> frameTimes;
+
+};
+
+// Passes events on to the game, logging them on the way
+class InputRecorder : public EventCallbacks
+{
+
+public:
+
+	InputRecorder(EventCallbacks *target, InputLog &log);
+
+	// Call once per frame, before its events are polled
+	void beginFrame(double elapsed);
+	// Call once at the end, to close the last frame
+	void finish();
+
+	void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
+	void mouseCallback(GLFWwindow *window, int button, int action, int mods);
+	void scrollCallback(GLFWwindow *window, double dX, double dY);
+	void cursorCallback(GLFWwindow *window, double x, double y);
+	void resizeCallback(GLFWwindow *window, int in_width, int in_height);
+
+private:
+
+	void record(InputLog::Event &event);
+
+	EventCallbacks *target;
+	InputLog &log;
+	double startTime;
+	uint32_t frame = 0;
+	double frameElapsed = 0.0;
+	bool inFrame = false;
+
+};
+
+// Feeds a recording back to the game, frame by frame
+class InputReplayer
+{
+
+public:
+
+	explicit InputReplayer(const InputLog &log) : log(log) {}
+
+	// The recorded clock step of frame, or 0 past the end
+	double getFrameTime(uint32_t frame) const;
+	// Sends target every event recorded during frame, in order
+	void deliver(uint32_t frame, GLFWwindow *window, EventCallbacks *target);
+	bool isFinished() const { return next >= log.getEvents().size(); }
+
+private:
+
+	const InputLog &log;
+	size_t next = 0;
+
+};
+
+#endif // LAB471_INPUTLOG_H_INCLUDED
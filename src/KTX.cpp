@@ -0,0 +1,257 @@
+
+#include "KTX.h"
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <fstream>
+
+#ifdef _WIN32
+#define KTX_NO_MMAP
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace KTX
+{
+
+static const unsigned char Identifier[12] = {
+	0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+static const uint32_t NativeEndian = 0x04030201;
+static const uint32_t SwappedEndian = 0x01020304;
+
+struct Header
+{
+	uint32_t endianness;
+	uint32_t glType;
+	uint32_t glTypeSize;
+	uint32_t glFormat;
+	uint32_t glInternalFormat;
+	uint32_t glBaseInternalFormat;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t numberOfArrayElements;
+	uint32_t numberOfFaces;
+	uint32_t numberOfMipmapLevels;
+	uint32_t bytesOfKeyValueData;
+};
+
+static size_t pad4(size_t n)
+{
+	return (n + 3) & ~size_t(3);
+}
+
+bool parse(const unsigned char *data, size_t size, Image &image, std::string &err)
+{
+	Header header;
+	if (size < sizeof(Identifier) + sizeof(Header) || memcmp(data, Identifier, sizeof(Identifier)) != 0)
+	{
+		err = "not a KTX 1.1 file";
+		return false;
+	}
+	memcpy(&header, data + sizeof(Identifier), sizeof(Header));
+
+	if (header.endianness == SwappedEndian)
+	{
+		// Every producer we care about writes little-endian files
+		err = "big-endian KTX files are not supported";
+		return false;
+	}
+	if (header.endianness != NativeEndian)
+	{
+		err = "corrupt KTX header";
+		return false;
+	}
+	if (header.pixelDepth > 1 || header.numberOfArrayElements > 0)
+	{
+		err = "only 2D and cube map KTX files are supported";
+		return false;
+	}
+	if (header.numberOfFaces != 1 && header.numberOfFaces != 6)
+	{
+		err = "KTX file must have 1 or 6 faces";
+		return false;
+	}
+
+	image.glType = header.glType;
+	image.glFormat = header.glFormat;
+	image.glInternalFormat = header.glInternalFormat;
+	image.glBaseInternalFormat = header.glBaseInternalFormat;
+	image.width = (int) header.pixelWidth;
+	image.height = (int) header.pixelHeight;
+	image.faces = (int) header.numberOfFaces;
+	image.levels.clear();
+
+	// A level count of 0 asks the loader to generate mips; we only read level 0
+	uint32_t levelCount = header.numberOfMipmapLevels ? header.numberOfMipmapLevels : 1;
+
+	size_t offset = sizeof(Identifier) + sizeof(Header) + header.bytesOfKeyValueData;
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		uint32_t imageSize;
+		if (offset + sizeof(imageSize) > size)
+		{
+			err = "truncated KTX file";
+			return false;
+		}
+		memcpy(&imageSize, data + offset, sizeof(imageSize));
+		offset += sizeof(imageSize);
+
+		Level lvl;
+		lvl.width = std::max(image.width >> level, 1);
+		lvl.height = std::max(image.height >> level, 1);
+		lvl.faceSize = imageSize;
+		for (int face = 0; face < image.faces; face++)
+		{
+			if (offset + imageSize > size)
+			{
+				err = "truncated KTX file";
+				return false;
+			}
+			lvl.faces.push_back(data + offset);
+			// cubePadding keeps each face 4-byte aligned
+			offset += pad4(imageSize);
+		}
+		image.levels.push_back(lvl);
+	}
+
+	return true;
+}
+
+bool write(const std::string &fileName, const Image &image)
+{
+	std::ofstream file(fileName, std::ios::binary);
+	if (! file.is_open())
+	{
+		return false;
+	}
+
+	Header header;
+	header.endianness = NativeEndian;
+	header.glType = image.glType;
+	header.glTypeSize = 1;
+	header.glFormat = image.glFormat;
+	header.glInternalFormat = image.glInternalFormat;
+	header.glBaseInternalFormat = image.glBaseInternalFormat;
+	header.pixelWidth = (uint32_t) image.width;
+	header.pixelHeight = (uint32_t) image.height;
+	header.pixelDepth = 0;
+	header.numberOfArrayElements = 0;
+	header.numberOfFaces = (uint32_t) image.faces;
+	header.numberOfMipmapLevels = (uint32_t) image.levels.size();
+	header.bytesOfKeyValueData = 0;
+
+	file.write((const char *) Identifier, sizeof(Identifier));
+	file.write((const char *) &header, sizeof(header));
+
+	static const char zeros[4] = { 0, 0, 0, 0 };
+	for (const Level &lvl : image.levels)
+	{
+		uint32_t imageSize = (uint32_t) lvl.faceSize;
+		file.write((const char *) &imageSize, sizeof(imageSize));
+		for (const unsigned char *face : lvl.faces)
+		{
+			file.write((const char *) face, lvl.faceSize);
+			file.write(zeros, pad4(lvl.faceSize) - lvl.faceSize);
+		}
+	}
+
+	return file.good();
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string &fileName)
+{
+	close();
+
+#ifndef KTX_NO_MMAP
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		void *p = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED)
+		{
+			ptr = (const unsigned char *) p;
+			length = (size_t) st.st_size;
+			mapped = true;
+		}
+	}
+	::close(fd);
+	if (mapped)
+	{
+		return true;
+	}
+#endif
+
+	// No mmap available, read the whole file instead
+	std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+	if (! file.is_open())
+	{
+		return false;
+	}
+	buffer.resize((size_t) file.tellg());
+	file.seekg(0, std::ios::beg);
+	file.read((char *) buffer.data(), buffer.size());
+	ptr = buffer.data();
+	length = buffer.size();
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifndef KTX_NO_MMAP
+	if (mapped)
+	{
+		munmap((void *) ptr, length);
+	}
+#endif
+	buffer.clear();
+	ptr = nullptr;
+	length = 0;
+	mapped = false;
+}
+
+const char * formatName(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		return "BC1";
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+		return "BC2";
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		return "BC3";
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+		return "BC7";
+	case GL_COMPRESSED_RGB8_ETC2:
+		return "ETC2 RGB";
+	case GL_COMPRESSED_RGBA8_ETC2_EAC:
+		return "ETC2 RGBA";
+	case GL_RGB:
+	case GL_RGB8:
+		return "RGB8";
+	case GL_RGBA:
+	case GL_RGBA8:
+		return "RGBA8";
+	default:
+		return "unknown";
+	}
+}
+
+}
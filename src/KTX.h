@@ -0,0 +1,102 @@
+#pragma once
+
+#ifndef LAB471_KTX_H_INCLUDED
+#define LAB471_KTX_H_INCLUDED
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+// Block compression formats are extensions in our GL 3.3 loader
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#endif
+
+
+/**
+ * Minimal reader/writer for KTX 1.1 texture containers.
+ *
+ * A KTX file stores the exact glTexImage2D / glCompressedTexImage2D arguments
+ * for every mip level (and cube face), so it can be uploaded without decoding.
+ * Image rows are expected in OpenGL order (bottom row first), matching what
+ * stbi_set_flip_vertically_on_load(true) produces for the JPEG path.
+ */
+
+namespace KTX
+{
+
+	struct Level
+	{
+		int width = 0;
+		int height = 0;
+		size_t faceSize = 0;
+		// One pointer per face (1 for 2D textures, 6 for cube maps)
+		std::vector<const unsigned char *> faces;
+	};
+
+	struct Image
+	{
+		GLenum glType = 0;
+		GLenum glFormat = 0;
+		GLenum glInternalFormat = 0;
+		GLenum glBaseInternalFormat = 0;
+		int width = 0;
+		int height = 0;
+		int faces = 1;
+		std::vector<Level> levels;
+
+		// KTX stores glType == 0 for block-compressed formats
+		bool isCompressed() const { return glType == 0; }
+	};
+
+	// Parses a KTX file held in memory. Level pointers reference data, which
+	// must outlive the returned image.
+	bool parse(const unsigned char *data, size_t size, Image &image, std::string &err);
+
+	// Writes an image whose level pointers reference caller-owned data.
+	bool write(const std::string &fileName, const Image &image);
+
+	// Read-only view of a whole file, memory-mapped where the OS allows it so
+	// the texture cache can be handed to GL without an intermediate copy.
+	class MappedFile
+	{
+
+	public:
+
+		MappedFile() {}
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator= (const MappedFile&) = delete;
+
+		bool open(const std::string &fileName);
+		void close();
+
+		const unsigned char * data() const { return ptr; }
+		size_t size() const { return length; }
+
+	private:
+
+		const unsigned char *ptr = nullptr;
+		size_t length = 0;
+		bool mapped = false;
+		std::vector<unsigned char> buffer;
+
+	};
+
+	// Human readable name of the block format, for logging.
+	const char * formatName(GLenum internalFormat);
+}
+
+#endif // LAB471_KTX_H_INCLUDED
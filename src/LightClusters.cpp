@@ -0,0 +1,197 @@
+#include "LightClusters.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define LIGHTCLUSTERS_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LIGHTCLUSTERS_SSE2 1
+#endif
+
+using namespace std;
+using namespace glm;
+
+#if defined(LIGHTCLUSTERS_AVX)
+static const int LANES = 8;
+#elif defined(LIGHTCLUSTERS_SSE2)
+static const int LANES = 4;
+#else
+static const int LANES = 1;
+#endif
+
+const int LightClusters::GRID_X;
+const int LightClusters::GRID_Y;
+const int LightClusters::GRID_Z;
+const int LightClusters::CLUSTER_COUNT;
+const size_t LightClusters::MAX_REFERENCES;
+const float LightClusters::SLICE_NEAR = .5f;
+
+static const int SLICE_CLUSTERS = LightClusters::GRID_X * LightClusters::GRID_Y;
+static_assert(SLICE_CLUSTERS % 8 == 0, "a slice must be a whole number of SIMD batches");
+
+void LightClusters::setProjection(const mat4 &P)
+{
+	// All a symmetric perspective projection depends on
+	vec4 key(P[0][0], P[1][1], P[2][2], P[3][2]);
+	if (key == projection)
+	{
+		return;
+	}
+	projection = key;
+
+	// Half extents of the view at depth 1, and the planes, from the matrix
+	float tanX = 1.f / P[0][0];
+	float tanY = 1.f / P[1][1];
+	nearPlane = P[3][2] / (P[2][2] - 1.f);
+	farPlane = P[3][2] / (P[2][2] + 1.f);
+	sliceNear = std::min(std::max(SLICE_NEAR, nearPlane), .5f * farPlane);
+	sliceScale = GRID_Z / std::log(farPlane / sliceNear);
+	sliceBias = -std::log(sliceNear) * sliceScale;
+
+	minX.resize(CLUSTER_COUNT);
+	minY.resize(CLUSTER_COUNT);
+	minZ.resize(CLUSTER_COUNT);
+	maxX.resize(CLUSTER_COUNT);
+	maxY.resize(CLUSTER_COUNT);
+	maxZ.resize(CLUSTER_COUNT);
+	for (int z = 0; z < GRID_Z; z++)
+	{
+		float d0 = z == 0 ? nearPlane : sliceNear * std::pow(farPlane / sliceNear, z / (float) GRID_Z);
+		float d1 = sliceNear * std::pow(farPlane / sliceNear, (z + 1) / (float) GRID_Z);
+		for (int y = 0; y < GRID_Y; y++)
+		{
+			float y0 = (-1.f + 2.f * y / GRID_Y) * tanY;
+			float y1 = (-1.f + 2.f * (y + 1) / GRID_Y) * tanY;
+			for (int x = 0; x < GRID_X; x++)
+			{
+				float x0 = (-1.f + 2.f * x / GRID_X) * tanX;
+				float x1 = (-1.f + 2.f * (x + 1) / GRID_X) * tanX;
+				// The tile's frustum widens with depth, so its bounds are
+				// the extremes of the near and far corners
+				int c = x + GRID_X * (y + GRID_Y * z);
+				minX[c] = std::min(x0 * d0, x0 * d1);
+				maxX[c] = std::max(x1 * d0, x1 * d1);
+				minY[c] = std::min(y0 * d0, y0 * d1);
+				maxY[c] = std::max(y1 * d0, y1 * d1);
+				minZ[c] = -d1;
+				maxZ[c] = -d0;
+			}
+		}
+	}
+}
+
+int LightClusters::sliceOf(float depth) const
+{
+	if (depth <= sliceNear)
+	{
+		return 0;
+	}
+	int slice = (int) (std::log(depth) * sliceScale + sliceBias);
+	return std::min(std::max(slice, 0), GRID_Z - 1);
+}
+
+// Bit i set if cluster first + i is within r of c
+static unsigned testLanes(const float *minX, const float *minY, const float *minZ,
+	const float *maxX, const float *maxY, const float *maxZ, const vec4 &sphere)
+{
+#if defined(LIGHTCLUSTERS_AVX)
+	__m256 zero = _mm256_setzero_ps();
+	__m256 cx = _mm256_set1_ps(sphere.x);
+	__m256 cy = _mm256_set1_ps(sphere.y);
+	__m256 cz = _mm256_set1_ps(sphere.z);
+	// Distance outside the box along each axis, 0 inside
+	__m256 dx = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(minX), cx), _mm256_sub_ps(cx, _mm256_loadu_ps(maxX))), zero);
+	__m256 dy = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(minY), cy), _mm256_sub_ps(cy, _mm256_loadu_ps(maxY))), zero);
+	__m256 dz = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(minZ), cz), _mm256_sub_ps(cz, _mm256_loadu_ps(maxZ))), zero);
+	__m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+	return (unsigned) _mm256_movemask_ps(_mm256_cmp_ps(d2, _mm256_set1_ps(sphere.w * sphere.w), _CMP_LE_OQ));
+#elif defined(LIGHTCLUSTERS_SSE2)
+	__m128 zero = _mm_setzero_ps();
+	__m128 cx = _mm_set1_ps(sphere.x);
+	__m128 cy = _mm_set1_ps(sphere.y);
+	__m128 cz = _mm_set1_ps(sphere.z);
+	// Distance outside the box along each axis, 0 inside
+	__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minX), cx), _mm_sub_ps(cx, _mm_loadu_ps(maxX))), zero);
+	__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minY), cy), _mm_sub_ps(cy, _mm_loadu_ps(maxY))), zero);
+	__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(minZ), cz), _mm_sub_ps(cz, _mm_loadu_ps(maxZ))), zero);
+	__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+	return (unsigned) _mm_movemask_ps(_mm_cmple_ps(d2, _mm_set1_ps(sphere.w * sphere.w)));
+#else
+	float dx = std::max(std::max(*minX - sphere.x, sphere.x - *maxX), 0.f);
+	float dy = std::max(std::max(*minY - sphere.y, sphere.y - *maxY), 0.f);
+	float dz = std::max(std::max(*minZ - sphere.z, sphere.z - *maxZ), 0.f);
+	return dx * dx + dy * dy + dz * dz <= sphere.w * sphere.w ? 1u : 0u;
+#endif
+}
+
+void LightClusters::build(const vector<vec4> &spheres, uint32_t firstIndex)
+{
+	stats = Stats();
+	hits.clear();
+	cells.assign(CLUSTER_COUNT, Cell{0, 0});
+	if (minX.empty())
+	{
+		indices.clear();
+		return;
+	}
+
+	for (size_t i = 0; i < spheres.size(); i++)
+	{
+		const vec4 &sphere = spheres[i];
+		float depth = -sphere.z;
+		if (depth + sphere.w < nearPlane || depth - sphere.w > farPlane)
+		{
+			continue;
+		}
+		stats.lights++;
+		int lastSlice = sliceOf(depth + sphere.w);
+		for (int slice = sliceOf(depth - sphere.w); slice <= lastSlice; slice++)
+		{
+			for (int first = slice * SLICE_CLUSTERS; first < (slice + 1) * SLICE_CLUSTERS; first += LANES)
+			{
+				unsigned inRange = testLanes(&minX[first], &minY[first], &minZ[first], &maxX[first], &maxY[first], &maxZ[first], sphere);
+				for (uint32_t cluster = first; inRange != 0; cluster++, inRange >>= 1)
+				{
+					if (inRange & 1u)
+					{
+						hits.push_back(cluster << 16 | (uint32_t) i);
+					}
+				}
+			}
+		}
+	}
+
+	// Counting sort by cluster; each list stays in light order
+	for (uint32_t hit : hits)
+	{
+		cells[hit >> 16].count++;
+	}
+	uint32_t offset = 0;
+	for (Cell &cell : cells)
+	{
+		stats.maxPerCluster = std::max(stats.maxPerCluster, (int) cell.count);
+		cell.offset = offset;
+		cell.count = std::min(cell.count, (uint32_t) maxReferences - offset);
+		offset += cell.count;
+	}
+	stats.references = (int) offset;
+	stats.dropped = (int) hits.size() - (int) offset;
+
+	indices.resize(offset);
+	cursors.resize(CLUSTER_COUNT);
+	for (int c = 0; c < CLUSTER_COUNT; c++)
+	{
+		cursors[c] = cells[c].offset;
+	}
+	for (uint32_t hit : hits)
+	{
+		const Cell &cell = cells[hit >> 16];
+		uint32_t &cursor = cursors[hit >> 16];
+		if (cursor < cell.offset + cell.count)
+		{
+			indices[cursor++] = (uint16_t) (firstIndex + (hit & 0xffff));
+		}
+	}
+}
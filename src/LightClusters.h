@@ -0,0 +1,97 @@
+#pragma once
+
+#ifndef LAB471_LIGHTCLUSTERS_H_INCLUDED
+#define LAB471_LIGHTCLUSTERS_H_INCLUDED
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+
+/**
+ * Clustered forward lighting, CPU side: splits the view frustum into a grid
+ * of screen tiles times depth slices, and lists for each cluster the point
+ * lights whose range reaches it. A fragment then only loops over the lights
+ * of its own cluster.
+ *
+ * Slices are spaced exponentially in view depth, so clusters stay roughly
+ * cube shaped; everything nearer than SLICE_NEAR falls in the first one.
+ * Each light's sphere is tested against the view space bounds of every
+ * cluster in the slices it spans, 8 (AVX) or 4 (SSE2) clusters at a time;
+ * AVX only when the build enables it (ENGINE_AVX in CMake).
+ */
+class LightClusters
+{
+
+public:
+
+	static const int GRID_X = 16;
+	static const int GRID_Y = 9;
+	static const int GRID_Z = 24;
+	static const int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+	// Default cap on the total length of the light lists; references past
+	// the cap are dropped (and counted)
+	static const size_t MAX_REFERENCES = 1 << 20;
+	static const float SLICE_NEAR;
+
+	// Where a cluster's lights are in the index list
+	struct Cell
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	struct Stats
+	{
+		int lights = 0;
+		int references = 0;
+		int maxPerCluster = 0;
+		int dropped = 0;
+	};
+
+	void setMaxReferences(size_t n) { maxReferences = n; }
+	size_t getMaxReferences() const { return maxReferences; }
+
+	// From a perspective projection; only rebuilds the cluster bounds if it
+	// changed
+	void setProjection(const glm::mat4 &P);
+
+	// Point lights in view space, as (x, y, z, range). Indices in the lists
+	// are firstIndex + the light's position in spheres.
+	void build(const std::vector<glm::vec4> &spheres, uint32_t firstIndex);
+
+	// Cells in x, then y (from the bottom of the screen), then depth order
+	const std::vector<Cell> & getCells() const { return cells; }
+	const std::vector<uint16_t> & getIndices() const { return indices; }
+	const Stats & getStats() const { return stats; }
+
+	// Slice of a view depth d is floor(log(d) * scale + bias)
+	float getSliceScale() const { return sliceScale; }
+	float getSliceBias() const { return sliceBias; }
+
+private:
+
+	int sliceOf(float depth) const;
+
+	glm::vec4 projection = glm::vec4(0.f);
+	float sliceScale = 0.f;
+	float sliceBias = 0.f;
+	float nearPlane = 0.f;
+	float farPlane = 0.f;
+	float sliceNear = 0.f;
+	size_t maxReferences = MAX_REFERENCES;
+
+	// Cluster bounds in view space, one array per component, for SIMD
+	std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+
+	// (cluster << 16 | light) for every hit, before sorting by cluster
+	std::vector<uint32_t> hits;
+	// Next free index of each cell while scattering
+	std::vector<uint32_t> cursors;
+	std::vector<Cell> cells;
+	std::vector<uint16_t> indices;
+	Stats stats;
+
+};
+
+#endif // LAB471_LIGHTCLUSTERS_H_INCLUDED
@@ -0,0 +1,165 @@
+#include "LightSet.h"
+#include "GLSL.h"
+#include "GLState.h"
+#include "Program.h"
+#include <algorithm>
+
+using namespace std;
+using namespace glm;
+
+const int LightSet::MAX_LIGHTS;
+const GLuint LightSet::BINDING;
+const char * const LightSet::BLOCK_NAME = "Lights";
+const GLuint LightSet::DATA_UNIT;
+const GLuint LightSet::CELLS_UNIT;
+const GLuint LightSet::LISTS_UNIT;
+
+// The uniform block, std140
+struct Block
+{
+	GLint lightCounts[4];
+	GLint clusterGrid[4];
+	GLfloat clusterScale[4];
+};
+
+static const char *SAMPLER_NAMES[3] = {"LightData", "ClusterCells", "ClusterLights"};
+static const GLuint UNITS[3] = {LightSet::DATA_UNIT, LightSet::CELLS_UNIT, LightSet::LISTS_UNIT};
+static const GLenum FORMATS[3] = {GL_RGBA32F, GL_RG32UI, GL_R16UI};
+
+static_assert(LightSet::MAX_LIGHTS <= 65536, "light lists hold 16 bit indices");
+
+LightSet::~LightSet()
+{
+	if (ubo != 0)
+	{
+		GLState::deleteBuffer(ubo);
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		if (textures[i] != 0)
+		{
+			GLState::deleteTexture(textures[i]);
+			GLState::deleteBuffer(buffers[i]);
+		}
+	}
+}
+
+bool LightSet::init()
+{
+	CHECKED_GL_CALL(glGenBuffers(1, &ubo));
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+	CHECKED_GL_CALL(glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW));
+	// Stays bound there: orphaning keeps the buffer's name
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+
+	// GL 3.3 only promises 64K texels per texture buffer, but most allow far
+	// more
+	GLint maxTexels = 0;
+	CHECKED_GL_CALL(glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels));
+	clusters.setMaxReferences(std::min((size_t) std::max(maxTexels, 65536), LightClusters::MAX_REFERENCES));
+	capacities[0] = 2 * MAX_LIGHTS * sizeof(vec4);
+	capacities[1] = LightClusters::CLUSTER_COUNT * sizeof(LightClusters::Cell);
+	capacities[2] = clusters.getMaxReferences() * sizeof(uint16_t);
+
+	CHECKED_GL_CALL(glGenBuffers(3, buffers));
+	CHECKED_GL_CALL(glGenTextures(3, textures));
+	for (int i = 0; i < 3; i++)
+	{
+		GLState::bindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		CHECKED_GL_CALL(glBufferData(GL_TEXTURE_BUFFER, capacities[i], nullptr, GL_DYNAMIC_DRAW));
+		GLState::bindTexture(UNITS[i], GL_TEXTURE_BUFFER, textures[i]);
+		CHECKED_GL_CALL(glTexBuffer(GL_TEXTURE_BUFFER, FORMATS[i], buffers[i]));
+	}
+	return ubo != 0 && textures[2] != 0;
+}
+
+void LightSet::attach(Program &program)
+{
+	program.bindUniformBlock(BLOCK_NAME, BINDING);
+	for (int i = 0; i < 3; i++)
+	{
+		program.bindSampler(SAMPLER_NAMES[i], UNITS[i]);
+	}
+}
+
+int LightSet::add(const Light &light)
+{
+	if (lights.size() >= (size_t) MAX_LIGHTS)
+	{
+		return -1;
+	}
+	lights.push_back(light);
+	return (int) lights.size() - 1;
+}
+
+int LightSet::getDirectionalIndex(int i) const
+{
+	// upload() keeps the directional lights in order, ahead of the rest
+	int index = 0;
+	for (int j = 0; j < i; j++)
+	{
+		if (lights[j].directional)
+		{
+			index++;
+		}
+	}
+	return index;
+}
+
+// Orphans last frame's copy rather than wait for draws still reading it,
+// then writes only the part in use
+static void update(GLenum target, GLuint buffer, size_t capacity, const void *source, size_t size)
+{
+	GLState::bindBuffer(target, buffer);
+	CHECKED_GL_CALL(glBufferData(target, capacity, nullptr, GL_DYNAMIC_DRAW));
+	if (size > 0)
+	{
+		CHECKED_GL_CALL(glBufferSubData(target, 0, size, source));
+	}
+}
+
+void LightSet::upload(const mat4 &V, const mat4 &P, int width, int height)
+{
+	data.clear();
+	spheres.clear();
+	for (const Light &light : lights)
+	{
+		if (light.directional)
+		{
+			// w is 0, so V's translation drops out
+			data.push_back(vec4(normalize(vec3(V * vec4(light.position, 0.f))), 0.f));
+			data.push_back(vec4(light.color, light.range));
+		}
+	}
+	GLint directionalCount = (GLint) data.size() / 2;
+	for (const Light &light : lights)
+	{
+		if (! light.directional)
+		{
+			vec4 position = V * vec4(light.position, 1.f);
+			data.push_back(position);
+			data.push_back(vec4(light.color, light.range));
+			spheres.push_back(vec4(vec3(position), light.range));
+		}
+	}
+
+	clusters.setProjection(P);
+	clusters.build(spheres, directionalCount);
+
+	Block block = {
+		{directionalCount, (GLint) lights.size(), 0, 0},
+		{LightClusters::GRID_X, LightClusters::GRID_Y, LightClusters::GRID_Z, 0},
+		{LightClusters::GRID_X / (float) std::max(width, 1), LightClusters::GRID_Y / (float) std::max(height, 1),
+			clusters.getSliceScale(), clusters.getSliceBias()}
+	};
+	update(GL_UNIFORM_BUFFER, ubo, sizeof(Block), &block, sizeof(Block));
+	update(GL_TEXTURE_BUFFER, buffers[0], capacities[0], data.data(), data.size() * sizeof(vec4));
+	update(GL_TEXTURE_BUFFER, buffers[1], capacities[1], clusters.getCells().data(), clusters.getCells().size() * sizeof(LightClusters::Cell));
+	update(GL_TEXTURE_BUFFER, buffers[2], capacities[2], clusters.getIndices().data(), clusters.getIndices().size() * sizeof(uint16_t));
+
+	// Units nothing else uses, so these binds are elided after the first
+	for (int i = 0; i < 3; i++)
+	{
+		GLState::bindTexture(UNITS[i], GL_TEXTURE_BUFFER, textures[i]);
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#ifndef LAB471_LIGHTSET_H_INCLUDED
+#define LAB471_LIGHTSET_H_INCLUDED
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "LightClusters.h"
+
+class Program;
+
+
+/**
+ * The scene's lights, shared by every lit shader.
+ *
+ * Once per frame they are moved into view space and the point lights are
+ * binned into LightClusters, so each fragment only shades with the lights
+ * that reach its cluster. Shaders read the lights, the cluster cells and the
+ * per-cluster light lists from three texture buffers, and the grid layout
+ * from a small uniform block ("Lights" in surface_frag.glsl). Point lights
+ * fade smoothly to nothing at their range; directional lights reach every
+ * fragment.
+ */
+class LightSet
+{
+
+public:
+
+	// Light indices in the lists are 16 bit
+	static const int MAX_LIGHTS = 1024;
+	// Uniform buffer binding point of the block
+	static const GLuint BINDING = 0;
+	static const char * const BLOCK_NAME;
+	// Texture units of the buffers, clear of the scene's and the HUD's
+	static const GLuint DATA_UNIT = 12;
+	static const GLuint CELLS_UNIT = 13;
+	static const GLuint LISTS_UNIT = 14;
+
+	struct Light
+	{
+		// Point lights: position. Directional lights: direction towards
+		// the light.
+		glm::vec3 position;
+		glm::vec3 color = glm::vec3(1.f);
+		float range = 100.f;
+		bool directional = false;
+	};
+
+	LightSet() = default;
+	LightSet(const LightSet &) = delete;
+	LightSet & operator=(const LightSet &) = delete;
+	~LightSet();
+
+	// Creates the buffers and binds the uniform block to BINDING
+	bool init();
+	// Points a lit program's block and samplers at them
+	static void attach(Program &program);
+
+	// Returns the light's index, or -1 if there are MAX_LIGHTS already
+	int add(const Light &light);
+	Light & get(int i) { return lights[i]; }
+	size_t getCount() const { return lights.size(); }
+	// Where directional light i ends up among the ones the shaders see
+	int getDirectionalIndex(int i) const;
+	void clear() { lights.clear(); }
+
+	// Moves the lights into view space, bins them for this projection and
+	// viewport, and uploads the lot
+	void upload(const glm::mat4 &V, const glm::mat4 &P, int width, int height);
+
+	const LightClusters & getClusters() const { return clusters; }
+
+private:
+
+	std::vector<Light> lights;
+	LightClusters clusters;
+
+	GLuint ubo = 0;
+	// Texture buffers: [light data, cluster cells, light lists]
+	GLuint buffers[3] = {};
+	GLuint textures[3] = {};
+	size_t capacities[3] = {};
+
+	// Two texels per light, directional lights first: view space position
+	// (w 0 for directions) and color with the range in a
+	std::vector<glm::vec4> data;
+	// Point lights in view space with their ranges, to bin
+	std::vector<glm::vec4> spheres;
+
+};
+
+#endif // LAB471_LIGHTSET_H_INCLUDED
@@ -0,0 +1,139 @@
+#include "MeshLOD.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace MeshLOD
+{
+
+static const char Identifier[8] = {'L', 'A', 'B', 'L', 'O', 'D', '0', '1'};
+
+std::string fileNameFor(const std::string &objName)
+{
+	size_t dot = objName.find_last_of('.');
+	size_t slash = objName.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+	{
+		return objName + ".lod";
+	}
+	return objName.substr(0, dot) + ".lod";
+}
+
+static void put(std::ofstream &file, uint32_t value)
+{
+	file.write((const char *) &value, sizeof(value));
+}
+
+static bool get(std::ifstream &file, uint32_t &value)
+{
+	return (bool) file.read((char *) &value, sizeof(value));
+}
+
+// Whether the rest of the file could hold count records of at least
+// recordSize bytes each, so a corrupt count can't make a huge allocation
+static bool fits(std::ifstream &file, uint32_t count, size_t recordSize)
+{
+	std::streampos here = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff left = file.tellg() - here;
+	file.seekg(here);
+	return file && (uint64_t) count * recordSize <= (uint64_t) left;
+}
+
+bool write(const std::string &fileName, const std::vector<Mesh> &meshes)
+{
+	std::ofstream file(fileName, std::ios::binary);
+	if (! file.is_open())
+	{
+		return false;
+	}
+
+	file.write(Identifier, sizeof(Identifier));
+	put(file, (uint32_t) meshes.size());
+	for (const Mesh &mesh : meshes)
+	{
+		put(file, mesh.vertexCount);
+		put(file, mesh.indexCount);
+		put(file, (uint32_t) mesh.levels.size());
+		for (const Level &level : mesh.levels)
+		{
+			file.write((const char *) &level.error, sizeof(level.error));
+			put(file, (uint32_t) level.indices.size());
+			file.write((const char *) level.indices.data(), level.indices.size() * sizeof(unsigned int));
+		}
+	}
+	return file.good();
+}
+
+bool read(const std::string &fileName, std::vector<Mesh> &meshes, std::string &err)
+{
+	meshes.clear();
+	std::ifstream file(fileName, std::ios::binary);
+	if (! file.is_open())
+	{
+		return false;
+	}
+
+	char identifier[sizeof(Identifier)];
+	uint32_t meshCount = 0;
+	if (! file.read(identifier, sizeof(identifier)) || memcmp(identifier, Identifier, sizeof(Identifier)) != 0
+		|| ! get(file, meshCount))
+	{
+		err = "not a LOD file";
+		return false;
+	}
+	// Each mesh has its vertex, index and level counts
+	if (! fits(file, meshCount, 3 * sizeof(uint32_t)))
+	{
+		err = "truncated";
+		return false;
+	}
+	meshes.resize(meshCount);
+	for (Mesh &mesh : meshes)
+	{
+		uint32_t levelCount = 0;
+		if (! get(file, mesh.vertexCount) || ! get(file, mesh.indexCount) || ! get(file, levelCount))
+		{
+			err = "truncated";
+			return false;
+		}
+		// Each level has its error and index count
+		if (! fits(file, levelCount, sizeof(float) + sizeof(uint32_t)))
+		{
+			err = "truncated";
+			return false;
+		}
+		mesh.levels.resize(levelCount);
+		for (Level &level : mesh.levels)
+		{
+			uint32_t indexCount = 0;
+			if (! file.read((char *) &level.error, sizeof(level.error)) || ! get(file, indexCount))
+			{
+				err = "truncated";
+				return false;
+			}
+			if (! fits(file, indexCount, sizeof(unsigned int)))
+			{
+				err = "truncated";
+				return false;
+			}
+			level.indices.resize(indexCount);
+			if (! file.read((char *) level.indices.data(), indexCount * sizeof(unsigned int)))
+			{
+				err = "truncated";
+				return false;
+			}
+			for (unsigned int index : level.indices)
+			{
+				if (index >= mesh.vertexCount)
+				{
+					err = "index out of range";
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+}
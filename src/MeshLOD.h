@@ -0,0 +1,45 @@
+#pragma once
+
+#ifndef LAB471_MESHLOD_H_INCLUDED
+#define LAB471_MESHLOD_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+
+/**
+ * Baked levels of detail of an OBJ file: foo.obj -> foo.lod, written by
+ * tools/meshbake.cpp and read by Shape.
+ *
+ * Each level is an index list into the shape's own vertices, so the levels
+ * of a shape share its vertex buffers. The vertex and index counts of the
+ * full mesh are stored too, to notice a .lod older than its .obj.
+ */
+
+namespace MeshLOD
+{
+
+	struct Level
+	{
+		// Largest distance the surface moved, in the mesh's units
+		float error = 0.f;
+		std::vector<unsigned int> indices;
+	};
+
+	// One per shape in the OBJ file, in file order
+	struct Mesh
+	{
+		unsigned int vertexCount = 0;
+		unsigned int indexCount = 0;
+		// Coarser and coarser, not counting the full mesh
+		std::vector<Level> levels;
+	};
+
+	std::string fileNameFor(const std::string &objName);
+
+	bool write(const std::string &fileName, const std::vector<Mesh> &meshes);
+	// False, quietly, if there is no such file
+	bool read(const std::string &fileName, std::vector<Mesh> &meshes, std::string &err);
+}
+
+#endif // LAB471_MESHLOD_H_INCLUDED
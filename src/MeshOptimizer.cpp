@@ -0,0 +1,412 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+// Pixels across each view analyzeOverdraw rasterizes
+static const int OVERDRAW_GRID = 256;
+
+namespace MeshOptimizer
+{
+
+CacheStats & CacheStats::operator+=(const CacheStats &other)
+{
+	transforms += other.transforms;
+	triangles += other.triangles;
+	vertices += other.vertices;
+	return *this;
+}
+
+OverdrawStats & OverdrawStats::operator+=(const OverdrawStats &other)
+{
+	covered += other.covered;
+	shaded += other.shaded;
+	return *this;
+}
+
+static vec3 positionOf(const vector<float> &positions, unsigned int v)
+{
+	return vec3(positions[3 * v], positions[3 * v + 1], positions[3 * v + 2]);
+}
+
+CacheStats analyzeVertexCache(const unsigned int *indices, size_t indexCount, size_t vertexCount, int cacheSize)
+{
+	CacheStats stats;
+	stats.triangles = indexCount / 3;
+
+	// A vertex is cached if fewer than cacheSize misses came after its own
+	vector<size_t> missedAt(vertexCount, 0);
+	vector<bool> used(vertexCount, false);
+	size_t time = cacheSize + 1;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		unsigned int v = indices[i];
+		if (time - missedAt[v] > (size_t) cacheSize)
+		{
+			missedAt[v] = time++;
+			stats.transforms++;
+		}
+		if (! used[v])
+		{
+			used[v] = true;
+			stats.vertices++;
+		}
+	}
+	return stats;
+}
+
+OverdrawStats analyzeOverdraw(const unsigned int *indices, size_t indexCount, const vector<float> &positions)
+{
+	OverdrawStats stats;
+	size_t vertexCount = positions.size() / 3;
+	if (vertexCount == 0)
+	{
+		return stats;
+	}
+
+	// Into the unit cube, keeping proportions
+	vec3 low = positionOf(positions, 0), high = low;
+	for (size_t v = 1; v < vertexCount; v++)
+	{
+		low = glm::min(low, positionOf(positions, (unsigned int) v));
+		high = glm::max(high, positionOf(positions, (unsigned int) v));
+	}
+	vec3 size = high - low;
+	float extent = std::max(std::max(size.x, size.y), std::max(size.z, 1e-6f));
+
+	vector<float> depth(OVERDRAW_GRID * OVERDRAW_GRID);
+	for (int view = 0; view < 6; view++)
+	{
+		std::fill(depth.begin(), depth.end(), -1.f);
+		for (size_t i = 0; i + 2 < indexCount; i += 3)
+		{
+			// Looking down -z after rotating the axis of this view onto z;
+			// for the opposite direction, flip x and z as well
+			vec3 p[3];
+			for (int k = 0; k < 3; k++)
+			{
+				vec3 q = (positionOf(positions, indices[i + k]) - low) / extent;
+				int axis = view % 3;
+				p[k] = axis == 0 ? vec3(q.y, q.z, q.x) : axis == 1 ? vec3(q.z, q.x, q.y) : q;
+				if (view >= 3)
+				{
+					p[k] = vec3(1.f - p[k].x, p[k].y, 1.f - p[k].z);
+				}
+				p[k].x *= OVERDRAW_GRID;
+				p[k].y *= OVERDRAW_GRID;
+			}
+			float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+			if (area <= 0.f)
+			{
+				// Back facing or edge on
+				continue;
+			}
+			int x0 = std::max((int) std::floor(std::min(std::min(p[0].x, p[1].x), p[2].x)), 0);
+			int x1 = std::min((int) std::ceil(std::max(std::max(p[0].x, p[1].x), p[2].x)), OVERDRAW_GRID - 1);
+			int y0 = std::max((int) std::floor(std::min(std::min(p[0].y, p[1].y), p[2].y)), 0);
+			int y1 = std::min((int) std::ceil(std::max(std::max(p[0].y, p[1].y), p[2].y)), OVERDRAW_GRID - 1);
+			for (int y = y0; y <= y1; y++)
+			{
+				for (int x = x0; x <= x1; x++)
+				{
+					float px = x + .5f, py = y + .5f;
+					float w0 = (p[2].x - p[1].x) * (py - p[1].y) - (px - p[1].x) * (p[2].y - p[1].y);
+					float w1 = (p[0].x - p[2].x) * (py - p[2].y) - (px - p[2].x) * (p[0].y - p[2].y);
+					float w2 = area - w0 - w1;
+					if (w0 < 0.f || w1 < 0.f || w2 < 0.f)
+					{
+						continue;
+					}
+					float z = (w0 * p[0].z + w1 * p[1].z + w2 * p[2].z) / area;
+					float &stored = depth[y * OVERDRAW_GRID + x];
+					if (stored < 0.f)
+					{
+						stats.covered++;
+					}
+					// Nearer is higher z
+					if (z > stored)
+					{
+						stored = z;
+						stats.shaded++;
+					}
+				}
+			}
+		}
+	}
+	return stats;
+}
+
+void optimizeVertexCache(unsigned int *indices, size_t indexCount, size_t vertexCount, int cacheSize, vector<size_t> *clusters)
+{
+	if (clusters)
+	{
+		clusters->clear();
+	}
+
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Triangles around each vertex, as offsets into one array
+	vector<unsigned int> live(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		live[indices[i]]++;
+	}
+	vector<size_t> firstTriangle(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		firstTriangle[v + 1] = firstTriangle[v] + live[v];
+	}
+	vector<unsigned int> adjacency(triangleCount * 3);
+	vector<size_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		adjacency[fill[indices[i]]++] = (unsigned int) (i / 3);
+	}
+
+	vector<unsigned int> result;
+	result.reserve(triangleCount * 3);
+	vector<bool> emitted(triangleCount, false);
+	vector<size_t> cachedAt(vertexCount, 0);
+	// Vertices of recent triangles, to fall back to at a dead end
+	vector<unsigned int> deadEnd;
+	vector<unsigned int> candidates;
+	size_t time = cacheSize + 1;
+	size_t cursor = 0;
+	long long fan = indices[0];
+	bool deadEnded = true;
+
+	while (fan >= 0)
+	{
+		if (clusters && deadEnded)
+		{
+			clusters->push_back(result.size() / 3);
+		}
+		candidates.clear();
+		for (size_t a = firstTriangle[fan]; a < firstTriangle[fan + 1]; a++)
+		{
+			unsigned int t = adjacency[a];
+			if (emitted[t])
+			{
+				continue;
+			}
+			emitted[t] = true;
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[3 * t + k];
+				result.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cachedAt[v] > (size_t) cacheSize)
+				{
+					cachedAt[v] = time++;
+				}
+			}
+		}
+
+		// Next, the candidate that will still be cached by the time its
+		// remaining triangles are emitted and has been there longest
+		fan = -1;
+		long long bestPriority = -1;
+		for (unsigned int v : candidates)
+		{
+			if (live[v] == 0)
+			{
+				continue;
+			}
+			long long priority = 0;
+			if (time - cachedAt[v] + 2 * live[v] <= (size_t) cacheSize)
+			{
+				priority = (long long) (time - cachedAt[v]);
+			}
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				fan = v;
+			}
+		}
+
+		// Dead end: the most recent vertex with triangles left, or else the
+		// next one in index order
+		deadEnded = fan < 0;
+		while (fan < 0 && ! deadEnd.empty())
+		{
+			unsigned int v = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[v] > 0)
+			{
+				fan = v;
+			}
+		}
+		while (fan < 0 && cursor < vertexCount)
+		{
+			if (live[cursor] > 0)
+			{
+				fan = (long long) cursor;
+			}
+			cursor++;
+		}
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+void optimizeOverdraw(unsigned int *indices, size_t indexCount, const vector<float> &positions,
+	const vector<size_t> &clusters, float threshold, int cacheSize)
+{
+	size_t triangleCount = indexCount / 3;
+	size_t vertexCount = positions.size() / 3;
+	if (triangleCount == 0 || clusters.empty())
+	{
+		return;
+	}
+	float limit = analyzeVertexCache(indices, triangleCount * 3, vertexCount, cacheSize).acmr() * threshold;
+
+	// Cut each cluster where its ACMR so far, from a cold cache, is within
+	// the limit; the cuts may cost a cold cache each, and no more
+	vector<size_t> starts;
+	vector<size_t> missedAt(vertexCount, 0);
+	size_t time = cacheSize + 1;
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		size_t firstPiece = starts.size();
+		starts.push_back(clusters[c]);
+		time += cacheSize + 1;
+		size_t transforms = 0, triangles = 0;
+		for (size_t t = clusters[c]; t < end; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[3 * t + k];
+				if (time - missedAt[v] > (size_t) cacheSize)
+				{
+					missedAt[v] = time++;
+					transforms++;
+				}
+			}
+			triangles++;
+			if (t + 1 < end && transforms <= limit * triangles)
+			{
+				starts.push_back(t + 1);
+				time += cacheSize + 1;
+				transforms = 0;
+				triangles = 0;
+			}
+		}
+		// A tail that never got within the limit stays with the piece
+		// before it
+		if (starts.size() > firstPiece + 1 && transforms > limit * triangles)
+		{
+			starts.pop_back();
+		}
+	}
+
+	// Area weighted centroid and normal of each cluster and of the mesh
+	struct Cluster
+	{
+		size_t first;
+		size_t end;
+		vec3 centroid;
+		vec3 normal;
+		float area;
+		float facing;
+	};
+	vector<Cluster> parts(starts.size());
+	vec3 meshCentroid(0.f);
+	float meshArea = 0.f;
+	for (size_t c = 0; c < starts.size(); c++)
+	{
+		Cluster &part = parts[c];
+		part.first = starts[c];
+		part.end = c + 1 < starts.size() ? starts[c + 1] : triangleCount;
+		part.centroid = part.normal = vec3(0.f);
+		part.area = 0.f;
+		for (size_t t = part.first; t < part.end; t++)
+		{
+			vec3 a = positionOf(positions, indices[3 * t]);
+			vec3 b = positionOf(positions, indices[3 * t + 1]);
+			vec3 d = positionOf(positions, indices[3 * t + 2]);
+			vec3 normal = cross(b - a, d - a);
+			float area = length(normal);
+			part.centroid += area * (a + b + d) / 3.f;
+			part.normal += normal;
+			part.area += area;
+		}
+		meshCentroid += part.centroid;
+		meshArea += part.area;
+		if (part.area > 0.f)
+		{
+			part.centroid /= part.area;
+		}
+	}
+	if (meshArea > 0.f)
+	{
+		meshCentroid /= meshArea;
+	}
+
+	// How far out the cluster lies along its own normal: the further, the
+	// more of the mesh it can hide
+	for (Cluster &part : parts)
+	{
+		float normalLength = length(part.normal);
+		part.facing = normalLength > 0.f ? dot(part.centroid - meshCentroid, part.normal / normalLength) : 0.f;
+	}
+	std::stable_sort(parts.begin(), parts.end(), [](const Cluster &a, const Cluster &b) { return a.facing > b.facing; });
+
+	vector<unsigned int> result;
+	result.reserve(triangleCount * 3);
+	for (const Cluster &part : parts)
+	{
+		result.insert(result.end(), indices + 3 * part.first, indices + 3 * part.end);
+	}
+	std::copy(result.begin(), result.end(), indices);
+}
+
+void optimizeVertexFetch(vector<unsigned int> &indices, size_t vertexCount, vector<unsigned int> &remap)
+{
+	const unsigned int unused = ~0u;
+	remap.assign(vertexCount, unused);
+	unsigned int next = 0;
+	for (unsigned int &index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = next++;
+		}
+		index = remap[index];
+	}
+	for (unsigned int &slot : remap)
+	{
+		if (slot == unused)
+		{
+			slot = next++;
+		}
+	}
+}
+
+void remapVertices(vector<float> &attribute, int components, const vector<unsigned int> &remap)
+{
+	if (attribute.empty())
+	{
+		return;
+	}
+	vector<float> moved(attribute.size());
+	for (size_t v = 0; v < remap.size(); v++)
+	{
+		for (int c = 0; c < components; c++)
+		{
+			moved[remap[v] * components + c] = attribute[v * components + c];
+		}
+	}
+	attribute.swap(moved);
+}
+
+}
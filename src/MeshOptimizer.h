@@ -0,0 +1,88 @@
+#pragma once
+
+#ifndef LAB471_MESHOPTIMIZER_H_INCLUDED
+#define LAB471_MESHOPTIMIZER_H_INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+
+/**
+ * Index and vertex reordering for the GPU's post-transform vertex cache,
+ * overdraw and vertex fetches. Shape runs all three on every mesh it loads;
+ * meshbake reports what they gain.
+ *
+ * OBJ files list triangles in whatever order the modeller left them, so a
+ * vertex is often shaded again because it dropped out of the cache before
+ * its next triangle came along. Tipsify (Sander, Nehab and Barczak, 2007)
+ * emits triangles in fans around vertices still likely to be cached, in
+ * linear time. Its output is then cut into clusters that each cost little
+ * more in the cache than the whole mesh does, and the clusters are sorted
+ * so those facing outwards, which tend to hide the rest, are drawn first
+ * (the same paper's overdraw step). Renumbering the vertices in the order
+ * the triangles then use them makes the vertex fetches read memory nearly
+ * in order.
+ */
+
+namespace MeshOptimizer
+{
+
+	// The FIFO cache size optimized for and simulated
+	static const int CACHE_SIZE = 16;
+
+	// Transforms counted by a FIFO cache simulation
+	struct CacheStats
+	{
+		size_t transforms = 0;
+		size_t triangles = 0;
+		// Distinct vertices used
+		size_t vertices = 0;
+
+		// Average cache miss ratio: transforms per triangle, 0.5 at best
+		float acmr() const { return triangles ? transforms / (float) triangles : 0.f; }
+		// Average transform to vertex ratio: 1 at best
+		float atvr() const { return vertices ? transforms / (float) vertices : 0.f; }
+		CacheStats & operator+=(const CacheStats &other);
+	};
+
+	// Fragments counted by rasterizing the mesh, back faces culled and depth
+	// tested, from the six axis directions
+	struct OverdrawStats
+	{
+		size_t covered = 0;
+		size_t shaded = 0;
+
+		// Fragments shaded per pixel covered: 1 at best
+		float overdraw() const { return covered ? shaded / (float) covered : 0.f; }
+		OverdrawStats & operator+=(const OverdrawStats &other);
+	};
+
+	CacheStats analyzeVertexCache(const unsigned int *indices, size_t indexCount, size_t vertexCount, int cacheSize = CACHE_SIZE);
+
+	// positions has three floats per vertex
+	OverdrawStats analyzeOverdraw(const unsigned int *indices, size_t indexCount, const std::vector<float> &positions);
+
+	// Reorders the triangles, in place, with Tipsify. If clusters is given it
+	// gets the first triangle of each run between dead ends, for
+	// optimizeOverdraw.
+	void optimizeVertexCache(unsigned int *indices, size_t indexCount, size_t vertexCount, int cacheSize = CACHE_SIZE,
+		std::vector<size_t> *clusters = nullptr);
+
+	// Reorders the clusters optimizeVertexCache found, in place, so outward
+	// facing ones come first. Clusters are first split wherever their own
+	// ACMR, from a cold cache, is within threshold times the whole mesh's;
+	// the vertex cache loses a few percent for the smaller clusters.
+	void optimizeOverdraw(unsigned int *indices, size_t indexCount, const std::vector<float> &positions,
+		const std::vector<size_t> &clusters, float threshold = 1.05f, int cacheSize = CACHE_SIZE);
+
+	// Renumbers the vertices in the order the indices first use them, and
+	// rewrites the indices. remap gets each old vertex's new number; unused
+	// vertices go last.
+	void optimizeVertexFetch(std::vector<unsigned int> &indices, size_t vertexCount, std::vector<unsigned int> &remap);
+
+	// Moves one vertex attribute, of components floats per vertex, to the
+	// positions remap gives
+	void remapVertices(std::vector<float> &attribute, int components, const std::vector<unsigned int> &remap);
+}
+
+#endif // LAB471_MESHOPTIMIZER_H_INCLUDED
@@ -0,0 +1,363 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <utility>
+
+using namespace std;
+using namespace glm;
+
+// Weight of the plane across an open edge or seam, per squared edge length,
+// against the area weight of a triangle's own plane
+static const double BORDER_WEIGHT = 10.0;
+
+MeshSimplifier::MeshSimplifier(const vector<float> &originalPositions, const vector<float> &normals,
+	const vector<float> &texcoords, const vector<unsigned int> &indices) :
+	normals(normals),
+	texcoords(texcoords)
+{
+	// Weld by exact position
+	size_t vertexCount = originalPositions.size() / 3;
+	map<array<float, 3>, unsigned int> byPosition;
+	welds.resize(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		array<float, 3> key = {{originalPositions[3 * i], originalPositions[3 * i + 1], originalPositions[3 * i + 2]}};
+		auto found = byPosition.insert(make_pair(key, (unsigned int) positions.size()));
+		if (found.second)
+		{
+			positions.push_back(vec3(key[0], key[1], key[2]));
+			wedges.push_back(vector<unsigned int>());
+		}
+		welds[i] = found.first->second;
+		wedges[welds[i]].push_back((unsigned int) i);
+	}
+
+	size_t weldedCount = positions.size();
+	Quadric zero = {};
+	quadrics.assign(weldedCount, zero);
+	vertexTriangles.resize(weldedCount);
+	versions.assign(weldedCount, 0);
+	removed.assign(weldedCount, false);
+
+	// Edges used by one triangle only, before welding: open edges and seams
+	map<pair<unsigned int, unsigned int>, int> edgeUses;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int a = indices[i + k];
+			unsigned int b = indices[i + (k + 1) % 3];
+			edgeUses[make_pair(std::min(a, b), std::max(a, b))]++;
+		}
+	}
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		unsigned int w[3] = {welds[indices[i]], welds[indices[i + 1]], welds[indices[i + 2]]};
+		if (w[0] == w[1] || w[1] == w[2] || w[0] == w[2])
+		{
+			continue;
+		}
+		vec3 normal = cross(positions[w[1]] - positions[w[0]], positions[w[2]] - positions[w[0]]);
+		float doubleArea = length(normal);
+		if (doubleArea > 0.f)
+		{
+			normal /= doubleArea;
+			for (int k = 0; k < 3; k++)
+			{
+				addPlane(w[k], normal, positions[w[0]], .5 * doubleArea);
+				quadrics[w[k]].weight += .5 * doubleArea;
+			}
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = indices[i + k];
+				unsigned int b = indices[i + (k + 1) % 3];
+				if (edgeUses[make_pair(std::min(a, b), std::max(a, b))] == 1)
+				{
+					// Through the edge, square to the triangle
+					vec3 edge = positions[welds[b]] - positions[welds[a]];
+					vec3 across = cross(edge, normal);
+					float acrossLength = length(across);
+					if (acrossLength > 0.f)
+					{
+						double weight = BORDER_WEIGHT * dot(edge, edge);
+						addPlane(welds[a], across / acrossLength, positions[welds[a]], weight);
+						addPlane(welds[b], across / acrossLength, positions[welds[a]], weight);
+					}
+				}
+			}
+		}
+
+		unsigned int triangle = (unsigned int) alive.size();
+		for (int k = 0; k < 3; k++)
+		{
+			triangles.push_back(w[k]);
+			corners.push_back(indices[i + k]);
+			vertexTriangles[w[k]].push_back(triangle);
+		}
+		alive.push_back(true);
+		liveTriangles++;
+	}
+
+	for (size_t t = 0; t < alive.size(); t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int a = triangles[3 * t + k];
+			unsigned int b = triangles[3 * t + (k + 1) % 3];
+			// Each shared edge once
+			if (a < b)
+			{
+				push(a, b);
+			}
+		}
+	}
+}
+
+void MeshSimplifier::addPlane(unsigned int vertex, const vec3 &normal, const vec3 &point, double weight)
+{
+	double a = normal.x, b = normal.y, c = normal.z;
+	double d = -(a * point.x + b * point.y + c * point.z);
+	double *q = quadrics[vertex].a;
+	q[0] += weight * a * a; q[1] += weight * a * b; q[2] += weight * a * c; q[3] += weight * a * d;
+	q[4] += weight * b * b; q[5] += weight * b * c; q[6] += weight * b * d;
+	q[7] += weight * c * c; q[8] += weight * c * d;
+	q[9] += weight * d * d;
+}
+
+double MeshSimplifier::cost(unsigned int from, unsigned int to) const
+{
+	double q[10];
+	for (int i = 0; i < 10; i++)
+	{
+		q[i] = quadrics[from].a[i] + quadrics[to].a[i];
+	}
+	double x = positions[to].x, y = positions[to].y, z = positions[to].z;
+	double result = q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+		+ q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y
+		+ q[7] * z * z + 2.0 * q[8] * z
+		+ q[9];
+	// Per unit of area, so it reads as a squared distance
+	double weight = quadrics[from].weight + quadrics[to].weight;
+	return weight > 0.0 ? std::max(result, 0.0) / weight : 0.0;
+}
+
+void MeshSimplifier::push(unsigned int a, unsigned int b)
+{
+	// Both ways: the cheaper one may fold the surface where the other won't
+	Collapse ab = {cost(a, b), a, b, versions[a], versions[b]};
+	Collapse ba = {cost(b, a), b, a, versions[b], versions[a]};
+	queue.push(ab);
+	queue.push(ba);
+}
+
+bool MeshSimplifier::contains(unsigned int triangle, unsigned int vertex) const
+{
+	const unsigned int *t = &triangles[3 * triangle];
+	return t[0] == vertex || t[1] == vertex || t[2] == vertex;
+}
+
+bool MeshSimplifier::allowed(unsigned int from, unsigned int to) const
+{
+	// The triangles on the edge, and the vertices around each end
+	int shared = 0;
+	vector<unsigned int> fromRing, toRing;
+	for (unsigned int t : vertexTriangles[from])
+	{
+		if (! alive[t])
+		{
+			continue;
+		}
+		if (contains(t, to))
+		{
+			shared++;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			fromRing.push_back(triangles[3 * t + k]);
+		}
+	}
+	if (shared == 0)
+	{
+		return false;
+	}
+	for (unsigned int t : vertexTriangles[to])
+	{
+		if (alive[t])
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				toRing.push_back(triangles[3 * t + k]);
+			}
+		}
+	}
+	sort(fromRing.begin(), fromRing.end());
+	fromRing.erase(unique(fromRing.begin(), fromRing.end()), fromRing.end());
+	sort(toRing.begin(), toRing.end());
+	toRing.erase(unique(toRing.begin(), toRing.end()), toRing.end());
+
+	// Only the vertices opposite the edge may be neighbours of both ends,
+	// or the collapse pinches the surface into a non-manifold one
+	int common = 0;
+	for (unsigned int v : fromRing)
+	{
+		if (v != from && v != to && binary_search(toRing.begin(), toRing.end(), v))
+		{
+			common++;
+		}
+	}
+	if (common != shared)
+	{
+		return false;
+	}
+
+	// No triangle that stays may turn over
+	for (unsigned int t : vertexTriangles[from])
+	{
+		if (! alive[t] || contains(t, to))
+		{
+			continue;
+		}
+		vec3 before[3], after[3];
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = triangles[3 * t + k];
+			before[k] = positions[v];
+			after[k] = v == from ? positions[to] : positions[v];
+		}
+		vec3 normalBefore = cross(before[1] - before[0], before[2] - before[0]);
+		vec3 normalAfter = cross(after[1] - after[0], after[2] - after[0]);
+		if (dot(normalBefore, normalAfter) <= 0.f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void MeshSimplifier::collapse(unsigned int from, unsigned int to)
+{
+	for (unsigned int t : vertexTriangles[from])
+	{
+		if (! alive[t])
+		{
+			continue;
+		}
+		if (contains(t, to))
+		{
+			alive[t] = false;
+			liveTriangles--;
+			continue;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			if (triangles[3 * t + k] == from)
+			{
+				triangles[3 * t + k] = to;
+			}
+		}
+		vertexTriangles[to].push_back(t);
+	}
+	vertexTriangles[from].clear();
+	removed[from] = true;
+	for (int i = 0; i < 10; i++)
+	{
+		quadrics[to].a[i] += quadrics[from].a[i];
+	}
+	quadrics[to].weight += quadrics[from].weight;
+	versions[to]++;
+
+	// Drop the dead triangles, then requeue every edge at the survivor,
+	// whose costs all changed with its quadric
+	vector<unsigned int> &around = vertexTriangles[to];
+	around.erase(remove_if(around.begin(), around.end(), [this](unsigned int t) { return ! alive[t]; }), around.end());
+	vector<unsigned int> ring;
+	for (unsigned int t : around)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			if (triangles[3 * t + k] != to)
+			{
+				ring.push_back(triangles[3 * t + k]);
+			}
+		}
+	}
+	sort(ring.begin(), ring.end());
+	ring.erase(unique(ring.begin(), ring.end()), ring.end());
+	for (unsigned int v : ring)
+	{
+		push(to, v);
+	}
+}
+
+unsigned int MeshSimplifier::pickWedge(unsigned int original, unsigned int welded) const
+{
+	if (welds[original] == welded)
+	{
+		return original;
+	}
+	unsigned int best = wedges[welded][0];
+	float bestDistance = -1.f;
+	for (unsigned int candidate : wedges[welded])
+	{
+		float distance = 0.f;
+		if (! normals.empty())
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				float d = normals[3 * candidate + k] - normals[3 * original + k];
+				distance += d * d;
+			}
+		}
+		if (! texcoords.empty())
+		{
+			for (int k = 0; k < 2; k++)
+			{
+				float d = texcoords[2 * candidate + k] - texcoords[2 * original + k];
+				distance += d * d;
+			}
+		}
+		if (bestDistance < 0.f || distance < bestDistance)
+		{
+			best = candidate;
+			bestDistance = distance;
+		}
+	}
+	return best;
+}
+
+float MeshSimplifier::simplify(size_t targetTriangles, vector<unsigned int> &indices)
+{
+	while (liveTriangles > targetTriangles && ! queue.empty())
+	{
+		Collapse next = queue.top();
+		queue.pop();
+		if (removed[next.from] || removed[next.to]
+			|| versions[next.from] != next.fromVersion || versions[next.to] != next.toVersion)
+		{
+			// Stale: a neighbouring collapse requeued it
+			continue;
+		}
+		if (! allowed(next.from, next.to))
+		{
+			continue;
+		}
+		collapse(next.from, next.to);
+		error = std::max(error, (float) std::sqrt(next.cost));
+	}
+
+	indices.clear();
+	for (size_t t = 0; t < alive.size(); t++)
+	{
+		if (alive[t])
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				indices.push_back(pickWedge(corners[3 * t + k], triangles[3 * t + k]));
+			}
+		}
+	}
+	return error;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#ifndef LAB471_MESHSIMPLIFIER_H_INCLUDED
+#define LAB471_MESHSIMPLIFIER_H_INCLUDED
+
+#include <queue>
+#include <vector>
+#include <glm/glm.hpp>
+
+
+/**
+ * Quadric error mesh simplification (Garland and Heckbert), for building
+ * levels of detail offline (tools/meshbake.cpp).
+ *
+ * Edges are collapsed onto one of their ends, cheapest first, where the cost
+ * is the squared distance from the planes of the triangles merged into that
+ * end so far. The simplified meshes therefore index into the original
+ * vertices and every level can share one vertex buffer.
+ *
+ * Vertices are welded by position first, so a seam in the normals or texture
+ * coordinates is not mistaken for a hole. Open edges and those seams get an
+ * extra plane across them, which keeps them from being pulled sideways.
+ * Collapses that would flip a triangle or pinch the surface are skipped.
+ */
+class MeshSimplifier
+{
+
+public:
+
+	// normals and texcoords may be empty
+	MeshSimplifier(const std::vector<float> &positions, const std::vector<float> &normals,
+		const std::vector<float> &texcoords, const std::vector<unsigned int> &indices);
+
+	// Collapses edges until at most targetTriangles are left, or until no
+	// allowed collapse is left. Carries on from the previous call, so
+	// smaller and smaller targets give successive levels. indices gets the
+	// result; the return value is the largest error so far, as a distance
+	// in the mesh's units.
+	float simplify(size_t targetTriangles, std::vector<unsigned int> &indices);
+
+	size_t getTriangleCount() const { return liveTriangles; }
+
+private:
+
+	// Symmetric 4x4 matrix, upper triangle by rows, and the weight summed
+	// into it
+	struct Quadric
+	{
+		double a[10];
+		double weight;
+	};
+
+	struct Collapse
+	{
+		double cost;
+		unsigned int from;
+		unsigned int to;
+		unsigned int fromVersion;
+		unsigned int toVersion;
+
+		bool operator>(const Collapse &other) const { return cost > other.cost; }
+	};
+
+	void addPlane(unsigned int vertex, const glm::vec3 &normal, const glm::vec3 &point, double weight);
+	double cost(unsigned int from, unsigned int to) const;
+	void push(unsigned int a, unsigned int b);
+	bool contains(unsigned int triangle, unsigned int vertex) const;
+	bool allowed(unsigned int from, unsigned int to) const;
+	void collapse(unsigned int from, unsigned int to);
+	// The original vertex at the position of welded vertex `welded` whose
+	// attributes are closest to those of `original`
+	unsigned int pickWedge(unsigned int original, unsigned int welded) const;
+
+	const std::vector<float> &normals;
+	const std::vector<float> &texcoords;
+
+	// Per original vertex, its welded vertex; per welded vertex, the
+	// original ones there
+	std::vector<unsigned int> welds;
+	std::vector<std::vector<unsigned int>> wedges;
+
+	// Per welded vertex
+	std::vector<glm::vec3> positions;
+	std::vector<Quadric> quadrics;
+	std::vector<std::vector<unsigned int>> vertexTriangles;
+	// Bumped whenever the vertex's collapse costs change
+	std::vector<unsigned int> versions;
+	std::vector<bool> removed;
+
+	// Three welded vertices per triangle, and the original vertices its
+	// corners started as
+	std::vector<unsigned int> triangles;
+	std::vector<unsigned int> corners;
+	std::vector<bool> alive;
+	size_t liveTriangles = 0;
+
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+	float error = 0.f;
+
+};
+
+#endif // LAB471_MESHSIMPLIFIER_H_INCLUDED
@@ -0,0 +1,107 @@
+#include "NarrowPhase.h"
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define NARROWPHASE_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NARROWPHASE_SSE2 1
+#endif
+
+using namespace glm;
+
+namespace NarrowPhase
+{
+
+#if defined(NARROWPHASE_AVX)
+static const size_t LANES = 8;
+#elif defined(NARROWPHASE_SSE2)
+static const size_t LANES = 4;
+#else
+static const size_t LANES = 1;
+#endif
+
+// Bit i set if pair first + i is within reach
+static unsigned testLanes(const Batch &batch, size_t first)
+{
+#if defined(NARROWPHASE_AVX)
+	__m256 dx = _mm256_loadu_ps(&batch.dx[first]);
+	__m256 dy = _mm256_loadu_ps(&batch.dy[first]);
+	__m256 dz = _mm256_loadu_ps(&batch.dz[first]);
+	__m256 r = _mm256_loadu_ps(&batch.reach[first]);
+	__m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+	return (unsigned) _mm256_movemask_ps(_mm256_cmp_ps(d2, _mm256_mul_ps(r, r), _CMP_LE_OQ));
+#elif defined(NARROWPHASE_SSE2)
+	__m128 dx = _mm_loadu_ps(&batch.dx[first]);
+	__m128 dy = _mm_loadu_ps(&batch.dy[first]);
+	__m128 dz = _mm_loadu_ps(&batch.dz[first]);
+	__m128 r = _mm_loadu_ps(&batch.reach[first]);
+	__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+	return (unsigned) _mm_movemask_ps(_mm_cmple_ps(d2, _mm_mul_ps(r, r)));
+#else
+	float d2 = batch.dx[first] * batch.dx[first] + batch.dy[first] * batch.dy[first] + batch.dz[first] * batch.dz[first];
+	return d2 <= batch.reach[first] * batch.reach[first] ? 1u : 0u;
+#endif
+}
+
+void spheres(const EntityStore &store, const std::vector<BroadPhase::Pair> &pairs, std::vector<Contact> &contacts, Batch &batch, float margin)
+{
+	const size_t n = pairs.size();
+	const size_t padded = (n + LANES - 1) / LANES * LANES;
+	batch.resize(padded);
+
+	for (size_t p = 0; p < n; p++)
+	{
+		size_t a = store.indexOf(pairs[p].a);
+		size_t b = store.indexOf(pairs[p].b);
+		batch.dx[p] = store.posX[b] - store.posX[a];
+		batch.dy[p] = store.posY[b] - store.posY[a];
+		batch.dz[p] = store.posZ[b] - store.posZ[a];
+		// A negative reach would pass the squared test, so clamp it
+		batch.reach[p] = std::fmax(store.radius[a] + store.radius[b] + margin, 0.f);
+	}
+	// Padding lanes can never hit
+	for (size_t p = n; p < padded; p++)
+	{
+		batch.dx[p] = 1.f;
+		batch.dy[p] = batch.dz[p] = 0.f;
+		batch.reach[p] = 0.f;
+	}
+
+	for (size_t first = 0; first < padded; first += LANES)
+	{
+		unsigned hits = testLanes(batch, first);
+		for (size_t lane = 0; hits != 0; lane++, hits >>= 1)
+		{
+			if ((hits & 1u) == 0)
+			{
+				continue;
+			}
+			size_t p = first + lane;
+			vec3 d(batch.dx[p], batch.dy[p], batch.dz[p]);
+			float distance = std::sqrt(dot(d, d));
+
+			Contact contact;
+			contact.a = pairs[p].a;
+			contact.b = pairs[p].b;
+			contact.normal = distance > 0.f ? d / distance : vec3(0.f, 1.f, 0.f);
+			contact.depth = batch.reach[p] - margin - distance;
+			contacts.push_back(contact);
+		}
+	}
+}
+
+const Contact * find(const std::vector<Contact> &contacts, Entity a, Entity b)
+{
+	for (const Contact &contact : contacts)
+	{
+		if ((contact.a == a && contact.b == b) || (contact.a == b && contact.b == a))
+		{
+			return &contact;
+		}
+	}
+	return nullptr;
+}
+
+}
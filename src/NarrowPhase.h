@@ -0,0 +1,53 @@
+#pragma once
+
+#ifndef LAB471_NARROWPHASE_H_INCLUDED
+#define LAB471_NARROWPHASE_H_INCLUDED
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "EntityStore.h"
+#include "BroadPhase.h"
+
+
+// Exact tests for the candidate pairs the broad phase finds
+namespace NarrowPhase
+{
+
+	struct Contact
+	{
+		Entity a, b;
+		// Unit vector from a's centre towards b's (+y if they coincide)
+		glm::vec3 normal;
+		// How far the spheres overlap; negative if they are apart but within
+		// the margin that was asked for
+		float depth;
+	};
+
+	// Scratch space for spheres(): the pairs gathered into packed arrays,
+	// padded to a whole number of lanes. Kept by the caller so its memory is
+	// reused from tick to tick; one per caller, as spheres() writes it.
+	struct Batch
+	{
+		std::vector<float> dx, dy, dz, reach;
+
+		void resize(size_t n)
+		{
+			dx.resize(n);
+			dy.resize(n);
+			dz.resize(n);
+			reach.resize(n);
+		}
+	};
+
+	// Tests each pair as two spheres (position, radius) and appends a contact
+	// for every pair within margin of each other. Pairs are compared 8 (AVX)
+	// or 4 (SSE2) at a time on squared distances, so only contacts take a
+	// sqrt. AVX needs a build with ENGINE_AVX on.
+	void spheres(const EntityStore &store, const std::vector<BroadPhase::Pair> &pairs, std::vector<Contact> &contacts, Batch &batch, float margin = 0.f);
+
+	// The contact between a and b, in either order, or nullptr
+	const Contact * find(const std::vector<Contact> &contacts, Entity a, Entity b);
+
+}
+
+#endif // LAB471_NARROWPHASE_H_INCLUDED
@@ -0,0 +1,291 @@
+#include "PerfHud.h"
+#include "GLSL.h"
+#include "GLState.h"
+#include "Program.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+// Frames in the graph
+static const size_t GRAPH_FRAMES = 128;
+// Glyphs are 3x5 pixels in 4x6 cells, drawn at this many screen pixels per
+// font pixel
+static const int CELL_W = 4;
+static const int CELL_H = 6;
+static const float SCALE = 2.f;
+static const float LINE = (CELL_H + 1) * SCALE;
+// Glyphs for ASCII 32-95; lower case is drawn as upper case. One octal
+// digit per row, top first; bit 4 is the left column.
+static const int FIRST_CHAR = 32;
+static const int GLYPH_COUNT = 64;
+static const unsigned short GLYPHS[GLYPH_COUNT] = {
+	000000, 022202, 055000, 057575, 036736, 051245, 025253, 022000, // space ! " # $ % & '
+	012221, 042224, 005250, 002720, 000024, 000700, 000002, 011244, // ( ) * + , - . /
+	075557, 026227, 071747, 071317, 055711, 074717, 074757, 071111, // 0-7
+	075757, 075717, 002020, 002024, 012421, 007070, 042124, 071202, // 8 9 : ; < = > ?
+	075747, 025755, 065656, 034443, 065556, 074647, 074644, 034553, // @ A-G
+	055755, 072227, 011152, 055655, 044447, 057755, 065555, 025552, // H-O
+	065644, 025563, 065655, 034216, 072222, 055557, 055552, 055775, // P-W
+	055255, 055222, 071247, 064446, 044211, 031113, 025000, 000007  // X Y Z [ \ ] ^ _
+};
+// The cell after the glyphs is solid, for plain quads
+static const int SOLID_CELL = GLYPH_COUNT;
+static const int ATLAS_W = (GLYPH_COUNT + 1) * CELL_W;
+// A unit of its own (GL 3.3 has at least 16), so the scene's bindings stay
+static const GLuint FONT_UNIT = 15;
+
+static const GLubyte PANEL[4] = {0, 0, 0, 170};
+static const GLubyte WHITE[4] = {255, 255, 255, 255};
+static const GLubyte GREY[4] = {160, 160, 160, 255};
+static const GLubyte GOOD[4] = {80, 220, 80, 255};
+static const GLubyte SLOW[4] = {240, 200, 60, 255};
+static const GLubyte BAD[4] = {240, 70, 60, 255};
+static const GLubyte MARK[4] = {255, 255, 255, 90};
+
+bool PerfHud::init(const string &resourceDir)
+{
+	prog = make_shared<Program>();
+	prog->setVerbose(true);
+	prog->setShaderNames(resourceDir + "/hud_vert.glsl", resourceDir + "/hud_frag.glsl");
+	// Finished on first use, so it compiles alongside everything else
+	if (! prog->submit())
+	{
+		return false;
+	}
+
+	// Bake the font
+	vector<GLubyte> atlas(ATLAS_W * CELL_H, 0);
+	for (int g = 0; g < GLYPH_COUNT; g++)
+	{
+		for (int row = 0; row < 5; row++)
+		{
+			int bits = (GLYPHS[g] >> (3 * (4 - row))) & 7;
+			for (int col = 0; col < 3; col++)
+			{
+				if (bits & (4 >> col))
+				{
+					atlas[row * ATLAS_W + g * CELL_W + col] = 255;
+				}
+			}
+		}
+	}
+	for (int row = 0; row < CELL_H; row++)
+	{
+		fill_n(atlas.begin() + row * ATLAS_W + SOLID_CELL * CELL_W, CELL_W, 255);
+	}
+	CHECKED_GL_CALL(glGenTextures(1, &font));
+	GLState::bindTexture(FONT_UNIT, GL_TEXTURE_2D, font);
+	CHECKED_GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+	CHECKED_GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, ATLAS_W, CELL_H, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data()));
+	CHECKED_GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+	CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+	CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+	CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+	CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0));
+
+	CHECKED_GL_CALL(glGenVertexArrays(1, &vao));
+	GLState::bindVertexArray(vao);
+	CHECKED_GL_CALL(glGenBuffers(1, &vbo));
+	GLState::bindBuffer(GL_ARRAY_BUFFER, vbo);
+	CHECKED_GL_CALL(glEnableVertexAttribArray(0));
+	CHECKED_GL_CALL(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void *) offsetof(Vertex, x)));
+	CHECKED_GL_CALL(glEnableVertexAttribArray(1));
+	CHECKED_GL_CALL(glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void *) offsetof(Vertex, u)));
+	CHECKED_GL_CALL(glEnableVertexAttribArray(2));
+	CHECKED_GL_CALL(glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (const void *) offsetof(Vertex, color)));
+	GLState::bindVertexArray(0);
+
+	frameTimes.assign(GRAPH_FRAMES, 0.f);
+	return true;
+}
+
+void PerfHud::toggle()
+{
+	visible = ! visible;
+	if (visible && ! Profiler::isEnabled())
+	{
+		Profiler::enable();
+		profilerOwned = true;
+	}
+	else if (! visible && profilerOwned)
+	{
+		Profiler::disable();
+		profilerOwned = false;
+	}
+}
+
+void PerfHud::update(double now)
+{
+	if (lastTime >= 0.0)
+	{
+		frameTimes[next] = (float) ((now - lastTime) * 1000.0);
+		next = (next + 1) % frameTimes.size();
+	}
+	lastTime = now;
+
+	if (fpsStart < 0.0)
+	{
+		fpsStart = now;
+	}
+	fpsFrames++;
+	if (now - fpsStart >= .5)
+	{
+		fps = (float) (fpsFrames / (now - fpsStart));
+		fpsStart = now;
+		fpsFrames = 0;
+	}
+}
+
+void PerfHud::rect(float x, float y, float w, float h, float u0, float v0, float u1, float v1, const GLubyte color[4])
+{
+	Vertex corners[4] = {
+		{x, y, u0, v0, {color[0], color[1], color[2], color[3]}},
+		{x + w, y, u1, v0, {color[0], color[1], color[2], color[3]}},
+		{x, y + h, u0, v1, {color[0], color[1], color[2], color[3]}},
+		{x + w, y + h, u1, v1, {color[0], color[1], color[2], color[3]}}
+	};
+	vertices.push_back(corners[0]);
+	vertices.push_back(corners[1]);
+	vertices.push_back(corners[2]);
+	vertices.push_back(corners[2]);
+	vertices.push_back(corners[1]);
+	vertices.push_back(corners[3]);
+}
+
+void PerfHud::quad(float x, float y, float w, float h, const GLubyte color[4])
+{
+	// Centre of the solid cell
+	float u = (SOLID_CELL * CELL_W + CELL_W / 2.f) / ATLAS_W;
+	rect(x, y, w, h, u, .5f, u, .5f, color);
+}
+
+float PerfHud::text(float x, float y, const char *s, const GLubyte color[4])
+{
+	for (; *s; s++)
+	{
+		int c = (unsigned char) *s;
+		if (c >= 'a' && c <= 'z')
+		{
+			c -= 'a' - 'A';
+		}
+		if (c < FIRST_CHAR || c >= FIRST_CHAR + GLYPH_COUNT)
+		{
+			c = '?';
+		}
+		if (c != ' ')
+		{
+			float u = (float) ((c - FIRST_CHAR) * CELL_W) / ATLAS_W;
+			rect(x, y, 3.f * SCALE, 5.f * SCALE, u, 0.f, u + 3.f / ATLAS_W, 5.f / CELL_H, color);
+		}
+		x += CELL_W * SCALE;
+	}
+	return x;
+}
+
+void PerfHud::draw(int width, int height, size_t textureBytes, size_t textureBudget, size_t meshBytes,
+	size_t triangles, size_t fullTriangles)
+{
+	if (! visible || ! prog || width <= 0 || height <= 0)
+	{
+		return;
+	}
+	if (! ready)
+	{
+		if (! prog->isReady())
+		{
+			return;
+		}
+		if (! prog->finish())
+		{
+			std::cerr << "Performance HUD unavailable" << std::endl;
+			prog.reset();
+			return;
+		}
+		prog->addUniform("screenSize");
+		prog->addUniform("font");
+		prog->bind();
+		CHECKED_GL_CALL(glUniform1i(prog->getUniform("font"), FONT_UNIT));
+		prog->unbind();
+		ready = true;
+	}
+	vector<Profiler::PassTime> passes;
+	Profiler::getLatestFrame(passes);
+
+	const float margin = 8.f;
+	const float pad = 6.f;
+	const float graphH = 60.f;
+	// The graph's full height
+	const float graphMs = 50.f;
+	const float panelW = GRAPH_FRAMES * 2.f + 2 * pad;
+	float panelH = pad + LINE + graphH + pad + LINE * (passes.size() + 1) + LINE * 3 + pad;
+
+	vertices.clear();
+	quad(margin, margin, panelW, panelH, PANEL);
+	float x = margin + pad;
+	float y = margin + pad;
+	char line[64];
+
+	float last = frameTimes[(next + frameTimes.size() - 1) % frameTimes.size()];
+	snprintf(line, sizeof(line), "FPS %5.1f  %6.2f MS", fps, last);
+	text(x, y, line, WHITE);
+	y += LINE;
+
+	// Frame time graph, oldest on the left, with marks at 60 and 30 FPS
+	for (size_t i = 0; i < frameTimes.size(); i++)
+	{
+		float ms = frameTimes[(next + i) % frameTimes.size()];
+		float h = std::min(ms / graphMs, 1.f) * graphH;
+		quad(x + 2.f * i, y + graphH - h, 1.5f, h, ms <= 17.f ? GOOD : ms <= 34.f ? SLOW : BAD);
+	}
+	quad(x, y + graphH - 16.67f / graphMs * graphH, GRAPH_FRAMES * 2.f, 1.f, MARK);
+	quad(x, y + graphH - 33.33f / graphMs * graphH, GRAPH_FRAMES * 2.f, 1.f, MARK);
+	y += graphH + pad;
+
+	text(x, y, "PASS              CPU    GPU", GREY);
+	y += LINE;
+	for (const Profiler::PassTime &pass : passes)
+	{
+		char cpu[16] = "     -", gpu[16] = "     -";
+		if (pass.cpu >= 0.0)
+		{
+			snprintf(cpu, sizeof(cpu), "%6.2f", pass.cpu);
+		}
+		if (pass.gpu >= 0.0)
+		{
+			snprintf(gpu, sizeof(gpu), "%6.2f", pass.gpu);
+		}
+		snprintf(line, sizeof(line), "%-16.16s %s %s", pass.name.c_str(), cpu, gpu);
+		text(x, y, line, WHITE);
+		y += LINE;
+	}
+
+	snprintf(line, sizeof(line), "TEXTURES %.1f / %.0f MB", textureBytes / 1048576.0, textureBudget / 1048576.0);
+	text(x, y, line, WHITE);
+	y += LINE;
+	snprintf(line, sizeof(line), "MESHES %.1f MB", meshBytes / 1048576.0);
+	text(x, y, line, WHITE);
+	y += LINE;
+	snprintf(line, sizeof(line), "TRIANGLES %zu / %zu FULL", triangles, fullTriangles);
+	text(x, y, line, WHITE);
+
+	// One draw for everything
+	CHECKED_GL_CALL(glDisable(GL_DEPTH_TEST));
+	CHECKED_GL_CALL(glEnable(GL_BLEND));
+	CHECKED_GL_CALL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+	prog->bind();
+	CHECKED_GL_CALL(glUniform2f(prog->getUniform("screenSize"), (float) width, (float) height));
+	GLState::bindTexture(FONT_UNIT, GL_TEXTURE_2D, font);
+	GLState::bindVertexArray(vao);
+	GLState::bindBuffer(GL_ARRAY_BUFFER, vbo);
+	CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STREAM_DRAW));
+	CHECKED_GL_CALL(glDrawArrays(GL_TRIANGLES, 0, (GLsizei) vertices.size()));
+	GLState::bindVertexArray(0);
+	prog->unbind();
+	CHECKED_GL_CALL(glDisable(GL_BLEND));
+	CHECKED_GL_CALL(glEnable(GL_DEPTH_TEST));
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#ifndef LAB471_PERFHUD_H_INCLUDED
+#define LAB471_PERFHUD_H_INCLUDED
+
+#include <glad/glad.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Program;
+
+
+/**
+ * On-screen performance overlay: FPS, a graph of the last frame times,
+ * CPU/GPU time per pass (from the Profiler) and resident texture and mesh
+ * memory.
+ *
+ * Text uses a 3x5 pixel font baked into a small texture at init; every
+ * glyph, bar and panel becomes a textured quad in one vertex buffer, drawn
+ * with a single glDrawArrays.
+ */
+class PerfHud
+{
+
+public:
+
+	bool init(const std::string &resourceDir);
+
+	// Showing the HUD turns the Profiler on, for the pass times, and hiding
+	// it turns it off again unless it was on already (--profile)
+	void toggle();
+	bool isVisible() const { return visible; }
+
+	// Call every frame, shown or not, so the graph is full when it appears
+	void update(double now);
+	// triangles were drawn this frame, fullTriangles would have been
+	// without levels of detail
+	void draw(int width, int height, size_t textureBytes, size_t textureBudget, size_t meshBytes,
+		size_t triangles, size_t fullTriangles);
+
+private:
+
+	struct Vertex
+	{
+		float x, y;
+		float u, v;
+		GLubyte color[4];
+	};
+
+	void rect(float x, float y, float w, float h, float u0, float v0, float u1, float v1, const GLubyte color[4]);
+	void quad(float x, float y, float w, float h, const GLubyte color[4]);
+	// Returns the x after the text
+	float text(float x, float y, const char *s, const GLubyte color[4]);
+
+	std::shared_ptr<Program> prog;
+	bool ready = false;
+	GLuint font = 0;
+	GLuint vao = 0;
+	GLuint vbo = 0;
+	std::vector<Vertex> vertices;
+
+	bool visible = false;
+	// Whether toggle() turned the Profiler on
+	bool profilerOwned = false;
+	double lastTime = -1.0;
+	// Milliseconds, oldest first from next
+	std::vector<float> frameTimes;
+	size_t next = 0;
+
+	// FPS shown, recounted twice a second so it can be read
+	double fpsStart = -1.0;
+	int fpsFrames = 0;
+	float fps = 0.f;
+
+};
+
+#endif // LAB471_PERFHUD_H_INCLUDED
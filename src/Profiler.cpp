@@ -0,0 +1,418 @@
+#include "Profiler.h"
+#include "GLSL.h"
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <vector>
+
+namespace Profiler
+{
+
+// Frames between issuing a GPU query and reading it back
+static const long long QUERY_LATENCY = 3;
+
+struct Sample
+{
+	int pass;
+	// Microseconds since the profiler was enabled. GPU samples have no start
+	// of their own; the trace lays them out one after another.
+	double start;
+	double duration;
+};
+
+struct Frame
+{
+	long long index = -1;
+	double start = 0.0;
+	double duration = 0.0;
+	std::vector<Sample> cpu;
+	std::vector<Sample> gpu;
+};
+
+struct PendingQuery
+{
+	GLuint query;
+	int pass;
+	long long frame;
+};
+
+static bool enabled = false;
+static std::chrono::steady_clock::time_point epoch;
+
+static std::vector<std::string> passNames;
+static std::map<std::string, int> passIds;
+
+static std::vector<Frame> ring;
+static long long frameIndex = -1;
+static bool inFrame = false;
+static std::vector<Sample> startup;
+
+static std::deque<PendingQuery> pending;
+static std::vector<GLuint> freeQueries;
+static bool gpuScopeOpen = false;
+
+static double now()
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+static int passFor(const char *name)
+{
+	std::map<std::string, int>::const_iterator it = passIds.find(name);
+	if (it != passIds.end())
+	{
+		return it->second;
+	}
+	int id = (int) passNames.size();
+	passNames.push_back(name);
+	passIds[name] = id;
+	return id;
+}
+
+static Frame * frameAt(long long index)
+{
+	if (index < 0)
+	{
+		return nullptr;
+	}
+	Frame &frame = ring[index % ring.size()];
+	return frame.index == index ? &frame : nullptr;
+}
+
+void enable(size_t framesKept)
+{
+	enabled = true;
+	epoch = std::chrono::steady_clock::now();
+	ring.assign(std::max<size_t>(framesKept, 1), Frame());
+}
+
+void disable()
+{
+	// Queries still in flight are read and dropped by the next enable()'s
+	// frames, whose indices they no longer match
+	enabled = false;
+	inFrame = false;
+}
+
+bool isEnabled()
+{
+	return enabled;
+}
+
+// Reads back the queries that are old enough and ready, oldest first
+static void collectQueries(bool wait)
+{
+	while (! pending.empty())
+	{
+		const PendingQuery &q = pending.front();
+		if (! wait)
+		{
+			if (frameIndex - q.frame < QUERY_LATENCY)
+			{
+				break;
+			}
+			GLint available = 0;
+			CHECKED_GL_CALL(glGetQueryObjectiv(q.query, GL_QUERY_RESULT_AVAILABLE, &available));
+			if (! available)
+			{
+				break;
+			}
+		}
+		GLuint64 nanoseconds = 0;
+		CHECKED_GL_CALL(glGetQueryObjectui64v(q.query, GL_QUERY_RESULT, &nanoseconds));
+		Frame *frame = frameAt(q.frame);
+		if (frame)
+		{
+			Sample sample;
+			sample.pass = q.pass;
+			sample.start = 0.0;
+			sample.duration = nanoseconds / 1000.0;
+			frame->gpu.push_back(sample);
+		}
+		freeQueries.push_back(q.query);
+		pending.pop_front();
+	}
+}
+
+void beginFrame()
+{
+	if (! enabled)
+	{
+		return;
+	}
+	frameIndex++;
+	Frame &frame = ring[frameIndex % ring.size()];
+	frame.index = frameIndex;
+	frame.start = now();
+	frame.duration = 0.0;
+	frame.cpu.clear();
+	frame.gpu.clear();
+	inFrame = true;
+	collectQueries(false);
+}
+
+void endFrame()
+{
+	if (! enabled || ! inFrame)
+	{
+		return;
+	}
+	Frame &frame = ring[frameIndex % ring.size()];
+	frame.duration = now() - frame.start;
+	inFrame = false;
+}
+
+CpuScope::CpuScope(const char *name)
+{
+	if (enabled)
+	{
+		pass = passFor(name);
+		start = now();
+	}
+}
+
+CpuScope::~CpuScope()
+{
+	if (pass < 0)
+	{
+		return;
+	}
+	Sample sample;
+	sample.pass = pass;
+	sample.start = start;
+	sample.duration = now() - start;
+	if (inFrame)
+	{
+		ring[frameIndex % ring.size()].cpu.push_back(sample);
+	}
+	else
+	{
+		startup.push_back(sample);
+	}
+}
+
+GpuScope::GpuScope(const char *name)
+{
+	if (! enabled || ! inFrame || gpuScopeOpen)
+	{
+		return;
+	}
+	if (freeQueries.empty())
+	{
+		GLuint q;
+		CHECKED_GL_CALL(glGenQueries(1, &q));
+		freeQueries.push_back(q);
+	}
+	query = freeQueries.back();
+	freeQueries.pop_back();
+	gpuScopeOpen = true;
+	CHECKED_GL_CALL(glBeginQuery(GL_TIME_ELAPSED, query));
+
+	PendingQuery q;
+	q.query = query;
+	q.pass = passFor(name);
+	q.frame = frameIndex;
+	pending.push_back(q);
+}
+
+GpuScope::~GpuScope()
+{
+	if (query != 0)
+	{
+		CHECKED_GL_CALL(glEndQuery(GL_TIME_ELAPSED));
+		gpuScopeOpen = false;
+	}
+}
+
+void PassTimer::begin(const char *name)
+{
+	end();
+	if (enabled)
+	{
+		cpu.reset(new CpuScope(name));
+		gpu.reset(new GpuScope(name));
+	}
+}
+
+void PassTimer::end()
+{
+	gpu.reset();
+	cpu.reset();
+}
+
+void finish()
+{
+	if (enabled)
+	{
+		collectQueries(true);
+	}
+}
+
+double getLatestFrame(std::vector<PassTime> &passes)
+{
+	passes.clear();
+	const Frame *frame = enabled ? frameAt(frameIndex - QUERY_LATENCY) : nullptr;
+	if (! frame)
+	{
+		return 0.0;
+	}
+	std::vector<int> slot(passNames.size(), -1);
+	for (int timeline = 0; timeline < 2; timeline++)
+	{
+		for (const Sample &s : timeline == 0 ? frame->cpu : frame->gpu)
+		{
+			if (slot[s.pass] < 0)
+			{
+				slot[s.pass] = (int) passes.size();
+				passes.push_back(PassTime());
+				passes.back().name = passNames[s.pass];
+			}
+			double &time = timeline == 0 ? passes[slot[s.pass]].cpu : passes[slot[s.pass]].gpu;
+			time = std::max(time, 0.0) + s.duration / 1000.0;
+		}
+	}
+	return frame->duration / 1000.0;
+}
+
+static void writeEvent(std::ostream &out, bool &first, const std::string &name, int thread, double start, double duration)
+{
+	out << (first ? "\n" : ",\n") << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+		<< ",\"ts\":" << start << ",\"dur\":" << duration << "}";
+	first = false;
+}
+
+bool writeChromeTrace(const std::string &path)
+{
+	std::ofstream out(path.c_str());
+	if (! out)
+	{
+		std::cerr << "Could not write trace " << path << std::endl;
+		return false;
+	}
+	out << std::fixed << std::setprecision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	out << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}}";
+	out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+	bool first = false;
+
+	for (const Sample &s : startup)
+	{
+		writeEvent(out, first, passNames[s.pass], 1, s.start, s.duration);
+	}
+	long long oldest = std::max(0LL, frameIndex - (long long) ring.size() + 1);
+	for (long long i = oldest; i <= frameIndex; i++)
+	{
+		const Frame *frame = frameAt(i);
+		if (! frame)
+		{
+			continue;
+		}
+		writeEvent(out, first, "frame", 1, frame->start, frame->duration);
+		for (const Sample &s : frame->cpu)
+		{
+			writeEvent(out, first, passNames[s.pass], 1, s.start, s.duration);
+		}
+		double gpuTime = frame->start;
+		for (const Sample &s : frame->gpu)
+		{
+			writeEvent(out, first, passNames[s.pass], 2, gpuTime, s.duration);
+			gpuTime += s.duration;
+		}
+	}
+	out << "\n]}\n";
+	return true;
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const std::vector<double> &sorted, double p)
+{
+	size_t rank = (size_t) std::ceil(p / 100.0 * sorted.size());
+	return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+static void printRow(std::ostream &out, const std::string &name, std::vector<double> &values)
+{
+	if (values.empty())
+	{
+		return;
+	}
+	std::sort(values.begin(), values.end());
+	out << "  " << std::left << std::setw(28) << name << std::right
+		<< std::setw(9) << percentile(values, 50) / 1000.0
+		<< std::setw(9) << percentile(values, 95) / 1000.0
+		<< std::setw(9) << percentile(values, 99) / 1000.0
+		<< std::setw(8) << values.size() << std::endl;
+}
+
+void printSummary(std::ostream &out)
+{
+	if (! enabled)
+	{
+		return;
+	}
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(3);
+
+	if (! startup.empty())
+	{
+		out << "Startup (ms):" << std::endl;
+		for (const Sample &s : startup)
+		{
+			out << "  " << std::left << std::setw(28) << passNames[s.pass] << std::right << std::setw(9) << s.duration / 1000.0 << std::endl;
+		}
+	}
+
+	// A pass can run several times a frame (e.g. simulation steps); its
+	// frame time is the sum
+	std::vector<std::vector<double>> cpu(passNames.size()), gpu(passNames.size());
+	std::vector<double> frames;
+	long long oldest = std::max(0LL, frameIndex - (long long) ring.size() + 1);
+	for (long long i = oldest; i <= frameIndex; i++)
+	{
+		const Frame *frame = frameAt(i);
+		if (! frame || frame->duration == 0.0)
+		{
+			continue;
+		}
+		frames.push_back(frame->duration);
+		std::vector<double> cpuTotals(passNames.size(), -1.0), gpuTotals(passNames.size(), -1.0);
+		for (const Sample &s : frame->cpu)
+		{
+			cpuTotals[s.pass] = std::max(cpuTotals[s.pass], 0.0) + s.duration;
+		}
+		for (const Sample &s : frame->gpu)
+		{
+			gpuTotals[s.pass] = std::max(gpuTotals[s.pass], 0.0) + s.duration;
+		}
+		for (size_t p = 0; p < passNames.size(); p++)
+		{
+			if (cpuTotals[p] >= 0.0)
+			{
+				cpu[p].push_back(cpuTotals[p]);
+			}
+			if (gpuTotals[p] >= 0.0)
+			{
+				gpu[p].push_back(gpuTotals[p]);
+			}
+		}
+	}
+
+	out << "Per frame over the last " << frames.size() << " frames (ms):" << std::endl;
+	out << "  " << std::left << std::setw(28) << "" << std::right << std::setw(9) << "p50" << std::setw(9) << "p95" << std::setw(9) << "p99" << std::setw(8) << "frames" << std::endl;
+	printRow(out, "frame", frames);
+	for (size_t p = 0; p < passNames.size(); p++)
+	{
+		printRow(out, passNames[p] + " (cpu)", cpu[p]);
+		printRow(out, passNames[p] + " (gpu)", gpu[p]);
+	}
+	out.flags(flags);
+	out.precision(precision);
+}
+
+}
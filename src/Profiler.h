@@ -0,0 +1,110 @@
+#pragma once
+
+#ifndef LAB471_PROFILER_H_INCLUDED
+#define LAB471_PROFILER_H_INCLUDED
+
+#include <glad/glad.h>
+#include <memory>
+#include <string>
+#include <ostream>
+#include <vector>
+
+
+/**
+ * Frame-time instrumentation: CPU time per scope and GPU time per pass.
+ *
+ * Wrap a section in a CpuScope (and a render pass in a GpuScope) named by a
+ * string literal. Each frame's samples go into a ring buffer holding the
+ * last few thousand frames, from which the percentile summary and the Chrome
+ * trace (chrome://tracing, or ui.perfetto.dev) are made.
+ *
+ * GPU times come from GL_TIME_ELAPSED queries, read back a few frames later
+ * so the CPU never waits for the GPU. Those queries can't nest, so a
+ * GpuScope inside another one is ignored.
+ *
+ * Until enable() is called, and after disable(), every scope is a no-op.
+ */
+
+namespace Profiler
+{
+
+	void enable(size_t framesKept = 4096);
+	// Back to no-ops. Call between passes; the frames kept so far stay until
+	// the next enable().
+	void disable();
+	bool isEnabled();
+
+	// Bracket each frame. Scopes outside any frame count as startup.
+	void beginFrame();
+	void endFrame();
+
+	class CpuScope
+	{
+
+	public:
+
+		explicit CpuScope(const char *name);
+		~CpuScope();
+
+	private:
+
+		int pass = -1;
+		double start = 0.0;
+
+	};
+
+	class GpuScope
+	{
+
+	public:
+
+		explicit GpuScope(const char *name);
+		~GpuScope();
+
+	private:
+
+		GLuint query = 0;
+
+	};
+
+	// CPU and GPU time of a sequence of passes; each begin() ends the
+	// previous pass, and so does going out of scope
+	class PassTimer
+	{
+
+	public:
+
+		~PassTimer() { end(); }
+
+		void begin(const char *name);
+		void end();
+
+	private:
+
+		std::unique_ptr<CpuScope> cpu;
+		std::unique_ptr<GpuScope> gpu;
+
+	};
+
+	// Waits for outstanding GPU queries, so the last frames are complete
+	void finish();
+
+	struct PassTime
+	{
+		std::string name;
+		// Milliseconds in the frame; negative if the pass had no such scope
+		double cpu = -1.0;
+		double gpu = -1.0;
+	};
+
+	// Per-pass times of the newest frame whose GPU times should be in, and
+	// that frame's length in ms (0 if there is none yet)
+	double getLatestFrame(std::vector<PassTime> &passes);
+
+	bool writeChromeTrace(const std::string &path);
+	// p50/p95/p99 per pass over the frames kept, plus startup times
+	void printSummary(std::ostream &out);
+
+}
+
+#endif // LAB471_PROFILER_H_INCLUDED
@@ -3,8 +3,12 @@
 #include <iostream>
 #include <cassert>
 #include <fstream>
+#include <chrono>
 
 #include "GLSL.h"
+#include "GLState.h"
+#include "ProgramCache.h"
+#include <GLFW/glfw3.h>
 
 
 std::string readFileAsString(const std::string &fileName)
@@ -34,75 +38,241 @@ void Program::setShaderNames(const std::string &v, const std::string &f)
 	fShaderName = f;
 }
 
-bool Program::init()
+// KHR_parallel_shader_compile (or the ARB version, same enum)
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+static bool parallelCompile()
 {
-	GLint rc;
+	static int available = -1;
+	if (available < 0)
+	{
+		PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxThreads = nullptr;
+		if (GLSL::hasExtension("GL_KHR_parallel_shader_compile"))
+		{
+			maxThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+		}
+		else if (GLSL::hasExtension("GL_ARB_parallel_shader_compile"))
+		{
+			maxThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+		}
+		available = maxThreads ? 1 : 0;
+		if (maxThreads)
+		{
+			// As many threads as the driver likes
+			maxThreads(0xFFFFFFFFu);
+		}
+	}
+	return available == 1;
+}
 
-	// Create shader handles
-	GLuint VS = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FS = glCreateShader(GL_FRAGMENT_SHADER);
+static double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// #version has to come first, so defines go right after it
+static std::string addDefines(const std::string &source, const std::string &defines)
+{
+	if (defines.empty())
+	{
+		return source;
+	}
+	size_t lineEnd = source.find('\n');
+	if (lineEnd == std::string::npos || source.compare(0, 8, "#version") != 0)
+	{
+		return defines + source;
+	}
+	return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+bool Program::init()
+{
+	return submit() && finish();
+}
 
+bool Program::submit()
+{
 	// Read shader sources
-	std::string vShaderString = readFileAsString(vShaderName);
-	std::string fShaderString = readFileAsString(fShaderName);
+	std::string vShaderString = addDefines(readFileAsString(vShaderName), defines);
+	std::string fShaderString = addDefines(readFileAsString(fShaderName), defines);
 	const char *vshader = vShaderString.c_str();
 	const char *fshader = fShaderString.c_str();
-	CHECKED_GL_CALL(glShaderSource(VS, 1, &vshader, NULL));
-	CHECKED_GL_CALL(glShaderSource(FS, 1, &fshader, NULL));
 
-	// Compile vertex shader
-	CHECKED_GL_CALL(glCompileShader(VS));
-	CHECKED_GL_CALL(glGetShaderiv(VS, GL_COMPILE_STATUS, &rc));
-	if (!rc)
+	// A binary from an earlier run skips compiling and linking altogether
+	cacheKey.clear();
+	if (ProgramCache::isEnabled())
 	{
-		if (isVerbose())
+		cacheKey = ProgramCache::keyFor(vShaderString, fShaderString);
+		pid = glCreateProgram();
+		if (ProgramCache::load(cacheKey, pid))
 		{
-			GLSL::printShaderInfoLog(VS);
-			std::cout << "Error compiling vertex shader " << vShaderName << std::endl;
+			cacheKey.clear();
+			return true;
 		}
-		return false;
+		CHECKED_GL_CALL(glDeleteProgram(pid));
 	}
+	parallelCompile();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// Create shader handles
+	vShader = glCreateShader(GL_VERTEX_SHADER);
+	fShader = glCreateShader(GL_FRAGMENT_SHADER);
+	CHECKED_GL_CALL(glShaderSource(vShader, 1, &vshader, NULL));
+	CHECKED_GL_CALL(glShaderSource(fShader, 1, &fshader, NULL));
+	CHECKED_GL_CALL(glCompileShader(vShader));
+	CHECKED_GL_CALL(glCompileShader(fShader));
+
+	// Link right away; a failed compile shows up as a failed link, and
+	// finish() then reports the shader's log
+	pid = glCreateProgram();
+	CHECKED_GL_CALL(glAttachShader(pid, vShader));
+	CHECKED_GL_CALL(glAttachShader(pid, fShader));
+	ProgramCache::prepare(pid);
+	CHECKED_GL_CALL(glLinkProgram(pid));
+	pending = true;
+	buildMs = elapsedMs(start);
+	return true;
+}
 
-	// Compile fragment shader
-	CHECKED_GL_CALL(glCompileShader(FS));
-	CHECKED_GL_CALL(glGetShaderiv(FS, GL_COMPILE_STATUS, &rc));
+bool Program::isReady() const
+{
+	if (! pending || ! parallelCompile())
+	{
+		return true;
+	}
+	GLint done = GL_FALSE;
+	CHECKED_GL_CALL(glGetProgramiv(pid, GL_COMPLETION_STATUS_KHR, &done));
+	return done == GL_TRUE;
+}
+
+bool Program::finish()
+{
+	if (! pending)
+	{
+		return pid != 0;
+	}
+	pending = false;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	GLint rc;
+	bool built = false;
+
+	CHECKED_GL_CALL(glGetShaderiv(vShader, GL_COMPILE_STATUS, &rc));
 	if (!rc)
 	{
 		if (isVerbose())
 		{
-			GLSL::printShaderInfoLog(FS);
-			std::cout << "Error compiling fragment shader " << fShaderName << std::endl;
+			GLSL::printShaderInfoLog(vShader);
+			std::cout << "Error compiling vertex shader " << vShaderName << std::endl;
+		}
+	}
+	else
+	{
+		CHECKED_GL_CALL(glGetShaderiv(fShader, GL_COMPILE_STATUS, &rc));
+		if (!rc)
+		{
+			if (isVerbose())
+			{
+				GLSL::printShaderInfoLog(fShader);
+				std::cout << "Error compiling fragment shader " << fShaderName << std::endl;
+			}
+		}
+		else
+		{
+			CHECKED_GL_CALL(glGetProgramiv(pid, GL_LINK_STATUS, &rc));
+			if (!rc && isVerbose())
+			{
+				GLSL::printProgramInfoLog(pid);
+				std::cout << "Error linking shaders " << vShaderName << " and " << fShaderName << std::endl;
+			}
+			built = rc != 0;
 		}
-		return false;
 	}
 
-	// Create the program and link
-	pid = glCreateProgram();
-	CHECKED_GL_CALL(glAttachShader(pid, VS));
-	CHECKED_GL_CALL(glAttachShader(pid, FS));
-	CHECKED_GL_CALL(glLinkProgram(pid));
-	CHECKED_GL_CALL(glGetProgramiv(pid, GL_LINK_STATUS, &rc));
-	if (!rc)
+	// The program keeps what it needs
+	CHECKED_GL_CALL(glDetachShader(pid, vShader));
+	CHECKED_GL_CALL(glDetachShader(pid, fShader));
+	CHECKED_GL_CALL(glDeleteShader(vShader));
+	CHECKED_GL_CALL(glDeleteShader(fShader));
+	vShader = fShader = 0;
+
+	if (built && ! cacheKey.empty())
 	{
-		if (isVerbose())
+		// Only the time we were blocked on the driver; with parallel
+		// compiles that understates the real cost
+		ProgramCache::store(cacheKey, pid, buildMs + elapsedMs(start));
+	}
+	return built;
+}
+
+bool Program::usesShader(const std::string &path) const
+{
+	return path == vShaderName || path == fShaderName;
+}
+
+void Program::reload()
+{
+	// A newer edit replaces a rebuild still in flight
+	if (reloading && reloading->pid != 0)
+	{
+		reloading->finish();
+		GLState::deleteProgram(reloading->pid);
+	}
+	reloading.reset(new Program());
+	reloading->setVerbose(isVerbose());
+	reloading->setShaderNames(vShaderName, fShaderName);
+	reloading->setDefines(defines);
+	reloading->submit();
+}
+
+bool Program::updateReload()
+{
+	if (! reloading || ! reloading->isReady())
+	{
+		return false;
+	}
+	std::unique_ptr<Program> next(std::move(reloading));
+	if (! next->finish())
+	{
+		std::cout << "Keeping the previous build of " << vShaderName << " and " << fShaderName << std::endl;
+		if (next->pid != 0)
 		{
-			GLSL::printProgramInfoLog(pid);
-			std::cout << "Error linking shaders " << vShaderName << " and " << fShaderName << std::endl;
+			GLState::deleteProgram(next->pid);
 		}
 		return false;
 	}
 
+	GLState::deleteProgram(pid);
+	pid = next->pid;
+	for (std::map<std::string, GLint>::iterator attribute = attributes.begin(); attribute != attributes.end(); ++attribute)
+	{
+		// Only warn about the ones the old program had
+		attribute->second = GLSL::getAttribLocation(pid, attribute->first.c_str(), isVerbose() && attribute->second >= 0);
+	}
+	for (std::map<std::string, GLint>::iterator uniform = uniforms.begin(); uniform != uniforms.end(); ++uniform)
+	{
+		uniform->second = GLSL::getUniformLocation(pid, uniform->first.c_str(), isVerbose() && uniform->second >= 0);
+	}
+	for (std::map<std::string, GLuint>::const_iterator block = blocks.begin(); block != blocks.end(); ++block)
+	{
+		bindUniformBlock(block->first, block->second);
+	}
+	for (std::map<std::string, GLuint>::const_iterator sampler = samplers.begin(); sampler != samplers.end(); ++sampler)
+	{
+		bindSampler(sampler->first, sampler->second);
+	}
+	std::cout << "Reloaded " << vShaderName << " and " << fShaderName << std::endl;
 	return true;
 }
 
 void Program::bind()
 {
-	CHECKED_GL_CALL(glUseProgram(pid));
+	GLState::useProgram(pid);
 }
 
 void Program::unbind()
 {
-	CHECKED_GL_CALL(glUseProgram(0));
+	GLState::useProgram(0);
 }
 
 void Program::addAttribute(const std::string &name)
@@ -115,6 +285,32 @@ void Program::addUniform(const std::string &name)
 	uniforms[name] = GLSL::getUniformLocation(pid, name.c_str(), isVerbose());
 }
 
+void Program::bindUniformBlock(const std::string &name, GLuint binding)
+{
+	blocks[name] = binding;
+	GLuint index = glGetUniformBlockIndex(pid, name.c_str());
+	if (index == GL_INVALID_INDEX)
+	{
+		if (isVerbose())
+		{
+			std::cout << name << " is not a uniform block" << std::endl;
+		}
+		return;
+	}
+	CHECKED_GL_CALL(glUniformBlockBinding(pid, index, binding));
+}
+
+void Program::bindSampler(const std::string &name, GLuint unit)
+{
+	samplers[name] = unit;
+	GLint location = GLSL::getUniformLocation(pid, name.c_str(), isVerbose());
+	if (location >= 0)
+	{
+		GLState::useProgram(pid);
+		CHECKED_GL_CALL(glUniform1i(location, unit));
+	}
+}
+
 GLint Program::getAttribute(const std::string &name) const
 {
 	std::map<std::string, GLint>::const_iterator attribute = attributes.find(name.c_str());
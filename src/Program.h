@@ -5,6 +5,7 @@
 #define LAB471_PROGRAM_H_INCLUDED
 
 #include <map>
+#include <memory>
 #include <string>
 
 #include <glad/glad.h>
@@ -21,12 +22,40 @@ public:
 	bool isVerbose() const { return verbose; }
 
 	void setShaderNames(const std::string &v, const std::string &f);
+	const std::string & getVertexShaderName() const { return vShaderName; }
+	const std::string & getFragmentShaderName() const { return fShaderName; }
+	// Lines inserted after each shader's #version line, e.g. "#define LIT\n"
+	void setDefines(const std::string &d) { defines = d; }
+	// submit() and finish() in one go
 	virtual bool init();
+
+	// Starts compiling and linking without waiting for either. With
+	// KHR_parallel_shader_compile the driver does it on its own threads.
+	bool submit();
+	// True once finish() won't block. Without the extension there is no
+	// way to tell, so it is always true and finish() may block.
+	bool isReady() const;
+	// Waits if need be, then reports compile and link errors
+	bool finish();
+
 	virtual void bind();
 	virtual void unbind();
 
+	// Hot reload: rebuilds from the same files into a new program, while
+	// this one stays in use
+	bool usesShader(const std::string &path) const;
+	void reload();
+	// Swaps the rebuilt program in once it is ready, with its variables
+	// looked up again, and returns true. If it failed to build this one is
+	// kept. Uniform values set once (e.g. samplers) must be set again.
+	bool updateReload();
+
 	void addAttribute(const std::string &name);
 	void addUniform(const std::string &name);
+	// Points a uniform block at a buffer binding point; kept across reloads
+	void bindUniformBlock(const std::string &name, GLuint binding);
+	// Sets a sampler that never changes unit; also kept across reloads
+	void bindSampler(const std::string &name, GLuint unit);
 	GLint getAttribute(const std::string &name) const;
 	GLint getUniform(const std::string &name) const;
 
@@ -34,12 +63,24 @@ protected:
 
 	std::string vShaderName;
 	std::string fShaderName;
+	std::string defines;
 
 private:
 
 	GLuint pid = 0;
+	// Between submit() and finish()
+	GLuint vShader = 0;
+	GLuint fShader = 0;
+	bool pending = false;
+	std::string cacheKey;
+	// Time spent in our own compile and link calls, for the cache
+	double buildMs = 0.0;
+	std::unique_ptr<Program> reloading;
+
 	std::map<std::string, GLint> attributes;
 	std::map<std::string, GLint> uniforms;
+	std::map<std::string, GLuint> blocks;
+	std::map<std::string, GLuint> samplers;
 	bool verbose = true;
 
 };
@@ -0,0 +1,267 @@
+#include "ProgramCache.h"
+#include "GLSL.h"
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// ARB_get_program_binary (core in 4.1); glad only loads 3.3
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+namespace ProgramCache
+{
+
+static const char MAGIC[4] = {'L', 'P', 'B', '1'};
+
+struct Header
+{
+	char magic[4];
+	uint32_t format;
+	uint32_t length;
+	uint32_t reserved;
+	double buildMs;
+};
+
+static bool enabled = false;
+static std::string directory;
+static std::string driver;
+static Stats stats;
+
+static PFNGLGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+static PFNGLPROGRAMBINARYPROC programBinary = nullptr;
+static PFNGLPROGRAMPARAMETERIPROC programParameteri = nullptr;
+
+static double now()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::string glString(GLenum name)
+{
+	const char *s = (const char *) glGetString(name);
+	return s ? s : "";
+}
+
+bool enable(const std::string &dir)
+{
+	if (! GLSL::isVersionAtLeast(4, 1) && ! GLSL::hasExtension("GL_ARB_get_program_binary"))
+	{
+		return false;
+	}
+	GLint formats = 0;
+	CHECKED_GL_CALL(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats));
+	getProgramBinary = (PFNGLGETPROGRAMBINARYPROC) glfwGetProcAddress("glGetProgramBinary");
+	programBinary = (PFNGLPROGRAMBINARYPROC) glfwGetProcAddress("glProgramBinary");
+	programParameteri = (PFNGLPROGRAMPARAMETERIPROC) glfwGetProcAddress("glProgramParameteri");
+	if (formats <= 0 || ! getProgramBinary || ! programBinary || ! programParameteri)
+	{
+		return false;
+	}
+
+#ifdef _WIN32
+	_mkdir(dir.c_str());
+#else
+	mkdir(dir.c_str(), 0755);
+#endif
+	std::ofstream probe((dir + "/.probe").c_str());
+	if (! probe)
+	{
+		std::cerr << "Could not write shader cache " << dir << std::endl;
+		return false;
+	}
+	probe.close();
+	std::remove((dir + "/.probe").c_str());
+
+	directory = dir;
+	driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+	enabled = true;
+	return true;
+}
+
+bool isEnabled()
+{
+	return enabled;
+}
+
+// 64-bit FNV-1a
+static uint64_t hash(uint64_t h, const std::string &s)
+{
+	for (unsigned char c : s)
+	{
+		h ^= c;
+		h *= 1099511628211ull;
+	}
+	// Separator, so "ab" + "c" and "a" + "bc" differ
+	h ^= 0xff;
+	h *= 1099511628211ull;
+	return h;
+}
+
+std::string keyFor(const std::string &vShaderSource, const std::string &fShaderSource)
+{
+	uint64_t h = 14695981039346656037ull;
+	h = hash(h, driver);
+	h = hash(h, vShaderSource);
+	h = hash(h, fShaderSource);
+	std::ostringstream key;
+	key << std::hex << std::setw(16) << std::setfill('0') << h;
+	return key.str();
+}
+
+static std::string pathFor(const std::string &key)
+{
+	return directory + "/" + key + ".bin";
+}
+
+bool load(const std::string &key, GLuint program)
+{
+	if (! enabled)
+	{
+		return false;
+	}
+	double start = now();
+	std::ifstream file(pathFor(key).c_str(), std::ios::binary);
+	Header header;
+	if (! file || ! file.read((char *) &header, sizeof(header)) || memcmp(header.magic, MAGIC, 4) != 0)
+	{
+		stats.misses++;
+		return false;
+	}
+	// The entry must be exactly the header and the binary; a corrupt length
+	// must not turn into a huge allocation
+	std::streampos bodyStart = file.tellg();
+	file.seekg(0, std::ios::end);
+	std::streamoff remaining = file.tellg() - bodyStart;
+	file.seekg(bodyStart);
+	if (! file || header.length == 0 || remaining != (std::streamoff) header.length)
+	{
+		stats.misses++;
+		return false;
+	}
+	std::vector<char> binary(header.length);
+	if (! file.read(binary.data(), binary.size()))
+	{
+		stats.misses++;
+		return false;
+	}
+
+	// A binary the driver won't take either fails the link or raises an
+	// error and does nothing. The error is read once, right after the call;
+	// draining them all would blame the binary for errors left by other code.
+	programBinary(program, header.format, binary.data(), (GLsizei) binary.size());
+	GLenum error = glGetError();
+	GLint linked = 0;
+	CHECKED_GL_CALL(glGetProgramiv(program, GL_LINK_STATUS, &linked));
+	if (error != GL_NO_ERROR)
+	{
+		linked = 0;
+	}
+	if (! linked)
+	{
+		stats.rejected++;
+		return false;
+	}
+
+	double elapsed = now() - start;
+	stats.hits++;
+	stats.loadMs += elapsed;
+	stats.savedMs += header.buildMs - elapsed;
+	return true;
+}
+
+void prepare(GLuint program)
+{
+	if (enabled)
+	{
+		programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+}
+
+void store(const std::string &key, GLuint program, double buildMs)
+{
+	if (! enabled)
+	{
+		return;
+	}
+	GLint length = 0;
+	CHECKED_GL_CALL(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+	if (length <= 0)
+	{
+		return;
+	}
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	getProgramBinary(program, length, &written, &format, binary.data());
+	if (written <= 0)
+	{
+		return;
+	}
+
+	Header header;
+	memcpy(header.magic, MAGIC, 4);
+	header.format = format;
+	header.length = (uint32_t) written;
+	header.reserved = 0;
+	header.buildMs = buildMs;
+
+	// Written aside and renamed, so a crash never leaves half an entry
+	std::string path = pathFor(key);
+	std::string temp = path + ".tmp";
+	{
+		std::ofstream file(temp.c_str(), std::ios::binary);
+		file.write((const char *) &header, sizeof(header));
+		file.write(binary.data(), written);
+		if (! file)
+		{
+			std::cerr << "Could not write " << temp << std::endl;
+			return;
+		}
+	}
+	std::remove(path.c_str());
+	std::rename(temp.c_str(), path.c_str());
+}
+
+const Stats & getStats()
+{
+	return stats;
+}
+
+void printStats(std::ostream &out)
+{
+	if (! enabled)
+	{
+		return;
+	}
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(1);
+	out << "Shader cache: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.rejected << " rejected";
+	if (stats.hits > 0)
+	{
+		out << "; loaded in " << stats.loadMs << " ms, saved " << stats.savedMs << " ms";
+	}
+	out << std::endl;
+	out.flags(flags);
+	out.precision(precision);
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#ifndef LAB471_PROGRAMCACHE_H_INCLUDED
+#define LAB471_PROGRAMCACHE_H_INCLUDED
+
+#include <glad/glad.h>
+#include <ostream>
+#include <string>
+
+
+/**
+ * On-disk cache of linked program binaries (ARB_get_program_binary), so a
+ * launch can skip compiling and linking shaders it has built before.
+ *
+ * A program's key is a hash of its shader sources and the GL vendor,
+ * renderer and version strings, so an edited shader or a driver update
+ * simply misses. The driver may still reject a binary it wrote itself;
+ * the caller then compiles as usual and stores the new binary.
+ *
+ * Each entry also records how long its compile and link took, which is
+ * what a later hit reports as saved.
+ */
+
+namespace ProgramCache
+{
+
+	// Needs a current context; false (and the cache stays off) if the
+	// driver can't hand out binaries or the directory can't be made
+	bool enable(const std::string &directory);
+	bool isEnabled();
+
+	std::string keyFor(const std::string &vShaderSource, const std::string &fShaderSource);
+
+	// Loads the cached binary into program; false on a miss or rejection
+	bool load(const std::string &key, GLuint program);
+	// Call before linking a program that will be stored
+	void prepare(GLuint program);
+	// buildMs: how long compiling and linking it took
+	void store(const std::string &key, GLuint program, double buildMs);
+
+	struct Stats
+	{
+		int hits = 0;
+		int misses = 0;
+		int rejected = 0;
+		double loadMs = 0.0;
+		double savedMs = 0.0;
+	};
+
+	const Stats & getStats();
+	void printStats(std::ostream &out);
+}
+
+#endif // LAB471_PROGRAMCACHE_H_INCLUDED
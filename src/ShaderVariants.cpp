@@ -0,0 +1,171 @@
+#include "ShaderVariants.h"
+#include "LightSet.h"
+#include "ShadowMaps.h"
+#include "Program.h"
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+const int ShaderVariants::MAX_BONES;
+
+void ShaderVariants::setTemplate(const string &v, const string &f)
+{
+	vShaderName = v;
+	fShaderName = f;
+}
+
+string ShaderVariants::describe(unsigned features)
+{
+	static const char *NAMES[] = {"textured", "lit", "instanced", "skinned"};
+	string description;
+	for (int i = 0; i < 4; i++)
+	{
+		if (features & (1u << i))
+		{
+			description += description.empty() ? "" : "+";
+			description += NAMES[i];
+		}
+	}
+	return description.empty() ? "plain" : description;
+}
+
+shared_ptr<Program> ShaderVariants::get(unsigned features)
+{
+	map<unsigned, shared_ptr<Program>>::const_iterator found = variants.find(features);
+	if (found != variants.end())
+	{
+		return found->second;
+	}
+
+	ostringstream defines;
+	defines << "#define MAX_BONES " << MAX_BONES << "\n";
+	if (features & TEXTURED)
+	{
+		defines << "#define TEXTURED\n";
+	}
+	if (features & LIT)
+	{
+		defines << "#define LIT\n";
+	}
+	if (features & INSTANCED)
+	{
+		defines << "#define INSTANCED\n";
+	}
+	if (features & SKINNED)
+	{
+		defines << "#define SKINNED\n";
+	}
+
+	shared_ptr<Program> program = make_shared<Program>();
+	program->setVerbose(true);
+	program->setShaderNames(vShaderName, fShaderName);
+	program->setDefines(defines.str());
+	program->submit();
+	variants[features] = program;
+	pending.push_back(features);
+	return program;
+}
+
+bool ShaderVariants::finish()
+{
+	while (! pending.empty())
+	{
+		bool finishedAny = false;
+		for (size_t i = 0; i < pending.size(); )
+		{
+			Program &program = *variants[pending[i]];
+			if (! program.isReady())
+			{
+				i++;
+				continue;
+			}
+			if (! program.finish())
+			{
+				cerr << "Could not build the " << describe(pending[i]) << " variant of " << vShaderName << endl;
+				return false;
+			}
+			lookUpVariables(pending[i], program);
+			pending.erase(pending.begin() + i);
+			finishedAny = true;
+		}
+		if (! finishedAny)
+		{
+			this_thread::yield();
+		}
+	}
+	return true;
+}
+
+void ShaderVariants::lookUpVariables(unsigned features, Program &program)
+{
+	program.addUniform("P");
+	program.addUniform("V");
+	if (! (features & INSTANCED))
+	{
+		program.addUniform("M");
+	}
+	if (features & TEXTURED)
+	{
+		program.addUniform("Texture0");
+	}
+	if (! (features & TEXTURED) || (features & LIT))
+	{
+		program.addUniform("MatDif");
+	}
+	if (features & LIT)
+	{
+		if (! (features & (INSTANCED | SKINNED)))
+		{
+			program.addUniform("N");
+		}
+		program.addUniform("MatAmb");
+		program.addUniform("MatSpec");
+		program.addUniform("shine");
+		LightSet::attach(program);
+		ShadowMaps::attach(program);
+	}
+	if (features & SKINNED)
+	{
+		program.addUniform("Bones");
+	}
+
+	// Shape::draw asks for all three whatever the variant, so register the
+	// ones it lacks too (as -1), quietly; likewise N, which the game sets
+	// with every M
+	program.addAttribute("vertPos");
+	program.setVerbose(false);
+	program.addAttribute("vertNor");
+	program.addAttribute("vertTex");
+	if (! (features & LIT) || (features & (INSTANCED | SKINNED)))
+	{
+		program.addUniform("N");
+	}
+	program.setVerbose(true);
+}
+
+bool ShaderVariants::usesShader(const string &path) const
+{
+	return path == vShaderName || path == fShaderName;
+}
+
+void ShaderVariants::reload()
+{
+	for (map<unsigned, shared_ptr<Program>>::const_iterator variant = variants.begin(); variant != variants.end(); ++variant)
+	{
+		variant->second->reload();
+	}
+}
+
+void ShaderVariants::updateReload(vector<shared_ptr<Program>> &swapped)
+{
+	swapped.clear();
+	for (map<unsigned, shared_ptr<Program>>::const_iterator variant = variants.begin(); variant != variants.end(); ++variant)
+	{
+		if (variant->second->updateReload())
+		{
+			swapped.push_back(variant->second);
+		}
+	}
+}
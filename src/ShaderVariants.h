@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef LAB471_SHADERVARIANTS_H_INCLUDED
+#define LAB471_SHADERVARIANTS_H_INCLUDED
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Program;
+
+
+/**
+ * Programs built from one vertex/fragment template, specialized at compile
+ * time by #define flags, so each draw can use a shader that does exactly
+ * what it needs and nothing else.
+ *
+ * A variant is only compiled the first time it is asked for, and then kept.
+ * Its variables are looked up once it is finished: P and V always, M unless
+ * instanced, Texture0 if textured, MatDif unless only textured, the
+ * other material uniforms and the normal matrix N if lit (N is computed in
+ * the shader when instanced or skinned), Bones if skinned. Lit variants read
+ * their lights from the LightSet buffers.
+ */
+class ShaderVariants
+{
+
+public:
+
+	enum Feature
+	{
+		TEXTURED = 1 << 0,
+		LIT = 1 << 1,
+		// Model matrix from a per-instance attribute instead of M
+		INSTANCED = 1 << 2,
+		// Vertices blended from up to four bone matrices
+		SKINNED = 1 << 3
+	};
+
+	static const int MAX_BONES = 64;
+
+	void setTemplate(const std::string &vShaderName, const std::string &fShaderName);
+
+	// The variant with exactly these features, submitted for building the
+	// first time it is asked for
+	std::shared_ptr<Program> get(unsigned features);
+	// Finishes every variant submitted so far, each as soon as it is ready;
+	// false if one fails to build
+	bool finish();
+
+	// Hot reload of the template
+	bool usesShader(const std::string &path) const;
+	void reload();
+	// Swaps in rebuilt variants that are ready, and lists them
+	void updateReload(std::vector<std::shared_ptr<Program>> &swapped);
+
+	size_t getCount() const { return variants.size(); }
+
+	static std::string describe(unsigned features);
+
+private:
+
+	void lookUpVariables(unsigned features, Program &program);
+
+	std::string vShaderName;
+	std::string fShaderName;
+	std::map<unsigned, std::shared_ptr<Program>> variants;
+	std::vector<unsigned> pending;
+
+};
+
+#endif // LAB471_SHADERVARIANTS_H_INCLUDED
@@ -0,0 +1,244 @@
+#include "ShadowMaps.h"
+#include "GLSL.h"
+#include "GLState.h"
+#include "Program.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+using namespace std;
+using namespace glm;
+
+const int ShadowMaps::MAX_CASCADES;
+const GLuint ShadowMaps::BINDING;
+const char * const ShadowMaps::BLOCK_NAME = "Shadows";
+const GLuint ShadowMaps::UNIT;
+
+// How far towards the light, beyond a cascade, casters are still drawn
+static const float CASTER_REACH = 30.f;
+
+// The uniform block, std140
+struct Block
+{
+	GLint shadowParams[4];
+	GLfloat cascadeEnds[4];
+	GLfloat shadowMatrices[ShadowMaps::MAX_CASCADES][16];
+};
+
+ShadowMaps::~ShadowMaps()
+{
+	if (ubo != 0)
+	{
+		GLState::deleteBuffer(ubo);
+	}
+	if (shadowMap != 0)
+	{
+		GLState::deleteTexture(shadowMap);
+	}
+	if (staticMap != 0)
+	{
+		GLState::deleteTexture(staticMap);
+	}
+	if (drawFbo != 0)
+	{
+		glDeleteFramebuffers(1, &drawFbo);
+		glDeleteFramebuffers(1, &readFbo);
+	}
+}
+
+static GLuint createDepthArray(int resolution, int layers, bool sampled)
+{
+	GLuint texture = 0;
+	CHECKED_GL_CALL(glGenTextures(1, &texture));
+	GLState::bindTexture(ShadowMaps::UNIT, GL_TEXTURE_2D_ARRAY, texture);
+	CHECKED_GL_CALL(glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, layers, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr));
+	CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0));
+	if (sampled)
+	{
+		// Linear filtering of a compared depth gives 2x2 PCF for free
+		CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+		CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+		CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE));
+		CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL));
+		// Outside the map is lit
+		const GLfloat border[4] = {1.f, 1.f, 1.f, 1.f};
+		CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER));
+		CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER));
+		CHECKED_GL_CALL(glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border));
+	}
+	else
+	{
+		CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+		CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+	}
+	return texture;
+}
+
+bool ShadowMaps::init(const Config &c)
+{
+	config = c;
+	config.cascades = std::min(std::max(config.cascades, 0), MAX_CASCADES);
+	config.resolution = std::max(config.resolution, 1);
+
+	CHECKED_GL_CALL(glGenBuffers(1, &ubo));
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+	Block block = {};
+	CHECKED_GL_CALL(glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_DYNAMIC_DRAW));
+	GLState::bindBufferBase(GL_UNIFORM_BUFFER, BINDING, ubo);
+
+	if (config.cascades == 0)
+	{
+		// Lit shaders still sample something; the block says not to use it
+		shadowMap = createDepthArray(1, 1, true);
+		return true;
+	}
+	shadowMap = createDepthArray(config.resolution, config.cascades, true);
+	staticMap = createDepthArray(config.resolution, config.cascades, false);
+
+	CHECKED_GL_CALL(glGenFramebuffers(1, &drawFbo));
+	CHECKED_GL_CALL(glGenFramebuffers(1, &readFbo));
+	// Depth only
+	GLuint fbos[2] = {drawFbo, readFbo};
+	for (GLuint fbo : fbos)
+	{
+		CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, fbo));
+		CHECKED_GL_CALL(glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMap, 0, 0));
+		CHECKED_GL_CALL(glDrawBuffer(GL_NONE));
+		CHECKED_GL_CALL(glReadBuffer(GL_NONE));
+	}
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Shadow map framebuffer incomplete (" << status << ")" << std::endl;
+		config.cascades = 0;
+		return false;
+	}
+	return true;
+}
+
+void ShadowMaps::attach(Program &program)
+{
+	program.bindUniformBlock(BLOCK_NAME, BINDING);
+	program.bindSampler("ShadowMap", UNIT);
+}
+
+void ShadowMaps::invalidate()
+{
+	for (int c = 0; c < MAX_CASCADES; c++)
+	{
+		staticValid[c] = false;
+	}
+}
+
+void ShadowMaps::update(const mat4 &V, const mat4 &P, const vec3 &towardsLight, int shaderLight)
+{
+	Block block = {};
+	block.shadowParams[0] = config.cascades;
+	block.shadowParams[1] = shaderLight;
+
+	if (config.cascades > 0)
+	{
+		vec3 direction = normalize(towardsLight);
+		if (direction != lightDirection)
+		{
+			lightDirection = direction;
+			invalidate();
+		}
+		vec3 up = std::abs(direction.y) > .99f ? vec3(1.f, 0.f, 0.f) : vec3(0.f, 1.f, 0.f);
+		lightView = lookAt(vec3(0.f), -direction, up);
+
+		// The view frustum, from the projection
+		float tanX = 1.f / P[0][0];
+		float tanY = 1.f / P[1][1];
+		float nearPlane = P[3][2] / (P[2][2] - 1.f);
+		float farPlane = P[3][2] / (P[2][2] + 1.f);
+		float end = std::min(config.distance, farPlane);
+		// Logarithmic splits from the near plane would make the first
+		// cascade uselessly small
+		float logNear = std::min(1.f, end);
+
+		mat4 toWorld = inverse(V);
+		// Clip space to texture coordinates and depth
+		mat4 bias(.5f);
+		bias[3] = vec4(.5f, .5f, .5f, 1.f);
+
+		float start = nearPlane;
+		for (int c = 0; c < config.cascades; c++)
+		{
+			float t = (c + 1) / (float) config.cascades;
+			float uniformSplit = nearPlane + (end - nearPlane) * t;
+			float logSplit = logNear * std::pow(end / logNear, t);
+			float stop = uniformSplit + (logSplit - uniformSplit) * config.splitBlend;
+
+			// Sphere around the slice: the same size however the camera
+			// turns, so the cascade's texel size never changes
+			float middle = .5f * (start + stop);
+			vec3 farCorner(stop * tanX, stop * tanY, stop - middle);
+			vec3 nearCorner(start * tanX, start * tanY, middle - start);
+			float radius = std::sqrt(std::max(dot(farCorner, farCorner), dot(nearCorner, nearCorner)));
+
+			// An eighth of slack, so the centre can snap to steps of up to
+			// that many whole texels and still cover the sphere
+			float half = radius * 1.125f;
+			float texel = 2.f * half / config.resolution;
+			float step = texel * std::max(1.f, std::floor((half - radius) / texel));
+			vec3 centre = vec3(lightView * toWorld * vec4(0.f, 0.f, -middle, 1.f));
+			centre = vec3(std::floor(centre.x / step), std::floor(centre.y / step), std::floor(centre.z / step)) * step;
+
+			projections[c] = ortho(centre.x - half, centre.x + half, centre.y - half, centre.y + half,
+				-(centre.z + half + CASTER_REACH), -(centre.z - half));
+			mat4 shadowMatrix = bias * projections[c] * lightView * toWorld;
+			memcpy(block.shadowMatrices[c], value_ptr(shadowMatrix), sizeof(block.shadowMatrices[c]));
+			block.cascadeEnds[c] = stop;
+			start = stop;
+		}
+	}
+
+	GLState::bindBuffer(GL_UNIFORM_BUFFER, ubo);
+	CHECKED_GL_CALL(glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block));
+}
+
+bool ShadowMaps::needsStatic(int cascade) const
+{
+	return ! staticValid[cascade] || staticProjections[cascade] != projections[cascade];
+}
+
+void ShadowMaps::target(GLuint texture, int cascade)
+{
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, drawFbo));
+	CHECKED_GL_CALL(glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, cascade));
+	GLState::viewport(0, 0, config.resolution, config.resolution);
+	GLState::depthMask(GL_TRUE);
+	// Pushes casters back a little, against shadow acne
+	CHECKED_GL_CALL(glEnable(GL_POLYGON_OFFSET_FILL));
+	CHECKED_GL_CALL(glPolygonOffset(1.5f, 4.f));
+}
+
+void ShadowMaps::beginStatic(int cascade)
+{
+	target(staticMap, cascade);
+	CHECKED_GL_CALL(glClear(GL_DEPTH_BUFFER_BIT));
+	staticProjections[cascade] = projections[cascade];
+	staticValid[cascade] = true;
+}
+
+void ShadowMaps::beginDynamic(int cascade)
+{
+	target(shadowMap, cascade);
+	CHECKED_GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo));
+	CHECKED_GL_CALL(glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticMap, 0, cascade));
+	CHECKED_GL_CALL(glBlitFramebuffer(0, 0, config.resolution, config.resolution, 0, 0, config.resolution, config.resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST));
+	CHECKED_GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, drawFbo));
+}
+
+void ShadowMaps::end(int width, int height)
+{
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+	CHECKED_GL_CALL(glDisable(GL_POLYGON_OFFSET_FILL));
+	GLState::viewport(0, 0, width, height);
+	GLState::bindTexture(UNIT, GL_TEXTURE_2D_ARRAY, shadowMap);
+}
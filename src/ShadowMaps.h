@@ -0,0 +1,104 @@
+#pragma once
+
+#ifndef LAB471_SHADOWMAPS_H_INCLUDED
+#define LAB471_SHADOWMAPS_H_INCLUDED
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class Program;
+
+
+/**
+ * Cascaded shadow maps for one directional light.
+ *
+ * The view out to a shadow distance is split into cascades, each covered by
+ * one layer of a depth texture array; nearer cascades cover less and so get
+ * sharper shadows. Each cascade is fitted to a sphere around its slice of
+ * the view, with the centre snapped to a coarse grid in light space, so it
+ * only moves when the camera has moved a fair way.
+ *
+ * Static casters are drawn into a cached copy of each layer, redrawn only
+ * when its cascade moves (or invalidate() is called). Every frame the cached
+ * layer is blitted into the sampled one and only the dynamic casters are
+ * drawn over it.
+ *
+ * Lit shaders read the matrices from the "Shadows" uniform block and the
+ * depths through a sampler2DArrayShadow.
+ */
+class ShadowMaps
+{
+
+public:
+
+	static const int MAX_CASCADES = 4;
+	// Uniform buffer binding point of the block (LightSet uses 0)
+	static const GLuint BINDING = 1;
+	static const char * const BLOCK_NAME;
+	// Texture unit of the maps, below LightSet's
+	static const GLuint UNIT = 11;
+
+	struct Config
+	{
+		// Texels per side of each cascade
+		int resolution = 2048;
+		// 0 turns shadows off
+		int cascades = 3;
+		// View depth the last cascade ends at
+		float distance = 40.f;
+		// Splits between uniform (0) and logarithmic (1) spacing
+		float splitBlend = .75f;
+	};
+
+	ShadowMaps() = default;
+	ShadowMaps(const ShadowMaps &) = delete;
+	ShadowMaps & operator=(const ShadowMaps &) = delete;
+	~ShadowMaps();
+
+	bool init(const Config &config);
+	// Points a lit program's block and sampler at the maps
+	static void attach(Program &program);
+
+	// Fits the cascades to this view and uploads the block. towardsLight is
+	// the light's direction, shaderLight its index among the directional
+	// lights the shaders see.
+	void update(const glm::mat4 &V, const glm::mat4 &P, const glm::vec3 &towardsLight, int shaderLight);
+	// Static casters moved
+	void invalidate();
+
+	int getCascadeCount() const { return config.cascades; }
+	const glm::mat4 & getLightView() const { return lightView; }
+	const glm::mat4 & getProjection(int cascade) const { return projections[cascade]; }
+
+	// Whether the cached static layer of a cascade must be redrawn
+	bool needsStatic(int cascade) const;
+	// Targets the cached layer, cleared, for the static casters
+	void beginStatic(int cascade);
+	// Copies the cached layer into the sampled one and targets that, for
+	// the dynamic casters
+	void beginDynamic(int cascade);
+	// Back to the default framebuffer
+	void end(int width, int height);
+
+private:
+
+	void target(GLuint texture, int cascade);
+
+	Config config;
+	GLuint ubo = 0;
+	// Static casters only, and static plus dynamic (the one sampled)
+	GLuint staticMap = 0;
+	GLuint shadowMap = 0;
+	GLuint drawFbo = 0;
+	GLuint readFbo = 0;
+
+	glm::vec3 lightDirection = glm::vec3(0.f);
+	glm::mat4 lightView = glm::mat4(1.f);
+	glm::mat4 projections[MAX_CASCADES];
+	// The projection each cached layer was drawn with
+	glm::mat4 staticProjections[MAX_CASCADES];
+	bool staticValid[MAX_CASCADES] = {};
+
+};
+
+#endif // LAB471_SHADOWMAPS_H_INCLUDED
@@ -4,10 +4,14 @@
 #include <cassert>
 
 #include "GLSL.h"
+#include "GLState.h"
+#include "MeshLOD.h"
+#include "MeshOptimizer.h"
 #include "Program.h"
 
 using namespace std;
 
+const float Shape::LOD_HYSTERESIS = .25f;
 
 // copy the data from the shape to this object
 void Shape::createShape(tinyobj::shape_t & shape)
@@ -16,6 +20,35 @@ void Shape::createShape(tinyobj::shape_t & shape)
 	norBuf = shape.mesh.normals;
 	texBuf = shape.mesh.texcoords;
 	eleBuf = shape.mesh.indices;
+	lods.clear();
+	lods.push_back({0, eleBuf.size(), 0.f});
+}
+
+bool Shape::setLods(const MeshLOD::Mesh &mesh)
+{
+	if (mesh.vertexCount != posBuf.size() / 3 || mesh.indexCount != lods[0].count)
+	{
+		return false;
+	}
+	for (const MeshLOD::Level &level : mesh.levels)
+	{
+		lods.push_back({eleBuf.size(), level.indices.size(), level.error});
+		eleBuf.insert(eleBuf.end(), level.indices.begin(), level.indices.end());
+	}
+	return true;
+}
+
+int Shape::pickLod(float pixelsPerUnit, float maxPixels, int current) const
+{
+	for (int lod = (int) lods.size() - 1; lod > 0; lod--)
+	{
+		float limit = lod > current ? maxPixels * (1.f - LOD_HYSTERESIS) : maxPixels;
+		if (lods[lod].error * pixelsPerUnit <= limit)
+		{
+			return lod;
+		}
+	}
+	return 0;
 }
 
 void Shape::measure()
@@ -47,15 +80,41 @@ void Shape::measure()
 	max.z = maxZ;
 }
 
+size_t Shape::residentBytes = 0;
+Shape::DrawStats Shape::drawStats;
+
+void Shape::optimize()
+{
+	size_t vertexCount = posBuf.size() / 3;
+	vector<size_t> clusters;
+	for (const Lod &lod : lods)
+	{
+		if (lod.count > 0)
+		{
+			MeshOptimizer::optimizeVertexCache(&eleBuf[lod.first], lod.count, vertexCount, MeshOptimizer::CACHE_SIZE, &clusters);
+			MeshOptimizer::optimizeOverdraw(&eleBuf[lod.first], lod.count, posBuf, clusters);
+		}
+	}
+	// The full mesh's indices come first, so its vertices are the ones laid
+	// out in order
+	vector<unsigned int> remap;
+	MeshOptimizer::optimizeVertexFetch(eleBuf, vertexCount, remap);
+	MeshOptimizer::remapVertices(posBuf, 3, remap);
+	MeshOptimizer::remapVertices(norBuf, 3, remap);
+	MeshOptimizer::remapVertices(texBuf, 2, remap);
+}
+
 void Shape::init()
 {
+	optimize();
+
 	// Initialize the vertex array object
 	CHECKED_GL_CALL(glGenVertexArrays(1, &vaoID));
-	CHECKED_GL_CALL(glBindVertexArray(vaoID));
+	GLState::bindVertexArray(vaoID);
 
 	// Send the position array to the GPU
 	CHECKED_GL_CALL(glGenBuffers(1, &posBufID));
-	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, posBufID));
+	GLState::bindBuffer(GL_ARRAY_BUFFER, posBufID);
 	CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, posBuf.size()*sizeof(float), &posBuf[0], GL_STATIC_DRAW));
 
 	// Send the normal array to the GPU
@@ -66,7 +125,7 @@ void Shape::init()
 	else
 	{
 		CHECKED_GL_CALL(glGenBuffers(1, &norBufID));
-		CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, norBufID));
+		GLState::bindBuffer(GL_ARRAY_BUFFER, norBufID);
 		CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, norBuf.size()*sizeof(float), &norBuf[0], GL_STATIC_DRAW));
 	}
 
@@ -78,31 +137,33 @@ void Shape::init()
 	else
 	{
 		CHECKED_GL_CALL(glGenBuffers(1, &texBufID));
-		CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, texBufID));
+		GLState::bindBuffer(GL_ARRAY_BUFFER, texBufID);
 		CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, texBuf.size()*sizeof(float), &texBuf[0], GL_STATIC_DRAW));
 	}
 
 	// Send the element array to the GPU
 	CHECKED_GL_CALL(glGenBuffers(1, &eleBufID));
-	CHECKED_GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID));
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID);
 	CHECKED_GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, eleBuf.size()*sizeof(unsigned int), &eleBuf[0], GL_STATIC_DRAW));
 
+	residentBytes += (posBuf.size() + norBuf.size() + texBuf.size()) * sizeof(float) + eleBuf.size() * sizeof(unsigned int);
+
 	// Unbind the arrays
-	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
-	CHECKED_GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
-void Shape::draw(const shared_ptr<Program> prog) const
+void Shape::draw(const shared_ptr<Program> prog, int lod) const
 {
 	int h_pos, h_nor, h_tex;
 	h_pos = h_nor = h_tex = -1;
 
-	CHECKED_GL_CALL(glBindVertexArray(vaoID));
+	GLState::bindVertexArray(vaoID);
 
 	// Bind position buffer
 	h_pos = prog->getAttribute("vertPos");
 	GLSL::enableVertexAttribArray(h_pos);
-	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, posBufID));
+	GLState::bindBuffer(GL_ARRAY_BUFFER, posBufID);
 	CHECKED_GL_CALL(glVertexAttribPointer(h_pos, 3, GL_FLOAT, GL_FALSE, 0, (const void *)0));
 
 	// Bind normal buffer
@@ -110,7 +171,7 @@ void Shape::draw(const shared_ptr<Program> prog) const
 	if (h_nor != -1 && norBufID != 0)
 	{
 		GLSL::enableVertexAttribArray(h_nor);
-		CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, norBufID));
+		GLState::bindBuffer(GL_ARRAY_BUFFER, norBufID);
 		CHECKED_GL_CALL(glVertexAttribPointer(h_nor, 3, GL_FLOAT, GL_FALSE, 0, (const void *)0));
 	}
 
@@ -122,16 +183,19 @@ void Shape::draw(const shared_ptr<Program> prog) const
 		if (h_tex != -1 && texBufID != 0)
 		{
 			GLSL::enableVertexAttribArray(h_tex);
-			CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, texBufID));
+			GLState::bindBuffer(GL_ARRAY_BUFFER, texBufID);
 			CHECKED_GL_CALL(glVertexAttribPointer(h_tex, 2, GL_FLOAT, GL_FALSE, 0, (const void *)0));
 		}
 	}
 
 	// Bind element buffer
-	CHECKED_GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID));
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, eleBufID);
 
 	// Draw
-	CHECKED_GL_CALL(glDrawElements(GL_TRIANGLES, (int)eleBuf.size(), GL_UNSIGNED_INT, (const void *)0));
+	const Lod &level = lods[lod];
+	CHECKED_GL_CALL(glDrawElements(GL_TRIANGLES, (int)level.count, GL_UNSIGNED_INT, (const void *)(level.first * sizeof(unsigned int))));
+	drawStats.triangles += level.count / 3;
+	drawStats.fullTriangles += lods[0].count / 3;
 
 	// Disable and unbind
 	if (h_tex != -1)
@@ -143,6 +207,6 @@ void Shape::draw(const shared_ptr<Program> prog) const
 		GLSL::disableVertexAttribArray(h_nor);
 	}
 	GLSL::disableVertexAttribArray(h_pos);
-	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
-	CHECKED_GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+	GLState::bindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
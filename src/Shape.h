@@ -11,6 +11,7 @@
 #include "tiny_obj_loader.h"
 
 class Program;
+namespace MeshLOD { struct Mesh; }
 
 
 class Shape
@@ -18,26 +19,68 @@ class Shape
 
 public:
 
+	// Triangles sent by draw() since the last reset, and how many it would
+	// have sent with every shape at full detail
+	struct DrawStats
+	{
+		size_t triangles = 0;
+		size_t fullTriangles = 0;
+	};
+
+	// A coarser level needs its error this much under the limit before a
+	// shape switches to it, so one near the limit doesn't flicker
+	static const float LOD_HYSTERESIS;
+
 	void createShape(tinyobj::shape_t & shape);
+	// Adds the baked levels of detail of this shape, before init(). False
+	// if they were baked from a different mesh.
+	bool setLods(const MeshLOD::Mesh &mesh);
+	// Reorders the mesh for the vertex cache and fetches, then uploads it
 	void init();
 	void measure();
-	void draw(const std::shared_ptr<Program> prog) const;
+	void draw(const std::shared_ptr<Program> prog, int lod = 0) const;
+
+	// Level 0 is the full mesh
+	int getLodCount() const { return (int) lods.size(); }
+	float getLodError(int lod) const { return lods[lod].error; }
+	size_t getTriangleCount(int lod = 0) const { return lods[lod].count / 3; }
+	// The coarsest level whose error, at this many pixels per unit of the
+	// mesh, is at most maxPixels
+	int pickLod(float pixelsPerUnit, float maxPixels, int current) const;
+
+	// Vertex and index bytes of every shape sent to the GPU so far
+	static size_t getResidentBytes() { return residentBytes; }
+	static const DrawStats & getDrawStats() { return drawStats; }
+	static void resetDrawStats() { drawStats = DrawStats(); }
 
 	glm::vec3 min = glm::vec3(0);
 	glm::vec3 max = glm::vec3(0);
 
 private:
 
+	void optimize();
+
 	std::vector<unsigned int> eleBuf;
 	std::vector<float> posBuf;
 	std::vector<float> norBuf;
 	std::vector<float> texBuf;
+	// Every level's indices, one after another in eleBuf
+	struct Lod
+	{
+		size_t first;
+		size_t count;
+		float error;
+	};
+	std::vector<Lod> lods;
 	unsigned int eleBufID = 0;
 	unsigned int posBufID = 0;
 	unsigned int norBufID = 0;
 	unsigned int texBufID = 0;
 	unsigned int vaoID = 0;
 
+	static size_t residentBytes;
+	static DrawStats drawStats;
+
 };
 
 #endif // LAB471_SHAPE_H_INCLUDED
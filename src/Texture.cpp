@@ -1,9 +1,13 @@
 
 #include "Texture.h"
 #include "GLSL.h"
+#include "GLState.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
+#include <algorithm>
+
+#include "ImageMips.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -11,8 +15,225 @@
 using namespace std;
 
 
+static string replaceExtension(const string &f, const string &ext)
+{
+	size_t dot = f.find_last_of('.');
+	size_t slash = f.find_last_of("/\\");
+	if (dot == string::npos || (slash != string::npos && dot < slash))
+	{
+		return f + ext;
+	}
+	return f.substr(0, dot) + ext;
+}
+
+bool Texture::isFormatSupported(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		return GLSL::hasExtension("GL_EXT_texture_compression_s3tc");
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+		return GLSL::isVersionAtLeast(4, 2) || GLSL::hasExtension("GL_ARB_texture_compression_bptc");
+	case GL_COMPRESSED_RGB8_ETC2:
+	case GL_COMPRESSED_RGBA8_ETC2_EAC:
+		return GLSL::isVersionAtLeast(4, 3) || GLSL::hasExtension("GL_ARB_ES3_compatibility");
+	case GL_RGB:
+	case GL_RGBA:
+	case GL_RGB8:
+	case GL_RGBA8:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void Texture::uploadKTX(const KTX::Image &image, GLenum target, int firstLevel)
+{
+	for (int level = firstLevel; level < (int) image.levels.size(); level++)
+	{
+		const KTX::Level &lvl = image.levels[level];
+		if (target == GL_TEXTURE_2D_ARRAY)
+		{
+			// Allocate every layer of the level, then fill them one by one
+			GLint glLevel = level - firstLevel;
+			if (image.isCompressed())
+			{
+				vector<unsigned char> packed(lvl.faceSize * image.faces);
+				for (int layer = 0; layer < image.faces; layer++)
+				{
+					copy(lvl.faces[layer], lvl.faces[layer] + lvl.faceSize, packed.begin() + lvl.faceSize * layer);
+				}
+				CHECKED_GL_CALL(glCompressedTexImage3D(target, glLevel, image.glInternalFormat, lvl.width, lvl.height, image.faces, 0, (GLsizei) packed.size(), packed.data()));
+				continue;
+			}
+			CHECKED_GL_CALL(glTexImage3D(target, glLevel, image.glInternalFormat, lvl.width, lvl.height, image.faces, 0, image.glFormat, image.glType, nullptr));
+			for (int layer = 0; layer < image.faces; layer++)
+			{
+				CHECKED_GL_CALL(glTexSubImage3D(target, glLevel, 0, 0, layer, lvl.width, lvl.height, 1, image.glFormat, image.glType, lvl.faces[layer]));
+			}
+			continue;
+		}
+		for (int face = 0; face < image.faces; face++)
+		{
+			GLenum faceTarget = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+			if (image.isCompressed())
+			{
+				CHECKED_GL_CALL(glCompressedTexImage2D(faceTarget, level - firstLevel, image.glInternalFormat, lvl.width, lvl.height, 0, (GLsizei) lvl.faceSize, lvl.faces[face]));
+			}
+			else
+			{
+				CHECKED_GL_CALL(glTexImage2D(faceTarget, level - firstLevel, image.glInternalFormat, lvl.width, lvl.height, 0, image.glFormat, image.glType, lvl.faces[face]));
+			}
+		}
+	}
+	// The chain may stop before 1x1; clamp so the texture stays complete
+	CHECKED_GL_CALL(glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, (GLint) image.levels.size() - firstLevel - 1));
+}
+
+void Texture::applySamplerState(int levels)
+{
+	CHECKED_GL_CALL(glTexParameteri(target, GL_TEXTURE_WRAP_S, wrapS));
+	CHECKED_GL_CALL(glTexParameteri(target, GL_TEXTURE_WRAP_T, wrapT));
+	if (target == GL_TEXTURE_CUBE_MAP)
+	{
+		CHECKED_GL_CALL(glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE));
+	}
+	CHECKED_GL_CALL(glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+	CHECKED_GL_CALL(glTexParameteri(target, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+}
+
+bool Texture::initFromKTX(const std::string &ktxName)
+{
+	// The cache is mapped, not read, so GL copies straight out of the page cache
+	KTX::MappedFile file;
+	if (! file.open(ktxName))
+	{
+		return false;
+	}
+
+	KTX::Image image;
+	string err;
+	if (! KTX::parse(file.data(), file.size(), image, err))
+	{
+		cerr << ktxName << ": " << err << endl;
+		return false;
+	}
+	if (image.faces != getFaceCount())
+	{
+		cerr << ktxName << " has " << image.faces << " face(s), which does not match the texture type" << endl;
+		return false;
+	}
+	if (! isFormatSupported(image.glInternalFormat))
+	{
+		cerr << ktxName << ": " << KTX::formatName(image.glInternalFormat) << " is not supported by this driver, decoding the source image instead" << endl;
+		return false;
+	}
+
+	width = image.width;
+	height = image.height;
+
+	CHECKED_GL_CALL(glGenTextures(1, &tid));
+	GLState::bindTexture(target, tid);
+
+	// Upload the pre-baked mip chain as-is; compressed blocks go straight to VRAM
+	uploadKTX(image, target);
+
+	int levels = (int) image.levels.size();
+	if (levels == 1 && ! image.isCompressed() && target == GL_TEXTURE_2D)
+	{
+		CHECKED_GL_CALL(glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 1000));
+		CHECKED_GL_CALL(glGenerateMipmap(target));
+		levels = 2;
+	}
+	applySamplerState(levels);
+
+	GLState::bindTexture(target, 0);
+	return true;
+}
+
+int Texture::getFaceCount() const
+{
+	if (target == GL_TEXTURE_CUBE_MAP)
+	{
+		return 6;
+	}
+	return target == GL_TEXTURE_2D_ARRAY ? (int) faceFiles.size() : 1;
+}
+
+void Texture::setCubeFaces(const std::vector<std::string> &faces)
+{
+	faceFiles = faces;
+	target = GL_TEXTURE_CUBE_MAP;
+}
+
+void Texture::setLayers(const std::vector<std::string> &layers)
+{
+	faceFiles = layers;
+	target = GL_TEXTURE_2D_ARRAY;
+}
+
+void Texture::initCubeFaces()
+{
+	CHECKED_GL_CALL(glGenTextures(1, &tid));
+	GLState::bindTexture(GL_TEXTURE_CUBE_MAP, tid);
+
+	// load each image and copy into a side of the cube-map texture
+	stbi_set_flip_vertically_on_load(true);
+	for (size_t face = 0; face < faceFiles.size(); face++)
+	{
+		int x, y, n;
+		unsigned char *image_data = stbi_load(faceFiles[face].c_str(), &x, &y, &n, 4);
+		if (! image_data)
+		{
+			cerr << "ERROR: could not load " << faceFiles[face] << endl;
+			continue;
+		}
+		// non-power-of-2 dimensions check
+		if ((x & (x - 1)) != 0 || (y & (y - 1)) != 0)
+		{
+			cerr << "WARNING: image " << faceFiles[face] << " is not power-of-2 dimensions" << endl;
+		}
+		width = x;
+		height = y;
+
+		// copy image data into 'target' side of cube map
+		CHECKED_GL_CALL(glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + (GLenum) face, 0, GL_RGBA, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data));
+		stbi_image_free(image_data);
+	}
+
+	// format cube map texture
+	applySamplerState(1);
+	GLState::bindTexture(GL_TEXTURE_CUBE_MAP, 0);
+}
+
 void Texture::init()
 {
+	// Prefer a precompressed sibling (foo.jpg -> foo.ktx) with baked mips,
+	// which skips both the JPEG decode and glGenerateMipmap
+	if (initFromKTX(replaceExtension(filename, ".ktx")))
+	{
+		return;
+	}
+	if (target == GL_TEXTURE_2D_ARRAY)
+	{
+		// Assembled from the layers' source images
+		if (loadSource())
+		{
+			setResidentLevel(0);
+			releaseSource();
+		}
+		return;
+	}
+	if (target == GL_TEXTURE_CUBE_MAP)
+	{
+		initCubeFaces();
+		return;
+	}
+
 	// Load texture
 	int w, h, ncomps;
 	stbi_set_flip_vertically_on_load(true);
@@ -35,7 +256,7 @@ void Texture::init()
 	// Generate a texture buffer object
 	CHECKED_GL_CALL(glGenTextures(1, &tid));
 	// Bind the current texture to be the newly generated texture object
-	CHECKED_GL_CALL(glBindTexture(GL_TEXTURE_2D, tid));
+	GLState::bindTexture(GL_TEXTURE_2D, tid);
 
 	// Load the actual texture data
 	// Base level is 0, number of channels is 3, and border is 0.
@@ -44,35 +265,173 @@ void Texture::init()
 	CHECKED_GL_CALL(glGenerateMipmap(GL_TEXTURE_2D));
 
 	// Set texture wrap modes for the S and T directions
-	CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-	CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+	CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS));
+	CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT));
 	// Set filtering mode for magnification and minimification
 	CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
 	CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR));
 
 	// Unbind
-	CHECKED_GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+	GLState::bindTexture(GL_TEXTURE_2D, 0);
 	// Free image, since the data is now on the GPU
 	stbi_image_free(data);
 }
 
-void Texture::setWrapModes(GLint wrapS, GLint wrapT)
+bool Texture::loadSource()
 {
-	// Must be called after init()
-	CHECKED_GL_CALL(glBindTexture(GL_TEXTURE_2D, tid));
-	CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS));
-	CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT));
+	releaseSource();
+
+	string err;
+	if (sourceFile.open(replaceExtension(filename, ".ktx")))
+	{
+		if (KTX::parse(sourceFile.data(), sourceFile.size(), source, err) &&
+			source.faces == getFaceCount() &&
+			isFormatSupported(source.glInternalFormat))
+		{
+			width = source.width;
+			height = source.height;
+			return true;
+		}
+		source = KTX::Image();
+		sourceFile.close();
+	}
+
+	// No usable bake: decode and build the chain ourselves, as RGBA so every
+	// row is 4-byte aligned for glTexImage2D
+	vector<string> files = target == GL_TEXTURE_2D ? vector<string>(1, filename) : faceFiles;
+	vector<vector<ImageMips::Level>> chains;
+	stbi_set_flip_vertically_on_load(true);
+	for (const string &file : files)
+	{
+		int w, h, ncomps;
+		unsigned char *data = stbi_load(file.c_str(), &w, &h, &ncomps, 4);
+		if (! data)
+		{
+			cerr << file << " not found" << endl;
+			return false;
+		}
+		if (! chains.empty() && (w != chains[0][0].width || h != chains[0][0].height))
+		{
+			// Faces and layers share one size; stretching would cost VRAM
+			// for detail the image doesn't have
+			cerr << file << " is " << w << "x" << h << ", not " << chains[0][0].width << "x" << chains[0][0].height << " like " << files[0] << endl;
+			stbi_image_free(data);
+			return false;
+		}
+		chains.push_back(vector<ImageMips::Level>());
+		ImageMips::buildChain(data, w, h, ImageMips::BOX, chains.back());
+		stbi_image_free(data);
+	}
+
+	source.glType = GL_UNSIGNED_BYTE;
+	source.glFormat = GL_RGBA;
+	source.glInternalFormat = target == GL_TEXTURE_CUBE_MAP ? GL_RGBA8 : GL_RGB8;
+	source.glBaseInternalFormat = target == GL_TEXTURE_CUBE_MAP ? GL_RGBA : GL_RGB;
+	source.width = width = chains[0][0].width;
+	source.height = height = chains[0][0].height;
+	source.faces = (int) chains.size();
+	for (size_t level = 0; level < chains[0].size(); level++)
+	{
+		KTX::Level lvl;
+		lvl.width = chains[0][level].width;
+		lvl.height = chains[0][level].height;
+		lvl.faceSize = chains[0][level].pixels.size();
+		for (size_t face = 0; face < chains.size(); face++)
+		{
+			sourceLevels.push_back(std::move(chains[face][level].pixels));
+			lvl.faces.push_back(sourceLevels.back().data());
+		}
+		source.levels.push_back(lvl);
+	}
+	return true;
+}
+
+void Texture::releaseSource()
+{
+	source = KTX::Image();
+	sourceLevels.clear();
+	sourceFile.close();
+}
+
+size_t Texture::setResidentLevel(int level)
+{
+	if (! hasSource())
+	{
+		return 0;
+	}
+	level = std::min(std::max(level, 0), getLevelCount() - 1);
+	if (level == residentLevel)
+	{
+		return 0;
+	}
+
+	// GL has no way to drop or add the finest levels of an existing texture
+	// (short of sparse textures), so build a fresh one from the source and
+	// swap it in. The bytes involved are dominated by the new finest level.
+	GLuint newTid;
+	CHECKED_GL_CALL(glGenTextures(1, &newTid));
+	GLState::bindTexture(target, newTid);
+	uploadKTX(source, target, level);
+	applySamplerState(getLevelCount() - level);
+	GLState::bindTexture(target, 0);
+
+	if (tid != 0)
+	{
+		GLState::deleteTexture(tid);
+	}
+	tid = newTid;
+	residentLevel = level;
+
+	return getChainBytes(level);
+}
+
+size_t Texture::getLevelBytes(int level) const
+{
+	const KTX::Level &lvl = source.levels[level];
+	if (source.isCompressed())
+	{
+		return lvl.faceSize * source.faces;
+	}
+	// Drivers pad RGB8 to 4 bytes per texel
+	return (size_t) lvl.width * lvl.height * 4 * source.faces;
+}
+
+size_t Texture::getChainBytes(int level) const
+{
+	size_t bytes = 0;
+	for (int i = std::max(level, 0); i < getLevelCount(); i++)
+	{
+		bytes += getLevelBytes(i);
+	}
+	return bytes;
+}
+
+void Texture::setWrapModes(GLint s, GLint t)
+{
+	// Remembered so init() and streaming re-uploads apply them too
+	wrapS = s;
+	wrapT = t;
+	if (tid == 0)
+	{
+		return;
+	}
+	GLState::bindTexture(target, tid);
+	CHECKED_GL_CALL(glTexParameteri(target, GL_TEXTURE_WRAP_S, wrapS));
+	CHECKED_GL_CALL(glTexParameteri(target, GL_TEXTURE_WRAP_T, wrapT));
 }
 
 void Texture::bind(GLint handle)
 {
-	CHECKED_GL_CALL(glActiveTexture(GL_TEXTURE0 + unit));
-	CHECKED_GL_CALL(glBindTexture(GL_TEXTURE_2D, tid));
+	GLState::bindTexture(unit, target, tid);
 	CHECKED_GL_CALL(glUniform1i(handle, unit));
 }
 
+void Texture::bind()
+{
+	GLState::bindTexture(unit, target, tid);
+}
+
 void Texture::unbind()
 {
-	CHECKED_GL_CALL(glActiveTexture(GL_TEXTURE0 + unit));
-	CHECKED_GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+	GLState::bindTexture(unit, target, 0);
 }
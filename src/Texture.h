@@ -1,4 +1,3 @@
-
 #pragma once
 
 #ifndef LAB471_TEXTURE_H_INCLUDED
@@ -6,6 +5,8 @@
 
 #include <glad/glad.h>
 #include <string>
+#include <vector>
+#include "KTX.h"
 
 
 class Texture
@@ -13,22 +14,77 @@ class Texture
 
 public:
 
+	Texture() {}
+
+	Texture(const Texture&) = delete;
+	Texture& operator= (const Texture&) = delete;
+
 	void setFilename(const std::string &f) { filename = f; }
+	// Makes this a cube map. Faces are in GL order (+X, -X, +Y, -Y, +Z, -Z)
+	// and are only decoded when there is no baked <filename>.ktx.
+	void setCubeFaces(const std::vector<std::string> &faces);
+	// Makes this a GL_TEXTURE_2D_ARRAY with one layer per image, in order.
+	// The images must all be the same size. A baked <filename>.ktx with one
+	// face per layer is used instead if there is one.
+	void setLayers(const std::vector<std::string> &layers);
 	void init();
 	void setUnit(GLint u) { unit = u; }
 	GLint getUnit() const { return unit; }
 	void bind(GLint handle);
+	// Binds to the unit without touching uniforms; skipped if already bound
+	void bind();
 	void unbind();
-	void setWrapModes(GLint wrapS, GLint wrapT); // Must be called after init()
+	void setWrapModes(GLint wrapS, GLint wrapT); // Before or after init()
 	GLint getID() const { return tid; }
+	GLenum getTarget() const { return target; }
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+
+	// Streaming. Instead of init(), loadSource() keeps every mip level in
+	// system memory (the mapped KTX, or a decoded chain) and
+	// setResidentLevel() uploads only levels from that one down to 1x1.
+	bool loadSource();
+	void releaseSource();
+	bool hasSource() const { return ! source.levels.empty(); }
+	int getLevelCount() const { return (int) source.levels.size(); }
+	int getResidentLevel() const { return residentLevel; }
+	// Re-creates the GL texture with levels [level, last]; returns bytes uploaded
+	size_t setResidentLevel(int level);
+	// Size of one level, all faces, as stored in VRAM (estimated for RGB)
+	size_t getLevelBytes(int level) const;
+	// Bytes of the levels from level down to 1x1
+	size_t getChainBytes(int level) const;
+
+	// True if the current context can sample a KTX image's internal format
+	static bool isFormatSupported(GLenum internalFormat);
+	// Uploads levels [firstLevel, last] of a KTX image as GL levels [0, ...]
+	// to the texture bound to target. Cube maps pass GL_TEXTURE_CUBE_MAP and
+	// get all six faces; GL_TEXTURE_2D_ARRAY treats the faces as layers.
+	static void uploadKTX(const KTX::Image &image, GLenum target, int firstLevel = 0);
 
 private:
 
+	bool initFromKTX(const std::string &ktxName);
+	// Faces a KTX image needs to fit this texture: 6, one per layer, or 1
+	int getFaceCount() const;
+	void initCubeFaces();
+	void applySamplerState(int levels);
+
 	std::string filename;
+	std::vector<std::string> faceFiles; // cube faces or array layers
+	GLenum target = GL_TEXTURE_2D;
 	int width = 0;
 	int height = 0;
 	GLuint tid = 0;
 	GLint unit = 0;
+	GLint wrapS = GL_CLAMP_TO_EDGE;
+	GLint wrapT = GL_CLAMP_TO_EDGE;
+
+	// Streaming source, either pointing into sourceFile or sourceLevels
+	KTX::MappedFile sourceFile;
+	KTX::Image source;
+	std::vector<std::vector<unsigned char>> sourceLevels;
+	int residentLevel = -1;
 
 };
 
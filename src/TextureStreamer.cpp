@@ -0,0 +1,171 @@
+
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+using namespace std;
+
+
+bool TextureStreamer::add(const shared_ptr<Texture> &texture, int startSize)
+{
+	if (! texture->loadSource())
+	{
+		return false;
+	}
+
+	// Start from the finest level that is still no bigger than startSize
+	int level = 0;
+	int size = max(texture->getWidth(), texture->getHeight());
+	while (size > startSize && level < texture->getLevelCount() - 1)
+	{
+		size /= 2;
+		level++;
+	}
+	stats.totalUploadedBytes += texture->setResidentLevel(level);
+
+	Entry entry;
+	entry.texture = texture;
+	entry.targetLevel = level;
+	entries.push_back(entry);
+	return true;
+}
+
+void TextureStreamer::request(const shared_ptr<Texture> &texture, float screenPixels)
+{
+	for (Entry &entry : entries)
+	{
+		if (entry.texture == texture)
+		{
+			entry.requestedPixels = max(entry.requestedPixels, screenPixels);
+			entry.requested = true;
+			return;
+		}
+	}
+}
+
+float TextureStreamer::projectedSize(float worldSize, float distance, float fovY, int viewportHeight)
+{
+	distance = max(distance, 1e-3f);
+	return worldSize / (2.f * distance * tan(fovY / 2.f)) * viewportHeight;
+}
+
+int TextureStreamer::levelForSize(const Texture &texture, float screenPixels) const
+{
+	// One texel per pixel: level n has size / 2^n texels
+	float texels = (float) max(texture.getWidth(), texture.getHeight());
+	if (screenPixels <= 1.f)
+	{
+		return texture.getLevelCount() - 1;
+	}
+	int level = (int) floor(log2(texels / screenPixels));
+	return min(max(level, 0), texture.getLevelCount() - 1);
+}
+
+void TextureStreamer::update()
+{
+	stats.uploadedBytes = 0;
+	stats.evictedBytes = 0;
+	stats.uploads = 0;
+	stats.evictions = 0;
+	stats.budgetBytes = budget;
+
+	// What each texture would like; unrequested textures keep what they have
+	size_t total = 0;
+	for (Entry &entry : entries)
+	{
+		const Texture &tex = *entry.texture;
+		entry.targetLevel = entry.requested ? levelForSize(tex, entry.requestedPixels) : tex.getResidentLevel();
+		total += tex.getChainBytes(entry.targetLevel);
+	}
+
+	// Over budget: take detail away from the least visible texture first.
+	// Unrequested textures have 0 pixels, so they are always dropped first.
+	while (total > budget)
+	{
+		Entry *victim = nullptr;
+		for (Entry &entry : entries)
+		{
+			if (entry.targetLevel >= entry.texture->getLevelCount() - 1)
+			{
+				continue;
+			}
+			if (! victim || entry.requestedPixels < victim->requestedPixels)
+			{
+				victim = &entry;
+			}
+		}
+		if (! victim)
+		{
+			break;
+		}
+		total -= victim->texture->getLevelBytes(victim->targetLevel);
+		victim->targetLevel++;
+	}
+
+	// Evict immediately, so the memory is free before anything else grows
+	for (Entry &entry : entries)
+	{
+		Texture &tex = *entry.texture;
+		if (entry.targetLevel > tex.getResidentLevel())
+		{
+			stats.evictedBytes += tex.getChainBytes(tex.getResidentLevel()) - tex.getChainBytes(entry.targetLevel);
+			stats.evictions++;
+			tex.setResidentLevel(entry.targetLevel);
+		}
+	}
+
+	// Grow one level per texture per frame, most visible first, until the
+	// upload budget for this frame is spent
+	vector<Entry *> growing;
+	for (Entry &entry : entries)
+	{
+		if (entry.targetLevel < entry.texture->getResidentLevel())
+		{
+			growing.push_back(&entry);
+		}
+	}
+	sort(growing.begin(), growing.end(), [](const Entry *a, const Entry *b)
+	{
+		return a->requestedPixels > b->requestedPixels;
+	});
+	for (Entry *entry : growing)
+	{
+		Texture &tex = *entry->texture;
+		size_t cost = tex.getChainBytes(tex.getResidentLevel() - 1);
+		if (stats.uploads > 0 && stats.uploadedBytes + cost > uploadBudget)
+		{
+			break;
+		}
+		stats.uploadedBytes += tex.setResidentLevel(tex.getResidentLevel() - 1);
+		stats.uploads++;
+	}
+
+	stats.residentBytes = 0;
+	for (Entry &entry : entries)
+	{
+		stats.residentBytes += entry.texture->getChainBytes(entry.texture->getResidentLevel());
+		entry.requested = false;
+		entry.requestedPixels = 0.f;
+	}
+	stats.totalUploadedBytes += stats.uploadedBytes;
+	stats.totalEvictions += stats.evictions;
+}
+
+void TextureStreamer::printStats(ostream &out) const
+{
+	const double MiB = 1024.0 * 1024.0;
+	out << fixed << setprecision(2);
+	out << "Texture residency: " << stats.residentBytes / MiB << " / " << stats.budgetBytes / MiB << " MiB, "
+		<< stats.totalUploadedBytes / MiB << " MiB uploaded, " << stats.totalEvictions << " evictions" << endl;
+	for (const Entry &entry : entries)
+	{
+		const Texture &tex = *entry.texture;
+		int level = tex.getResidentLevel();
+		out << "  tex " << tex.getID() << (tex.getTarget() == GL_TEXTURE_CUBE_MAP ? " (cube)" : "")
+			<< ": level " << level << " (" << max(tex.getWidth() >> level, 1) << "x" << max(tex.getHeight() >> level, 1) << ")"
+			<< " of " << tex.getLevelCount() << ", target " << entry.targetLevel
+			<< ", " << tex.getChainBytes(level) / MiB << " MiB" << endl;
+	}
+	out.unsetf(ios::floatfield);
+}
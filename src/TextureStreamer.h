@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef LAB471_TEXTURESTREAMER_H_INCLUDED
+#define LAB471_TEXTURESTREAMER_H_INCLUDED
+
+#include <memory>
+#include <vector>
+#include <ostream>
+#include "Texture.h"
+
+
+/**
+ * Keeps textures under a VRAM budget by controlling how many mip levels of
+ * each are resident.
+ *
+ * Textures start with only their small mips uploaded. Each frame the caller
+ * reports how large each texture appears on screen; update() then raises the
+ * resident level of the textures that need more detail (a level at a time,
+ * within a per-frame upload budget) and drops detail from the least important
+ * textures whenever the total would exceed the budget.
+ */
+class TextureStreamer
+{
+
+public:
+
+	struct Stats
+	{
+		size_t residentBytes = 0;
+		size_t budgetBytes = 0;
+		size_t uploadedBytes = 0;   // this frame
+		size_t evictedBytes = 0;    // this frame
+		size_t totalUploadedBytes = 0;
+		int uploads = 0;            // this frame
+		int evictions = 0;          // this frame
+		int totalEvictions = 0;
+	};
+
+	void setBudget(size_t bytes) { budget = bytes; }
+	size_t getBudget() const { return budget; }
+	void setUploadBudget(size_t bytesPerFrame) { uploadBudget = bytesPerFrame; }
+
+	// Takes over a texture that has been set up but not init()ed. Only the
+	// levels no larger than startSize texels are uploaded right away.
+	bool add(const std::shared_ptr<Texture> &texture, int startSize = 64);
+
+	// Requests enough detail for the texture to cover screenPixels pixels
+	// across. Call every frame for every visible user of the texture.
+	void request(const std::shared_ptr<Texture> &texture, float screenPixels);
+
+	// Approximate on-screen size in pixels of something worldSize units
+	// across, seen from distance units away.
+	static float projectedSize(float worldSize, float distance, float fovY, int viewportHeight);
+
+	// Applies this frame's requests: evicts to fit the budget, then uploads.
+	void update();
+
+	const Stats & getStats() const { return stats; }
+	void printStats(std::ostream &out) const;
+
+private:
+
+	struct Entry
+	{
+		std::shared_ptr<Texture> texture;
+		float requestedPixels = 0.f;
+		bool requested = false;
+		int targetLevel = 0;
+	};
+
+	int levelForSize(const Texture &texture, float screenPixels) const;
+
+	std::vector<Entry> entries;
+	size_t budget = 64 * 1024 * 1024;
+	size_t uploadBudget = 8 * 1024 * 1024;
+	Stats stats;
+
+};
+
+#endif // LAB471_TEXTURESTREAMER_H_INCLUDED
@@ -30,7 +30,7 @@ WindowManager::~WindowManager()
 	}
 }
 
-bool WindowManager::init(int const width, int const height)
+bool WindowManager::init(int const width, int const height, bool visible)
 {
 	glfwSetErrorCallback(error_callback);
 
@@ -45,6 +45,7 @@ bool WindowManager::init(int const width, int const height)
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+	glfwWindowHint(GLFW_VISIBLE, visible ? GL_TRUE : GL_FALSE);
 
 	// Create a windowed mode window and its OpenGL context.
 	windowHandle = glfwCreateWindow(width, height, "openGL program", nullptr, nullptr);
@@ -73,6 +74,7 @@ bool WindowManager::init(int const width, int const height)
 	glfwSetMouseButtonCallback(windowHandle, mouse_callback);
 	glfwSetFramebufferSizeCallback(windowHandle, resize_callback);
    glfwSetScrollCallback(windowHandle, scroll_callback);
+	glfwSetCursorPosCallback(windowHandle, cursor_callback);
 
 	return true;
 }
@@ -83,6 +85,11 @@ void WindowManager::shutdown()
 	glfwTerminate();
 }
 
+void WindowManager::setVsync(bool enabled)
+{
+	glfwSwapInterval(enabled ? 1 : 0);
+}
+
 void WindowManager::setEventCallbacks(EventCallbacks * callbacks_in)
 {
 	callbacks = callbacks_in;
@@ -117,6 +124,14 @@ void WindowManager::scroll_callback(GLFWwindow * window, double dX, double dY)
 	}
 }
 
+void WindowManager::cursor_callback(GLFWwindow * window, double x, double y)
+{
+	if (instance && instance->callbacks)
+	{
+		instance->callbacks->cursorCallback(window, x, y);
+	}
+}
+
 void WindowManager::resize_callback(GLFWwindow * window, int in_width, int in_height)
 {
 	if (instance && instance->callbacks)
@@ -35,6 +35,7 @@ public:
 
 	virtual void mouseCallback(GLFWwindow *window, int button, int action, int mods) = 0;
 	virtual void scrollCallback(GLFWwindow *window, double dX, double dY) = 0;
+	virtual void cursorCallback(GLFWwindow *window, double x, double y) = 0;
 
 	virtual void resizeCallback(GLFWwindow *window, int in_width, int in_height) = 0;
 
@@ -54,7 +55,9 @@ public:
 	WindowManager(const WindowManager&) = delete;
 	WindowManager& operator= (const WindowManager&) = delete;
 
-	bool init(int const width, int const height);
+	// A hidden window still gets a GL context, for running without a display
+	bool init(int const width, int const height, bool visible = true);
+	void setVsync(bool enabled);
 	void shutdown();
 
 	void setEventCallbacks(EventCallbacks *callbacks);
@@ -80,6 +83,7 @@ private:
 	static void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 	static void mouse_callback(GLFWwindow *window, int button, int action, int mods);
 	static void scroll_callback(GLFWwindow *window, double dX, double dY);
+	static void cursor_callback(GLFWwindow *window, double x, double y);
 	static void resize_callback(GLFWwindow *window, int in_width, int in_height);
 
 };
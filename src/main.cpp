@@ -3,15 +3,36 @@ Shubham Kahal Final Project CPE 471
  */
 
 #include <iostream>
+#include <thread>
+#include <random>
 #include <glad/glad.h>
 #include "stb_image.h"
 
 #include "GLSL.h"
+#include "GLState.h"
+#include "GLCalls.h"
 #include "Program.h"
+#include "ShaderVariants.h"
+#include "ProgramCache.h"
 #include "MatrixStack.h"
 #include "Shape.h"
 #include "WindowManager.h"
 #include "GLTextureWriter.h"
+#include "Texture.h"
+#include "TextureStreamer.h"
+#include "FixedTimestep.h"
+#include "EntityStore.h"
+#include "BroadPhase.h"
+#include "NarrowPhase.h"
+#include "BallPhysics.h"
+#include "InputLog.h"
+#include "Profiler.h"
+#include "PerfHud.h"
+#include "FileWatcher.h"
+#include "LightSet.h"
+#include "MeshLOD.h"
+#include "ShadowMaps.h"
+#include "DrawList.h"
 
 // value_ptr for glm
 #include <glm/gtc/type_ptr.hpp>
@@ -20,74 +41,6 @@ Shubham Kahal Final Project CPE 471
 using namespace std;
 using namespace glm;
 
-class GameObject
-{
-	public:
-	    // Object state
-	    vec3 Position, Size, Velocity, Acceleration;
-	    float Radius, RotX = 0.f, RotY = 0.f, RotZ = 0.f;
-	    float currentSpeed = 0.f;
-	    float currentTurnSpeed = 0.f;
-	    float deltaX, deltaZ;
-	    
-	    // Constructor(s)
-	    GameObject() {
-
-	    }
-
-	    GameObject(vec3 pos, vec3 size, vec3 velocity = vec3(1.0f, 1.0f, 1.0f), vec3 acceleration = vec3(1.0f, 1.0f, 1.0f), float radius = 0.0, float rotX = 0.0, float rotY = 0.0, float rotZ = 0.0) {
-	    	Position = pos;
-	    	Size = size;
-	    	Velocity = velocity;
-	    	Acceleration = acceleration;
-	    	Radius = radius;
-	    	RotX = rotX;
-	    	RotY = rotY;
-	    	RotZ = rotZ;
-	    }
-
-	    // Methods(s)
-
-	    vec3 Move() {
-	    	// DisplayManager.getFrameTimeSeconds()
-		    IncreaseRotation(0, this->currentTurnSpeed, 0);
-		    
-		    float distance = this->currentSpeed * .01;
-
-		    float dx = distance * cos(radians(this->RotY));
-		    float dz = distance * sin(radians(this->RotY));
-
-		    this->deltaX = dx;
-		    this->deltaZ = dz;
-
-		    IncreasePosition(dx, 0.f, dz);
-
-		    // returning the position to set the position for foot
-		    return this->Position;
-        }
-
-        void IncreaseRotation(float rotdx, float rotdy, float rotdz) {
-        	this->RotX += rotdx;
-        	this->RotY += rotdy;
-        	this->RotZ += rotdz;
-        }
-
-        void IncreasePosition(float dx, float dy, float dz) {
-        	this->Position.x += dx;
-        	this->Position.y += dy;
-        	this->Position.z += dz;
-        }
-};
-
-void create_cube_map(
-	  const char* front,
-	  const char* back,
-	  const char* top,
-	  const char* bottom,
-	  const char* left,
-	  const char* right,
-	  GLuint* tex_cube);
-
 class Application : public EventCallbacks
 {
 
@@ -95,7 +48,8 @@ public:
 
 	WindowManager * windowManager = nullptr;
 
-	// Our shader program
+	// Our shader programs: lit, textured, and textured and lit variants of
+	// the surface shader, and the sky
 	std::shared_ptr<Program> prog;
 	std::shared_ptr<Program> texProg;
 	std::shared_ptr<Program> texProg1;
@@ -113,7 +67,7 @@ public:
 	shared_ptr<Shape> exclamationPoint;
 
 	//ground plane info
-	GLuint GrndBuffObj, GrndNorBuffObj, GrndTexBuffObj, GIndxBuffObj;
+	GLuint GrndVAO, GrndBuffObj, GrndNorBuffObj, GrndTexBuffObj, GIndxBuffObj;
 	int gGiboLen;
 
 	// Contains vertex information for OpenGL
@@ -126,9 +80,10 @@ public:
 	GLuint quad_VertexArrayID;
 	GLuint quad_vertexbuffer;
 
-	//three different textures
-	shared_ptr<Texture> texture0;
- 	shared_ptr<Texture> texture1;
+	// Each on a unit of its own, so once bound, drawing one after the other
+	// needs no texture binds in between
+	shared_ptr<Texture> fieldTexture;
+	shared_ptr<Texture> ballTexture;
 
 	int gMat = 0;
 
@@ -158,7 +113,7 @@ public:
 
 	bool mouseDown = false;
 
-	double currX, currY, lastX, lastY;
+	double currX = 0.0, currY = 0.0, lastX = 0.0, lastY = 0.0;
 	// theta is for yaw, phi is for pitch
 	double theta = -(M_PI / 2), phi = 0.0f;
 
@@ -174,8 +129,6 @@ public:
     vec3 strafe = cross(viewVector, upVector);
     vec3 speed = vec3(.25, .25, .25);
 
-    float lightPos[3] = {-6.0, 5.0, 0.0};
-
     // Variable for moving the light position
 	float lightTrans = 0;
 
@@ -186,14 +139,60 @@ public:
 
 	vec3 ballTranslation = vec3(2, -.7f, -5);
 
-	GameObject *Ball = new GameObject();
-	GameObject *Player = new GameObject();
-	GameObject *Foot = new GameObject();
-	GameObject *GoldGoal = new GameObject();
-	GameObject *BlueGoal = new GameObject();
-
-	const float RUN_SPEED = 10.f;
-	const float TURN_SPEED = 10.f;
+	EntityStore entities;
+	Entity Ball = entities.create();
+	Entity Player = entities.create();
+	Entity Foot = entities.create();
+	Entity GoldGoal = entities.create();
+	Entity BlueGoal = entities.create();
+
+	// Per second. Key repeat used to move the player .1 and turn it 10
+	// degrees per event, about 30 times a second.
+	const float RUN_SPEED = 3.f;
+	const float TURN_SPEED = 300.f;
+	const float KICK_CHARGE_RATE = 150.f;
+	// Degrees per second
+	const float BALL_SPIN_RATE = 600.f;
+	const float KICK_WINDUP_RATE = 180.f;
+	// How far apart the foot and ball can be for a kick
+	const float KICK_RANGE = 1.f;
+	// Ball speed given by each unit of kick power
+	const float KICK_SPEED_PER_POWER = .1f;
+	// Slower than this (units per second) the ball stops spinning
+	const float BALL_REST_SPEED = .05f;
+	const float LIMB_SWING_RATE = 24.f;
+
+	// Held keys; the simulation reads these every step
+	bool forwardHeld = false;
+	bool backHeld = false;
+	bool leftHeld = false;
+	bool rightHeld = false;
+	bool kickHeld = false;
+
+	bool goldGoalCollison = false;
+	bool blueGoalCollison = false;
+
+	// Finds which objects might touch; NarrowPhase confirms
+	BroadPhase broadPhase;
+	std::vector<BroadPhase::Pair> candidatePairs;
+	std::vector<NarrowPhase::Contact> contacts;
+	NarrowPhase::Batch narrowBatch;
+
+	BallPhysics ballPhysics;
+	std::vector<BallPhysics::Obstacle> ballObstacles;
+	std::vector<BallPhysics::Hit> ballHits;
+
+	// What render() draws, interpolated between the last two steps
+	struct SimState
+	{
+		vec3 playerPos;
+		float playerRotY;
+		vec3 ballPos;
+		float ballZRot;
+		float limbRot;
+		float kickRot;
+	};
+	SimState prevState;
 
 	float kickPower = 0.f;
 	bool powerKick = false;
@@ -201,8 +200,52 @@ public:
 
 	GLuint vbo;
 	GLuint vao;
-	GLuint texture_cube;
-	GLuint* cube_texture = &texture_cube;
+	shared_ptr<Texture> skybox;
+
+	// Keeps the textures' resident mip levels within a VRAM budget
+	TextureStreamer streamer;
+
+	// Frame times, pass times and memory on screen; H toggles it
+	PerfHud hud;
+
+	// Submitted in init, finished after the meshes are loaded
+	vector<shared_ptr<Program>> pendingPrograms;
+	// Variants of the surface shader that prog, texProg and texProg1 are
+	ShaderVariants surfaces;
+	// Shader files of those programs, rebuilt when saved
+	FileWatcher shaderWatcher;
+
+	// Every lit shader's lights, in one uniform buffer
+	LightSet lights;
+	// The one E and Q move
+	int movableLight = -1;
+	// Floodlights scattered over the pitch, from --lights=N
+	int floodlights = 0;
+	// The one that casts shadows
+	int sunLight = -1;
+	ShadowMaps shadows;
+	// From --shadow-size=N and --cascades=N
+	ShadowMaps::Config shadowConfig;
+	// This frame's camera, for the normal matrices
+	mat4 view;
+
+	// This frame's opaque draws, sorted before they are submitted
+	DrawList opaque;
+	// Z toggles; --depth-prepass starts with it on
+	bool depthPrepass = false;
+	// Plain variant of the surface shader, for the pre-pass
+	shared_ptr<Program> depthProg;
+
+	// Baked levels of detail, from meshbake. O toggles; --no-lod starts
+	// with them off
+	bool useLods = true;
+	// Largest error of a level on screen, from --lod-pixels=P
+	float lodPixels = 1.f;
+	// Shape::DrawStats summed over every frame, for the average at exit
+	Shape::DrawStats triangleTotals;
+	long long renderedFrames = 0;
+
+	const float FOV_Y = 45.0f;
 
 	bool ballMoving = false;
 
@@ -242,85 +285,73 @@ public:
 		{
 			lightTrans += .25;
 
-			lightPos[0] = lightTrans;
+			lights.get(movableLight).position.x = lightTrans;
 		} 
 		else if (key == GLFW_KEY_Q && action == GLFW_PRESS) 
 		{
 			lightTrans -= .25;
 
-			lightPos[0] = lightTrans;
+			lights.get(movableLight).position.x = lightTrans;
 		}
-		else if (key == GLFW_KEY_I && action == GLFW_REPEAT) 
+		else if (key == GLFW_KEY_I && action != GLFW_REPEAT)
 		{
-			dummyMoving = true;
-
-			Player->currentSpeed = RUN_SPEED;
-
-			Foot->Position = Player->Move();
+			forwardHeld = action == GLFW_PRESS;
 		}
-		else if (key == GLFW_KEY_I && action == GLFW_RELEASE) 
+		else if (key == GLFW_KEY_K && action != GLFW_REPEAT)
 		{
-			dummyMoving = false;
-
-			Player->currentSpeed = 0.f;
+			backHeld = action == GLFW_PRESS;
 		}
-		else if (key == GLFW_KEY_K && action == GLFW_REPEAT) 
+		else if (key == GLFW_KEY_J && action != GLFW_REPEAT)
 		{
-			dummyMoving = true;
-
-			Player->currentSpeed = -RUN_SPEED;
-
-			Foot->Position = Player->Move();
+			leftHeld = action == GLFW_PRESS;
 		}
-		else if (key == GLFW_KEY_K && action == GLFW_RELEASE) 
+		else if (key == GLFW_KEY_L && action != GLFW_REPEAT)
 		{
-			dummyMoving = false;
-
-			Player->currentSpeed = 0.f;
+			rightHeld = action == GLFW_PRESS;
 		}
-		else if (key == GLFW_KEY_J && action == GLFW_REPEAT) 
+		else if (key == GLFW_KEY_SPACE && action != GLFW_REPEAT)
 		{
-			dummyMoving = true;
-
-			Player->currentTurnSpeed = -TURN_SPEED;
+			kickHeld = action == GLFW_PRESS;
 
-			Foot->Position = Player->Move();
+			if (action == GLFW_RELEASE)
+			{
+				releaseKick = true;
+			}
 		}
-		else if (key == GLFW_KEY_J && action == GLFW_RELEASE) 
+		else if (key == GLFW_KEY_T && action == GLFW_PRESS)
 		{
-			dummyMoving = false;
-
-			Player->currentTurnSpeed = 0.f;
+			streamer.printStats(std::cout);
 		}
-		else if (key == GLFW_KEY_L && action == GLFW_REPEAT) 
+		else if (key == GLFW_KEY_G && action == GLFW_PRESS)
 		{
-			dummyMoving = true;
-
-			Player->currentTurnSpeed = TURN_SPEED;
-
-			Foot->Position = Player->Move();
+			GLState::printCounters(std::cout);
 		}
-		else if (key == GLFW_KEY_L && action == GLFW_RELEASE) 
+		else if (key == GLFW_KEY_H && action == GLFW_PRESS)
 		{
-			Player->currentTurnSpeed = 0.f;
-
-			dummyMoving = false;
+			hud.toggle();
 		}
-		else if (key == GLFW_KEY_SPACE && action == GLFW_REPEAT) 
+		else if (key == GLFW_KEY_Z && action == GLFW_PRESS)
 		{
-			powerKick = true;
-
-			kickPower += 5.f;
+			depthPrepass = ! depthPrepass;
+			std::cout << "Depth pre-pass " << (depthPrepass ? "on" : "off") << std::endl;
+		}
+		else if (key == GLFW_KEY_O && action == GLFW_PRESS)
+		{
+			useLods = ! useLods;
+			std::cout << "Levels of detail " << (useLods ? "on" : "off") << std::endl;
 		}
-		else if (key == GLFW_KEY_SPACE && action == GLFW_RELEASE) 
+		else if (key == GLFW_KEY_C && action == GLFW_PRESS && GLCalls::isInstalled())
 		{
-			releaseKick = true;
+			std::cout << "GL calls last frame:" << std::endl;
+			GLCalls::printCounts(std::cout, GLCalls::getLastFrame());
 		}
 	}
 
 	void scrollCallback(GLFWwindow* window, double deltaX, double deltaY)
 	{
 		cTheta += (float) deltaX;
+		// The whole scene turns with it, goals and ground too
+		shadows.invalidate();
 	}
 
 	void mouseCallback(GLFWwindow *window, int button, int action, int mods)
@@ -330,8 +361,6 @@ public:
 			Moving = true;
 			mouseDown = true;
 
-			glfwGetCursorPos(window, &currX, &currY);
-
 			lastX = currX;
 			lastY = currY;
 		}
@@ -340,30 +369,54 @@ public:
 		{
 			Moving = false;
 			mouseDown = false;
-
-			glfwGetCursorPos(window, &currX, &currY);
 		}
 	}
 
+	// The cursor is only read from here, so a replayed log can move it
+	void cursorCallback(GLFWwindow *window, double x, double y)
+	{
+		currX = x;
+		currY = y;
+	}
+
 	void resizeCallback(GLFWwindow *window, int width, int height)
 	{
-		glViewport(0, 0, width, height);
+		GLState::viewport(0, 0, width, height);
 	}
 
 	// Code to load in the three textures
 	void initTex(const std::string& resourceDirectory)
 	{
-	 	texture0 = make_shared<Texture>();
-		texture0->setFilename(resourceDirectory + "/soccer_field.jpg");
-		texture0->init();
-		texture0->setUnit(0);
-		texture0->setWrapModes(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
-
-		texture1 = make_shared<Texture>();
-		texture1->setFilename(resourceDirectory + "/soccer_texture.jpg");
-		texture1->init();
-		texture1->setUnit(1);
-		texture1->setWrapModes(GL_REPEAT, GL_REPEAT);
+	 	fieldTexture = make_shared<Texture>();
+		fieldTexture->setFilename(resourceDirectory + "/soccer_field.jpg");
+		fieldTexture->setWrapModes(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+		fieldTexture->setUnit(0);
+		addStreamed(fieldTexture);
+
+		ballTexture = make_shared<Texture>();
+		ballTexture->setFilename(resourceDirectory + "/soccer_texture.jpg");
+		ballTexture->setWrapModes(GL_REPEAT, GL_REPEAT);
+		ballTexture->setUnit(1);
+		addStreamed(ballTexture);
+
+		// Faces in GL order (+X, -X, +Y, -Y, +Z, -Z); sincity.ktx is used if baked
+		skybox = make_shared<Texture>();
+		skybox->setFilename(resourceDirectory + "/sincity.jpg");
+		skybox->setCubeFaces({
+			resourceDirectory + "/sincity_lf.tga", resourceDirectory + "/sincity_rt.tga",
+			resourceDirectory + "/sincity_up.tga", resourceDirectory + "/sincity_dn.tga",
+			resourceDirectory + "/sincity_bk.tga", resourceDirectory + "/sincity_ft.tga" });
+		addStreamed(skybox);
+	}
+
+	// Starts a texture with only its small mips resident, or loads it whole
+	// if its source can't be kept around for streaming
+	void addStreamed(const shared_ptr<Texture> &texture)
+	{
+		if (! streamer.add(texture))
+		{
+			texture->init();
+		}
 	}
 
 	//code to set up the two shaders - a diffuse shader and texture mapping
@@ -376,88 +429,188 @@ public:
 		cTheta = 0;
 		// Set background color.
 		glClearColor(.12f, .34f, .56f, 1.0f);
-		// Enable z-buffer test.
+		// Enable z-buffer test. Less or equal, so the sky passes at the far
+		// plane and the depth pre-pass's own depths pass again.
 		glEnable(GL_DEPTH_TEST);
-
-		// Initialize the GLSL program.
-		prog = make_shared<Program>();
-		prog->setVerbose(true);
-		prog->setShaderNames(
-			resourceDirectory + "/simple_vert.glsl",
-			resourceDirectory + "/simple_frag.glsl");
-		if (! prog->init())
+		glDepthFunc(GL_LEQUAL);
+
+		// Start every program compiling, then decode textures and (in
+		// initGeom) load meshes while the driver works; finishPrograms()
+		// collects them
+		// Each draw uses the leanest variant of the surface shader it can:
+		// players and goals are lit, the ball textured, the ground both
+		surfaces.setTemplate(resourceDirectory + "/surface_vert.glsl", resourceDirectory + "/surface_frag.glsl");
+		prog = surfaces.get(ShaderVariants::LIT);
+		texProg = surfaces.get(ShaderVariants::TEXTURED);
+		texProg1 = surfaces.get(ShaderVariants::TEXTURED | ShaderVariants::LIT);
+		depthProg = surfaces.get(0);
+		texProg2 = submitProgram(resourceDirectory + "/cube_map_vert.glsl", resourceDirectory + "/cube_map_frag.glsl");
+
+		// Compiles along with the others; the game runs without the HUD if
+		// it can't be set up
+		if (! hud.init(resourceDirectory))
 		{
-			std::cerr << "One or more shaders failed to compile... exiting!" << std::endl;
-			exit(1);
+			std::cerr << "Performance HUD unavailable" << std::endl;
 		}
-		prog->addUniform("P");
-		prog->addUniform("M");
-		prog->addUniform("V");
-		prog->addUniform("lightPos");
-		prog->addUniform("MatAmb");
-		prog->addUniform("MatDif");
-		prog->addUniform("MatSpec");
-		prog->addUniform("shine");
-		prog->addAttribute("vertPos");
-		prog->addAttribute("vertNor");
+
+		initLights();
 
 		//initialize the textures we might use
 		initTex(resourceDirectory);
+	}
 
-		texProg = make_shared<Program>();
-		texProg->setVerbose(true);
-		texProg->setShaderNames(
-			resourceDirectory + "/tex_vert.glsl",
-			resourceDirectory + "/tex_frag0.glsl");
-		if (! texProg->init())
+	void initLights()
+	{
+		lights.init();
+
+		// Above the gold goal, and moved along x by E and Q
+		LightSet::Light lamp;
+		lamp.position = vec3(-6.f, 5.f, 0.f);
+		movableLight = lights.add(lamp);
+
+		// Dim sun, so the far side of the field isn't black
+		LightSet::Light sun;
+		sun.position = vec3(1.f);
+		sun.color = vec3(.4f);
+		sun.directional = true;
+		sunLight = lights.add(sun);
+		shadows.init(shadowConfig);
+
+		// Same places every run, so runs compare
+		mt19937 rng(471);
+		uniform_real_distribution<float> alongPitch(-6.f, 16.f);
+		uniform_real_distribution<float> acrossPitch(-8.f, 4.f);
+		uniform_real_distribution<float> tint(.3f, 1.f);
+		for (int i = 0; i < floodlights; i++)
 		{
-			std::cerr << "One or more shaders failed to compile... exiting!" << std::endl;
-			exit(1);
+			LightSet::Light flood;
+			flood.position = vec3(alongPitch(rng), .5f, acrossPitch(rng));
+			flood.color = vec3(tint(rng), tint(rng), tint(rng));
+			flood.range = 3.f;
+			if (lights.add(flood) < 0)
+			{
+				break;
+			}
 		}
- 		texProg->addUniform("P");
-		texProg->addUniform("M");
-		texProg->addUniform("V");
-		texProg->addAttribute("vertPos");
-		texProg->addAttribute("vertNor");
-		texProg->addAttribute("vertTex");
-		texProg->addUniform("Texture0");
-
-		texProg1 = make_shared<Program>();
-		texProg1->setVerbose(true);
-		texProg1->setShaderNames(
-			resourceDirectory + "/tex_vert.glsl",
-			resourceDirectory + "/tex_frag1.glsl");
-		if (! texProg1->init())
+	}
+
+	shared_ptr<Program> submitProgram(const std::string &vShaderName, const std::string &fShaderName)
+	{
+		shared_ptr<Program> program = make_shared<Program>();
+		program->setVerbose(true);
+		program->setShaderNames(vShaderName, fShaderName);
+		program->submit();
+		pendingPrograms.push_back(program);
+		return program;
+	}
+
+	// Waits for the programs submitted in init, finishing each as soon as it
+	// is ready rather than in order, then looks up their variables
+	void finishPrograms()
+	{
+		while (! pendingPrograms.empty())
 		{
-			std::cerr << "One or more shaders failed to compile... exiting!" << std::endl;
-			exit(1);
+			bool finishedAny = false;
+			for (size_t i = 0; i < pendingPrograms.size(); )
+			{
+				if (pendingPrograms[i]->isReady())
+				{
+					if (! pendingPrograms[i]->finish())
+					{
+						std::cerr << "One or more shaders failed to compile... exiting!" << std::endl;
+						exit(1);
+					}
+					pendingPrograms.erase(pendingPrograms.begin() + i);
+					finishedAny = true;
+				}
+				else
+				{
+					i++;
+				}
+			}
+			if (! finishedAny)
+			{
+				std::this_thread::yield();
+			}
 		}
- 		texProg1->addUniform("P");
-		texProg1->addUniform("M");
-		texProg1->addUniform("V");
-		texProg1->addAttribute("vertPos");
-		texProg1->addAttribute("vertNor");
-		texProg1->addAttribute("vertTex");
-		texProg1->addUniform("Texture0");
 
-		// cube map
-		texProg2 = make_shared<Program>();
-		texProg2->setVerbose(true);
-		texProg2->setShaderNames(
-			resourceDirectory + "/cube_map_vert.glsl",
-			resourceDirectory + "/cube_map_frag.glsl");
-		if (! texProg2->init())
+		if (! surfaces.finish())
 		{
 			std::cerr << "One or more shaders failed to compile... exiting!" << std::endl;
 			exit(1);
 		}
+		setSampler(texProg, ballTexture);
+		setSampler(texProg1, fieldTexture);
+
+		// cube map
  		texProg2->addUniform("P");
 		texProg2->addUniform("M");
 		texProg2->addUniform("V");
 		texProg2->addAttribute("vertTex");
 
-		create_cube_map((resourceDirectory + "/sincity_ft.tga").c_str(), (resourceDirectory + "/sincity_bk.tga").c_str(), (resourceDirectory + "/sincity_up.tga").c_str(), 
-			(resourceDirectory + "/sincity_dn.tga").c_str(), (resourceDirectory + "/sincity_lf.tga").c_str(), (resourceDirectory + "/sincity_rt.tga").c_str(), cube_texture);
+		shaderWatcher.watch(texProg2->getVertexShaderName());
+		shaderWatcher.watch(texProg2->getFragmentShaderName());
+		shaderWatcher.watch(prog->getVertexShaderName());
+		shaderWatcher.watch(prog->getFragmentShaderName());
+	}
+
+	// Samplers never change unit, so set them once instead of per draw
+	void setSampler(const shared_ptr<Program> &program, const shared_ptr<Texture> &texture)
+	{
+		program->bind();
+		glUniform1i(program->getUniform("Texture0"), texture->getUnit());
+		program->unbind();
+	}
+
+	// Rebuilds the programs whose shader files were saved, and swaps in the
+	// ones that are ready; one that fails to build keeps running as it was
+	void reloadShaders()
+	{
+		vector<string> changed;
+		shaderWatcher.poll(changed);
+		for (const string &path : changed)
+		{
+			if (surfaces.usesShader(path))
+			{
+				surfaces.reload();
+			}
+			if (texProg2->usesShader(path))
+			{
+				texProg2->reload();
+			}
+		}
+		vector<shared_ptr<Program>> swapped;
+		surfaces.updateReload(swapped);
+		for (const shared_ptr<Program> &program : swapped)
+		{
+			if (program == texProg)
+			{
+				setSampler(program, ballTexture);
+			}
+			else if (program == texProg1)
+			{
+				setSampler(program, fieldTexture);
+			}
+		}
+		texProg2->updateReload();
+	}
+
+	// Reads foo.lod for foo.obj; none if meshbake hasn't been run
+	void loadLods(const string &objPath, vector<MeshLOD::Mesh> &lods)
+	{
+		string err;
+		if (! MeshLOD::read(MeshLOD::fileNameFor(objPath), lods, err) && ! err.empty())
+		{
+			cerr << MeshLOD::fileNameFor(objPath) << ": " << err << endl;
+		}
+	}
+
+	void addLods(const shared_ptr<Shape> &shape, const vector<MeshLOD::Mesh> &lods, size_t i)
+	{
+		if (i < lods.size() && ! shape->setLods(lods[i]))
+		{
+			cerr << "Levels of detail baked from an older mesh, ignored; run meshbake again" << endl;
+		}
 	}
 
 	void initGeom(const std::string& resourceDirectory)
@@ -468,11 +621,14 @@ public:
 		// this is the tiny obj shapes - not to be confused with our shapes
 		vector<tinyobj::shape_t> TOshapes;
 		vector<tinyobj::material_t> objMaterials;
+		// Levels of detail of the file's shapes, if baked
+		vector<MeshLOD::Mesh> lods;
 
 		string errStr;
 		//load in the mesh and make the shapes
 		bool rc = tinyobj::LoadObj(TOshapes, objMaterials, errStr,
 						(resourceDirectory + "/tinker.obj").c_str());
+		loadLods(resourceDirectory + "/tinker.obj", lods);
 
 		if (!rc)
 		{
@@ -489,6 +645,7 @@ public:
 			{
 				goal = make_shared<Shape>();
 				goal->createShape(TOshapes[i]);
+				addLods(goal, lods, i);
 				goal->measure();
 				goal->init();
 
@@ -547,24 +704,19 @@ public:
 			// manually set goal bounding sphere
 			vec3 goldGoalCenter = vec3(-6.0, .4, -1.9);
 
-			GoldGoal->Position.x = goldGoalCenter.x;
-			GoldGoal->Position.y = goldGoalCenter.y;
-			GoldGoal->Position.z = goldGoalCenter.z;
-
-			GoldGoal->Radius = 1.f;
+			entities.setPosition(GoldGoal, goldGoalCenter);
+			entities.setRadius(GoldGoal, 1.f);
 
 			vec3 blueGoalCenter = vec3(16.0, .4, -1.9);
 
-			BlueGoal->Position.x = blueGoalCenter.x;
-			BlueGoal->Position.y = blueGoalCenter.y;
-			BlueGoal->Position.z = blueGoalCenter.z;
-
-			BlueGoal->Radius = 1.f;
+			entities.setPosition(BlueGoal, blueGoalCenter);
+			entities.setRadius(BlueGoal, 1.f);
 		}
 
 		//load in the mesh and make the shapes
 		rc = tinyobj::LoadObj(TOshapes, objMaterials, errStr,
 						(resourceDirectory + "/dummy.obj").c_str());
+		loadLods(resourceDirectory + "/dummy.obj", lods);
 
 		if (!rc)
 		{
@@ -590,6 +742,7 @@ public:
 
 				dummy = make_shared<Shape>();
 				dummy->createShape(TOshapes[i]);
+				addLods(dummy, lods, i);
 				dummy->measure();
 				dummy->init();
 
@@ -646,9 +799,11 @@ public:
 		// now read in the sphere for the world
 		rc = tinyobj::LoadObj(TOshapes, objMaterials, errStr,
 						(resourceDirectory + "/sphere.obj").c_str());
+		loadLods(resourceDirectory + "/sphere.obj", lods);
 
 		world = make_shared<Shape>();
 		world->createShape(TOshapes[0]);
+		addLods(world, lods, 0);
 		world->measure();
 		world->init();
 
@@ -672,34 +827,33 @@ public:
 
 		ballCenter = ballCenter + vec3(2, -.7f, -5);
 
-		Ball->Position.x = ballCenter.x;
-		Ball->Position.y = ballCenter.y;
-		Ball->Position.z = ballCenter.z;
-
-		Ball->Velocity.x = 1.0;
-		Ball->Velocity.y = 1.0;
-		Ball->Velocity.z = 1.0;
-
-		Ball->Radius = .5 * gDScale * .3;
+		entities.setPosition(Ball, ballCenter);
+		ballPhysics.params.groundY = ballCenter.y;
+		entities.setRadius(Ball, .5 * gDScale * .3);
 
 		dummyRightFoot = DummyShapes[26];
 
-		Foot->Position.x = gDummyScale * (dummyRightFoot->max.x - dummyRightFoot->min.x) / 2.0;
-		Foot->Position.y = gDummyScale * (dummyRightFoot->max.y - dummyRightFoot->min.y) / 2.0;
-		Foot->Position.z = gDummyScale * (dummyRightFoot->max.z - dummyRightFoot->min.z) / 2.0;
+		entities.setPosition(Foot, gDummyScale * (dummyRightFoot->max - dummyRightFoot->min) / 2.0f);
 
 		// Initial translation
-		Foot->Position.x += 1;
-		Foot->Position.z -= 1;
+		entities.translate(Foot, vec3(1, 0, -1));
+
+		entities.setRadius(Foot, gDummyScale * (dummyRightFoot->max.x - dummyRightFoot->min.x));
 
-		Foot->Radius = (gDummyScale * (dummyRightFoot->max.x - dummyRightFoot->min.x)); 
+		broadPhase.setMargin(KICK_RANGE);
+		broadPhase.add(Ball);
+		broadPhase.add(Foot);
+		broadPhase.add(GoldGoal);
+		broadPhase.add(BlueGoal);
 
 		// now read in the sphere for the world
 		rc = tinyobj::LoadObj(TOshapes, objMaterials, errStr,
 						(resourceDirectory + "/exclamationPoint.obj").c_str());
+		loadLods(resourceDirectory + "/exclamationPoint.obj", lods);
 
 		exclamationPoint = make_shared<Shape>();
 		exclamationPoint->createShape(TOshapes[0]);
+		addLods(exclamationPoint, lods, 0);
 		exclamationPoint->measure();
 		exclamationPoint->init();
 
@@ -752,13 +906,13 @@ public:
 
 		
 		glGenBuffers(1, &vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, vbo);
 		glBufferData(GL_ARRAY_BUFFER, 3 * 36 * sizeof(float), &points, GL_STATIC_DRAW);
 
 		glGenVertexArrays(1, &vao);
-		glBindVertexArray(vao);
+		GLState::bindVertexArray(vao);
 		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, vbo);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
 	}
 
@@ -794,130 +948,208 @@ public:
 
 		unsigned short idx[] = {0, 1, 2, 0, 2, 3};
 
-		GLuint VertexArrayID;
 		//generate the VAO
-		glGenVertexArrays(1, &VertexArrayID);
-		glBindVertexArray(VertexArrayID);
+		glGenVertexArrays(1, &GrndVAO);
+		GLState::bindVertexArray(GrndVAO);
 
 		gGiboLen = 6;
 		glGenBuffers(1, &GrndBuffObj);
-		glBindBuffer(GL_ARRAY_BUFFER, GrndBuffObj);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, GrndBuffObj);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(GrndPos), GrndPos, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
 		glGenBuffers(1, &GrndNorBuffObj);
-		glBindBuffer(GL_ARRAY_BUFFER, GrndNorBuffObj);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, GrndNorBuffObj);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(GrndNorm), GrndNorm, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
 		glGenBuffers(1, &GrndTexBuffObj);
-		glBindBuffer(GL_ARRAY_BUFFER, GrndTexBuffObj);
+		GLState::bindBuffer(GL_ARRAY_BUFFER, GrndTexBuffObj);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(GrndTex), GrndTex, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
 
 		glGenBuffers(1, &GIndxBuffObj);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GIndxBuffObj);
+		GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, GIndxBuffObj);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(idx), idx, GL_STATIC_DRAW);
 	}
 
-	void create_cube_map(
-	  const char* front,
-	  const char* back,
-	  const char* top,
-	  const char* bottom,
-	  const char* left,
-	  const char* right,
-	  GLuint* tex_cube) {
-	  // generate a cube-map texture to hold all the sides
-	  glActiveTexture(GL_TEXTURE0);
-	  glGenTextures(1, tex_cube);
-	  
-	  // load each image and copy into a side of the cube-map texture
-	  load_cube_map_side(*tex_cube, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z, front);
-	  load_cube_map_side(*tex_cube, GL_TEXTURE_CUBE_MAP_POSITIVE_Z, back);
-	  load_cube_map_side(*tex_cube, GL_TEXTURE_CUBE_MAP_POSITIVE_Y, top);
-	  load_cube_map_side(*tex_cube, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y, bottom);
-	  load_cube_map_side(*tex_cube, GL_TEXTURE_CUBE_MAP_NEGATIVE_X, right);
-	  load_cube_map_side(*tex_cube, GL_TEXTURE_CUBE_MAP_POSITIVE_X, left);
-	  // format cube map texture
-	  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	void renderGround()
+	{
+		// The attribute arrays were set up in the VAO once, by initQuad()
+		GLState::bindVertexArray(GrndVAO);
+
+		// draw!
+		glDrawElements(GL_TRIANGLES, gGiboLen, GL_UNSIGNED_SHORT, 0);
 	}
 
-	bool load_cube_map_side(
-	  GLuint texture, GLenum side_target, const char* file_name) {
-	  glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
-
-	  int x, y, n;
-	  int force_channels = 4;
-	  unsigned char*  image_data = stbi_load(
-	    file_name, &x, &y, &n, force_channels);
-	  if (!image_data) {
-	    fprintf(stderr, "ERROR: could not load %s\n", file_name);
-	    return false;
-	  }
-
-	  // non-power-of-2 dimensions check
-	  if ((x & (x - 1)) != 0 || (y & (y - 1)) != 0) {
-	    fprintf(stderr,
-	    	"WARNING: image %s is not power-of-2 dimensions\n",
-	    	file_name);
-	  }
-	  
-	  // copy image data into 'target' side of cube map
-	  glTexImage2D(
-	    side_target,
-	    0,
-	    GL_RGBA,
-	    x,
-	    y,
-	    0,
-	    GL_RGBA,
-	    GL_UNSIGNED_BYTE,
-	    image_data);
-	  free(image_data);
-
-	  return true;
+	void renderCubeMap() {
+		GLState::depthMask(GL_FALSE);
+		skybox->bind();
+		GLState::bindVertexArray(vao);
+		glDrawArrays(GL_TRIANGLES, 0, 36);
+		GLState::depthMask(GL_TRUE);
 	}
 
-	void renderGround()
+	// Tells the streamer how big each texture is on screen this frame
+	void requestTextures(int viewportHeight)
 	{
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, GrndBuffObj);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		// The ball texture wraps once around it, so its width is the circumference
+		vec3 ballPos = entities.getPosition(Ball);
+		ballPos.y = -.7f;
+		float ballSize = 2.f * 3.14159f * entities.getRadius(Ball);
+		streamer.request(ballTexture, TextureStreamer::projectedSize(ballSize, length(ballPos - eyeVector), FOV_Y, viewportHeight));
 
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, GrndNorBuffObj);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		// The field is seen at a grazing angle; use the nearest point below the eye
+		float fieldSize = 2.f * 20.f * gDScale * .7f;
+		float eyeHeight = fabs(eyeVector.y - (-1.5f * gDScale * .7f));
+		streamer.request(fieldTexture, TextureStreamer::projectedSize(fieldSize, eyeHeight, FOV_Y, viewportHeight));
 
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, GrndTexBuffObj);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
+		// Each sky face fills the screen vertically when looked at
+		streamer.request(skybox, TextureStreamer::projectedSize(2.f, 1.f, FOV_Y, viewportHeight));
 
-		// draw!
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GIndxBuffObj);
-		glDrawElements(GL_TRIANGLES, gGiboLen, GL_UNSIGNED_SHORT, 0);
+		streamer.update();
+	}
 
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
+	SimState captureState() const
+	{
+		SimState state;
+		state.playerPos = entities.getPosition(Player);
+		state.playerRotY = entities.getRotation(Player).y;
+		state.ballPos = entities.getPosition(Ball);
+		state.ballZRot = ballZRot;
+		state.limbRot = limbRot;
+		state.kickRot = kickRot;
+		return state;
 	}
 
-	void renderCubeMap() {
-		glDepthMask(GL_FALSE);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, *cube_texture);
-		glBindVertexArray(vao);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		glDepthMask(GL_TRUE);
+	// Advances the game by one fixed step of dt seconds. Everything that
+	// changes gameplay lives here, so it runs the same at any frame rate.
+	void simulate(float dt)
+	{
+		Profiler::CpuScope scope("simulate");
+
+		prevState = captureState();
+
+		entities.setSpeed(Player, (forwardHeld ? RUN_SPEED : 0.f) - (backHeld ? RUN_SPEED : 0.f));
+		entities.setTurnSpeed(Player, (rightHeld ? TURN_SPEED : 0.f) - (leftHeld ? TURN_SPEED : 0.f));
+		dummyMoving = forwardHeld || backHeld || leftHeld || rightHeld;
+		entities.move(dt);
+		if (dummyMoving) {
+			entities.setPosition(Foot, entities.getPosition(Player));
+		}
+		// The foot pushes the ball along at the player's pace
+		vec3 playerStep = entities.getLastStep(Player);
+		entities.setVelocity(Foot, dummyMoving ? playerStep / dt : vec3(0.f));
+
+		if (kickHeld) {
+			powerKick = true;
+
+			kickPower += KICK_CHARGE_RATE * dt;
+		}
+
+		broadPhase.update(entities);
+		broadPhase.findPairs(candidatePairs);
+		contacts.clear();
+		NarrowPhase::spheres(entities, candidatePairs, contacts, narrowBatch, KICK_RANGE);
+
+		if (releaseKick) {
+			// close enough to the ball: kick it the way the player is facing
+			if (powerKick && NarrowPhase::find(contacts, Foot, Ball)) {
+				float heading = radians(entities.getRotation(Player).y);
+				float kickSpeed = std::min(kickPower * KICK_SPEED_PER_POWER, ballPhysics.params.maxSpeed);
+				entities.setVelocity(Ball, kickSpeed * vec3(cos(heading), 0.f, sin(heading)));
+			}
+
+			// reset kick
+			releaseKick = false;
+
+			powerKick = false;
+
+			kickPower = 0.f;
+		}
+
+		// The broad phase margin (KICK_RANGE) is more than the ball can
+		// travel in a step at maxSpeed, so its candidates are everything it
+		// could run into
+		ballObstacles.clear();
+		for (const BroadPhase::Pair &pair : candidatePairs) {
+			if (pair.a == Ball || pair.b == Ball) {
+				BallPhysics::Obstacle obstacle;
+				obstacle.entity = pair.a == Ball ? pair.b : pair.a;
+				obstacle.solid = obstacle.entity != GoldGoal && obstacle.entity != BlueGoal;
+				ballObstacles.push_back(obstacle);
+			}
+		}
+		ballHits.clear();
+		ballPhysics.step(entities, Ball, ballObstacles, dt, ballHits);
+
+		goldGoalCollison = false;
+		blueGoalCollison = false;
+		for (const BallPhysics::Hit &hit : ballHits) {
+			goldGoalCollison = goldGoalCollison || hit.entity == GoldGoal;
+			blueGoalCollison = blueGoalCollison || hit.entity == BlueGoal;
+		}
+
+		ballMoving = length(entities.getVelocity(Ball)) > BALL_REST_SPEED;
+		if (ballMoving) {
+			ballZRot += BALL_SPIN_RATE * dt;
+		}
+
+		if (powerKick) {
+			kickRot += KICK_WINDUP_RATE * dt;
+		}
+		else {
+			kickRot = 0.f;
+		}
+
+		if (dummyMoving) {
+			if (limbRot > 20) {
+            	leftArmUp = false;
+	        }
+	        else if (limbRot < -20) {
+	            leftArmUp = true;
+	        }
+
+	        if (leftArmUp == true) {
+	            limbRot += LIMB_SWING_RATE * dt;
+	        }
+	        else {
+	            limbRot -= LIMB_SWING_RATE * dt;
+	        }
+		}
+		else {
+			// Reset dummy to just standing
+			limbRot = 0.0;
+			leftArmUp = false;
+		}
 	}
 
-	void render()
+	// alpha is how far between the last two simulation steps to draw, 0..1
+	void render(float alpha)
 	{
+		Profiler::CpuScope scope("render");
+		Profiler::PassTimer pass;
+		hud.update(glfwGetTime());
+		Shape::resetDrawStats();
+		reloadShaders();
+
+		SimState current = captureState();
+		SimState drawn;
+		drawn.playerPos = mix(prevState.playerPos, current.playerPos, alpha);
+		drawn.playerRotY = mix(prevState.playerRotY, current.playerRotY, alpha);
+		drawn.ballPos = mix(prevState.ballPos, current.ballPos, alpha);
+		drawn.ballZRot = mix(prevState.ballZRot, current.ballZRot, alpha);
+		drawn.limbRot = mix(prevState.limbRot, current.limbRot, alpha);
+		// The wind-up restarts from 0 on every kick, don't blend across that
+		drawn.kickRot = current.kickRot < prevState.kickRot ? current.kickRot : mix(prevState.kickRot, current.kickRot, alpha);
+
 		// Get current frame buffer size.
 		int width, height;
 		glfwGetFramebufferSize(windowManager->getHandle(), &width, &height);
-		glViewport(0, 0, width, height);
+		GLState::viewport(0, 0, width, height);
 
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
@@ -930,10 +1162,9 @@ public:
 		// Create the matrix stacks
 		auto P = make_shared<MatrixStack>();
 		auto M = make_shared<MatrixStack>();
-		auto V = make_shared<MatrixStack>();
 		// Apply perspective projection.
 		P->pushMatrix();
-		P->perspective(45.0f, aspect, 0.01f, 100.0f);
+		P->perspective(FOV_Y, aspect, 0.01f, 100.0f);
 
 		if (Moving)
 		{
@@ -968,25 +1199,17 @@ public:
 			lookAtVector.x = eyeVector.x + cos(theta) * cos(phi);
 			lookAtVector.y = eyeVector.y + sin(phi);
 			lookAtVector.z = eyeVector.z + cos(phi) * cos((3.14f / 2.0f) - theta);
-
-			glfwGetCursorPos(windowManager->getHandle(), &currX, &currY);
 		}
 
-		//Draw our scene - two meshes and ground plane
-		prog->bind();
-			// Send light position
-			glUniform3fv(prog->getUniform("lightPos"), 1, lightPos);
-	   		// View matrix for the camera
-		   	V->pushMatrix();
-			   	V->loadIdentity();
-
-			   	V->lookAt(eyeVector, lookAtVector, upVector);
+		requestTextures(height);
 
-			   	glUniformMatrix4fv(prog->getUniform("V"), 1, GL_FALSE, value_ptr(V->topMatrix()));
-			V->popMatrix();
+		pass.begin("lights");
+		view = lookAt(eyeVector, lookAtVector, upVector);
+		lights.upload(view, P->topMatrix(), width, height);
 
-
-			glUniformMatrix4fv(prog->getUniform("P"), 1, GL_FALSE, value_ptr(P->topMatrix()));
+		// Collect the opaque draws, then submit them sorted
+		opaque.clear();
+		int material = -1;
 
 			// Draw first goal post
 			M->pushMatrix();
@@ -999,13 +1222,12 @@ public:
 				M->scale(gGoalScale);
 				//MV->translate(-1.0f * gGoalTrans);
 				
-				SetMaterial(2, prog);
-				glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE,value_ptr(M->topMatrix()));
+				material = 2;
 				
 				for (size_t i = 0; i < GoalShapes.size(); i++)
 				{
 					goal = GoalShapes[i];
-					goal->draw(prog);
+					opaque.add(prog, goal, M->topMatrix(), material, false);
 				}
 
 			M->popMatrix();
@@ -1021,13 +1243,12 @@ public:
 				M->scale(gGoalScale);
 				//MV->translate(-1.0f * gGoalTrans);
 				
-				SetMaterial(0, prog);
-				glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE,value_ptr(M->topMatrix()));
+				material = 0;
 				
 				for (size_t i = 0; i < GoalShapes.size(); i++)
 				{
 					goal = GoalShapes[i];
-					goal->draw(prog);
+					opaque.add(prog, goal, M->topMatrix(), material, false);
 				}
 
 			M->popMatrix();
@@ -1037,13 +1258,13 @@ public:
 				M->loadIdentity();
 				M->rotate(radians(cTheta), vec3(0, 1, 0));
 
-				M->translate(vec3(Player->Position.x, -1.0, Player->Position.z));
+				M->translate(vec3(drawn.playerPos.x, -1.0, drawn.playerPos.z));
 
-				M->rotate(-radians(Player->RotY), vec3(0, 1, 0));
+				M->rotate(-radians(drawn.playerRotY), vec3(0, 1, 0));
 				
 				M->rotate(radians(-90.f), vec3(1, 0, 0));
 				
-				SetMaterial(5, prog);
+				material = 5;
 
 				//dummy model notes: 
 			    //dummy is 29 shapes
@@ -1082,7 +1303,7 @@ public:
                    		M->translate(vec3(0, -.57, 1.67));
 
 			            //make the arm move
-			            M->rotate(radians(-limbRot), vec3(0, 1, 0));
+			            M->rotate(radians(-drawn.limbRot), vec3(0, 1, 0));
 
 			            //put arm at side
 			            M->rotate(radians(-75.f), vec3(1, 0, 0));
@@ -1092,12 +1313,11 @@ public:
 
 			            M->scale(gDummyScale);
 
-			            glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
 
 			            for (size_t i = 6; i < 12; i++)
 						{
 							dummy = DummyShapes[i];
-							dummy->draw(prog);
+							opaque.add(prog, dummy, M->topMatrix(), material);
 						}
 
 			        M->popMatrix();
@@ -1109,7 +1329,7 @@ public:
                     	M->translate(vec3(0, .57, 1.67));
 
 	                    //make the arm move
-	                    M->rotate(radians(limbRot), vec3(0, 1, 0));
+	                    M->rotate(radians(drawn.limbRot), vec3(0, 1, 0));
 
 	                    //put arm at side
 	                    M->rotate(radians(75.f), vec3(1, 0, 0));
@@ -1119,27 +1339,26 @@ public:
 
 	                    M->scale(gDummyScale);
 
-	                    glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
 
 	                    //right arm: 12, 15, 18, 22, 27, 28
 
 	                    dummy = DummyShapes[12];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 
 						dummy = DummyShapes[15];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 
 						dummy = DummyShapes[18];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 	                    
 	                    dummy = DummyShapes[22];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 
 						dummy = DummyShapes[27];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 
 						dummy = DummyShapes[28];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 
 	                M->popMatrix();
 
@@ -1149,19 +1368,18 @@ public:
                     	M->translate(vec3(0, .07, 1.07));
 	                    
 	                    //rotate the hip joint
-	                    M->rotate(radians(limbRot), vec3(0, 1, 0));
+	                    M->rotate(radians(drawn.limbRot), vec3(0, 1, 0));
 	    
 	                    //move hip joint to origin
 	                    M->translate(vec3(0, -.07, -1.05));
 
 	                    M->scale(gDummyScale);
 
-	                    glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
 
 	                    for (size_t i = 0; i < 6; i++)
 						{
 							dummy = DummyShapes[i];
-							dummy->draw(prog);
+							opaque.add(prog, dummy, M->topMatrix(), material);
 						}
 	                    
 	                M->popMatrix();
@@ -1174,16 +1392,14 @@ public:
 	                    M->translate(vec3(0, -.07, 1.05));
 
 	                    if (powerKick) {
-	                    	kickRot += 1.f;
 	                    	// powering kick
-	                    	if (kickRot < 350.f) {
-	                    		M->rotate(radians(-limbRot + kickRot) / 5.f, vec3(0, 1, 0));
+	                    	if (drawn.kickRot < 350.f) {
+	                    		M->rotate(radians(-drawn.limbRot + drawn.kickRot) / 5.f, vec3(0, 1, 0));
 	                    	}
 	                    }
 	                    else {
-	                    	kickRot = 0.f;
 	                    	//rotate the hip joint
-	                    	M->rotate(radians(-limbRot), vec3(0, 1, 0));
+	                    	M->rotate(radians(-drawn.limbRot), vec3(0, 1, 0));
 	                    }	                  
 	    
 	                    //move hip joint to origin
@@ -1191,16 +1407,15 @@ public:
 
 	                    M->scale(gDummyScale);
 
-	                    glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
 
 	                    dummy = DummyShapes[14];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 
 						dummy = DummyShapes[16];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 
 						dummy = DummyShapes[25];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 
 	                M->popMatrix();
 
@@ -1211,16 +1426,13 @@ public:
 	                    M->translate(vec3(0, -.07, 1.05));
 	                    	                    
 	                    if (powerKick) {
-	                    	kickRot += 1.f;
 	                    	// powering kick
-	                    	if (kickRot < 350.f) {
-	                    		M->rotate(radians(-limbRot + kickRot) / 5.f, vec3(0, 1, 0));
+	                    	if (drawn.kickRot < 350.f) {
+	                    		M->rotate(radians(-drawn.limbRot + drawn.kickRot) / 5.f, vec3(0, 1, 0));
 	                    	}
 	                    }
 	                    else {
-	                    	kickRot = 0.f;
-
-	                    	M->rotate(radians(-limbRot), vec3(0, 1, 0));
+	                    	M->rotate(radians(-drawn.limbRot), vec3(0, 1, 0));
 	                    }	              
 	    
 	                    //move hip joint to origin
@@ -1228,14 +1440,13 @@ public:
 
 	                    M->scale(gDummyScale);
 
-	                    glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
 
 						// lower leg for kicking
 						dummy = DummyShapes[19];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 	                    
 	                    dummy = DummyShapes[20];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 	                M->popMatrix();
 
 	                // lower right foot for kicking
@@ -1245,14 +1456,13 @@ public:
 	                    M->translate(vec3(0, -.07, 1.05));
 	                    
 	                    //rotate the hip joint
-	                    M->rotate(radians(-limbRot), vec3(0, 1, 0));
+	                    M->rotate(radians(-drawn.limbRot), vec3(0, 1, 0));
 
 	                    if (powerKick) {
-	                    	kickRot += 1.f;
 	                    	// powering kick
 
-	                    	if (kickRot < 350.f) {
-	                    		M->rotate(radians(-limbRot + kickRot) / 5.f, vec3(0, 1, 0));
+	                    	if (drawn.kickRot < 350.f) {
+	                    		M->rotate(radians(-drawn.limbRot + drawn.kickRot) / 5.f, vec3(0, 1, 0));
 	                    	}	               
 	                    }	                  
 	    
@@ -1266,295 +1476,262 @@ public:
 
 	                    M->scale(gDummyScale);
 
-	                    glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
 
 						dummy = DummyShapes[26];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 
 	                M->popMatrix();
 
 	                //render rest of the body
 	                M->pushMatrix();	                
 	                    M->scale(gDummyScale);
-	                    glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
 
 	                    //head and neck: 13, 17
     					//torso and pelvis: 21, 23, 24
 	                    dummy = DummyShapes[13];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 
 						dummy = DummyShapes[17];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 
 						dummy = DummyShapes[21];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 	                    
 	                    dummy = DummyShapes[23];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 
 						dummy = DummyShapes[24];
-						dummy->draw(prog);
+						opaque.add(prog, dummy, M->topMatrix(), material);
 	                M->popMatrix();
 
 			    M->popMatrix();
 
 			M->popMatrix();
 
-		
-		prog->unbind();
-
-	
-		texProg->bind();
-			glUniformMatrix4fv(texProg->getUniform("P"), 1, GL_FALSE, value_ptr(P->topMatrix()));
-
-			// View matrix for the camera
-		   	V->pushMatrix();
-			   	V->loadIdentity();
-
-			   	V->lookAt(eyeVector, lookAtVector, upVector);
-
-			   	glUniformMatrix4fv(texProg->getUniform("V"), 1, GL_FALSE, value_ptr(V->topMatrix()));
-			V->popMatrix();
 
-			/* draw soccer ball */
-			M->pushMatrix();
-				M->loadIdentity();
-				M->rotate(radians(cTheta), vec3(0, 1, 0));
-					
-				Ball->currentSpeed = Player->currentSpeed;
-				Ball->currentTurnSpeed = Player->currentTurnSpeed;
+		/* soccer ball */
+		M->pushMatrix();
+			M->loadIdentity();
+			M->rotate(radians(cTheta), vec3(0, 1, 0));
 
-				bool collision = CheckCollision(*Ball, *Foot);
+			M->translate(vec3(drawn.ballPos.x, -.7, drawn.ballPos.z));
 
-				// close to the ball but not dribbling it / not colliding with it
-				if (GetDistance(*Foot, *Ball) <= (Foot->Radius + Ball->Radius + 1) && powerKick) {
+			M->rotate(radians(drawn.ballZRot), vec3(1, 0, 0));
 
-					if (releaseKick) {
+			M->scale(gDScale * .3);
+			opaque.add(texProg, world, M->topMatrix(), 0);
+		M->popMatrix();
 
-						ballMoving = true;
-
-						if (kickPower >= 0.0) {
-							// move in the direction the player is pointing
-							Ball->Position.x += 1.5f * Player->deltaX;
-					    	Ball->Position.z += 1.5f * Player->deltaZ;
-
-					    	kickPower -= 2.0;	
-						}
-						else {
-							// reset kick
-							releaseKick = false;
-
-							powerKick = false;
-
-							kickPower = 0.f;						
-						}
-					}
-					else {
-						ballMoving = false;
-					}
-				}
-
-				// collision detected
-				if (collision) {
-					// change the position as the player's position changes upon collision
-					Ball->Position.x += Player->deltaX;
-					Ball->Position.z += Player->deltaZ;
-
-					ballMoving = true;
-				}
-				else {
-					if (! releaseKick) {
-						ballMoving = false;
-					}
-				}
-
-				// add collision detection
-
-				M->translate(vec3(Ball->Position.x, -.7, Ball->Position.z));
-
-				if (ballMoving) {
-					ballZRot += 10.f;	
-				}
-				
-	            M->rotate(radians(ballZRot), vec3(1, 0, 0));
-
-				M->scale(gDScale * .3);
-				//M->translate(-1.0f * gDTrans);
-				texture1->bind(texProg->getUniform("Texture0"));
-				/*draw soccer ball*/
-				glUniformMatrix4fv(texProg->getUniform("M"), 1, GL_FALSE,value_ptr(M->topMatrix()));
-
-				world->draw(texProg);
-			M->popMatrix();
-		texProg->unbind();
-
-		texProg1->bind();
-			glUniformMatrix4fv(texProg1->getUniform("P"), 1, GL_FALSE, value_ptr(P->topMatrix()));
-
-			// View matrix for the camera
-		   	V->pushMatrix();
-			   	V->loadIdentity();
-
-			   	V->lookAt(eyeVector, lookAtVector, upVector);
-
-			   	glUniformMatrix4fv(texProg1->getUniform("V"), 1, GL_FALSE, value_ptr(V->topMatrix()));
-			V->popMatrix();
+		// Exclamation points over the goals
+		M->pushMatrix();
+			M->loadIdentity();
+			M->rotate(radians(cTheta), vec3(0, 1, 0));
+			M->translate(vec3(-6.0, 2.0, -1.9));
+			M->rotate(radians(-90.f), vec3(0, 1, 0));
+			M->scale(3.f);
+			if (goldGoalCollison) {
+				opaque.add(prog, exclamationPoint, M->topMatrix(), 2);
+			}
+		M->popMatrix();
+
+		M->pushMatrix();
+			M->loadIdentity();
+			M->rotate(radians(cTheta), vec3(0, 1, 0));
+			M->translate(vec3(16.0, 2.0, -1.9));
+			M->rotate(radians(-90.f), vec3(0, 1, 0));
+			M->scale(3.f);
+			if (blueGoalCollison) {
+				opaque.add(prog, exclamationPoint, M->topMatrix(), 0);
+			}
+		M->popMatrix();
+
+		// The ground is under everything, so it goes last either way
+		M->pushMatrix();
+			M->loadIdentity();
+			M->rotate(radians(cTheta), vec3(0, 1, 0));
+			M->translate(vec3(5, 0.f, -2));
+			M->scale(gDScale * .7);
+			M->translate(-1.0f * gDTrans);
+			mat4 groundModel = M->topMatrix();
+		M->popMatrix();
+
+		if (useLods)
+		{
+			opaque.pickLods(view, .5f * height * P->topMatrix()[1][1], lodPixels);
+		}
+		drawShadows(pass, P->topMatrix(), groundModel, width, height);
 
-			M->pushMatrix();
-				M->loadIdentity();
-				M->rotate(radians(cTheta), vec3(0, 1, 0));
-				M->pushMatrix();
-					M->translate(vec3(5, 0.f, -2));
-					M->scale(gDScale * .7);
-					M->translate(-1.0f * gDTrans);
-				glUniformMatrix4fv(texProg1->getUniform("M"), 1, GL_FALSE,value_ptr(M->topMatrix()));
-
-				/*draw the ground */
-				glUniformMatrix4fv(texProg->getUniform("M"), 1, GL_FALSE,value_ptr(M->topMatrix()));
-				texture0->bind(texProg->getUniform("Texture0"));
-				renderGround();
-			M->popMatrix();
-		texProg1->unbind();
+		opaque.sort(view, depthPrepass);
+		if (depthPrepass)
+		{
+			pass.begin("depth pre-pass");
+			drawDepth(P->topMatrix(), groundModel);
+		}
+		pass.begin("opaque");
+		drawOpaque(P->topMatrix(), groundModel);
 
+		// Last, at the far plane: only the pixels nothing covered shade it
+		pass.begin("sky");
 		texProg2->bind();
 			glUniformMatrix4fv(texProg2->getUniform("P"), 1, GL_FALSE, value_ptr(P->topMatrix()));
-
-			// View matrix for the camera
-		   	V->pushMatrix();
-			   	V->loadIdentity();
-
-			   	V->lookAt(eyeVector, lookAtVector, upVector);
-
-			   	glUniformMatrix4fv(texProg2->getUniform("V"), 1, GL_FALSE, value_ptr(V->topMatrix()));
-			V->popMatrix();
-
-			M->pushMatrix();
-				glUniformMatrix4fv(texProg2->getUniform("M"), 1, GL_FALSE,value_ptr(M->topMatrix()));
-			M->popMatrix();
-
+			glUniformMatrix4fv(texProg2->getUniform("V"), 1, GL_FALSE, value_ptr(view));
+			glUniformMatrix4fv(texProg2->getUniform("M"), 1, GL_FALSE, value_ptr(mat4(1.f)));
 			renderCubeMap();
 		texProg2->unbind();
 
-		bool goldGoalCollison = CheckCollision(*Ball, *GoldGoal);
-		bool blueGoalCollison = CheckCollision(*Ball, *BlueGoal);
-
-		// Draw exclamation point
-		prog->bind();
-			glUniformMatrix4fv(prog->getUniform("P"), 1, GL_FALSE, value_ptr(P->topMatrix()));
-
-			// View matrix for the camera
-		   	V->pushMatrix();
-			   	V->loadIdentity();
-
-			   	V->lookAt(eyeVector, lookAtVector, upVector);
-
-			   	glUniformMatrix4fv(prog->getUniform("V"), 1, GL_FALSE, value_ptr(V->topMatrix()));
-			V->popMatrix();
-
-			M->pushMatrix();
-
-				M->loadIdentity();
-
-				M->rotate(radians(cTheta), vec3(0, 1, 0));
-
-				M->translate(vec3(-6.0, 2.0, -1.9));
-				
-				M->rotate(radians(-90.f), vec3(0, 1, 0));
-
-				M->scale(3.f);
-				
-				SetMaterial(2, prog);
-				
-				glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE,value_ptr(M->topMatrix()));
-
-				if (goldGoalCollison) {
-					exclamationPoint->draw(prog);
-				}
-
-			M->popMatrix();
-		prog->unbind();
-
-		// Draw exclamation point
-		prog->bind();
-
-			glUniformMatrix4fv(prog->getUniform("P"), 1, GL_FALSE, value_ptr(P->topMatrix()));
-
-			// View matrix for the camera
-		   	V->pushMatrix();
-			   	V->loadIdentity();
-
-			   	V->lookAt(eyeVector, lookAtVector, upVector);
-
-			   	glUniformMatrix4fv(prog->getUniform("V"), 1, GL_FALSE, value_ptr(V->topMatrix()));
-			V->popMatrix();
-
-			M->pushMatrix();
-
-				M->loadIdentity();
-
-				M->rotate(radians(cTheta), vec3(0, 1, 0));
-
-				M->translate(vec3(16.0, 2.0, -1.9));
-				
-				M->rotate(radians(-90.f), vec3(0, 1, 0));
+		if (hud.isVisible())
+		{
+			pass.begin("hud");
+			const Shape::DrawStats &triangles = Shape::getDrawStats();
+			hud.draw(width, height, streamer.getStats().residentBytes, streamer.getBudget(), Shape::getResidentBytes(),
+				triangles.triangles, triangles.fullTriangles);
+			pass.end();
+		}
+		triangleTotals.triangles += Shape::getDrawStats().triangles;
+		triangleTotals.fullTriangles += Shape::getDrawStats().fullTriangles;
+		renderedFrames++;
 
-				M->scale(3.f);
-				
-				SetMaterial(0, prog);
-				
-				glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE,value_ptr(M->topMatrix()));
+		P->popMatrix();
+	}
 
-				if (blueGoalCollison) {
-					exclamationPoint->draw(prog);
-				}
+	// Sets M, and N for lit programs, whose lighting is in view space
+	void setModel(const shared_ptr<Program> &prog, const mat4 &model)
+	{
+		glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE, value_ptr(model));
+		GLint normalMatrix = prog->getUniform("N");
+		if (normalMatrix >= 0)
+		{
+			mat3 N = transpose(inverse(mat3(view * model)));
+			glUniformMatrix3fv(normalMatrix, 1, GL_FALSE, value_ptr(N));
+		}
+	}
 
-			M->popMatrix();
-		prog->unbind();
+	// Binds a program for the opaque draws, with this frame's camera
+	void bindForDraws(const shared_ptr<Program> &program, const mat4 &projection)
+	{
+		program->bind();
+		glUniformMatrix4fv(program->getUniform("P"), 1, GL_FALSE, value_ptr(projection));
+		glUniformMatrix4fv(program->getUniform("V"), 1, GL_FALSE, value_ptr(view));
+	}
 
-		P->popMatrix();
+	// Lays down the depth of every opaque draw, with the cheapest variant
+	// and no color writes
+	void drawDepth(const mat4 &projection, const mat4 &groundModel)
+	{
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		bindForDraws(depthProg, projection);
+		for (const DrawList::Item &item : opaque.getItems())
+		{
+			setModel(depthProg, item.model);
+			item.shape->draw(depthProg, item.lod);
+		}
+		setModel(depthProg, groundModel);
+		renderGround();
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	}
 
-		if (dummyMoving) {
-			if (limbRot > 20) {
-            	leftArmUp = false;
-	        }
-	        else if (limbRot < -20) {
-	            leftArmUp = true;
-	        }
+	// The sun's shadow maps: static casters only into the cascades that
+	// moved, then the dynamic ones over the cached layers
+	void drawShadows(Profiler::PassTimer &pass, const mat4 &projection, const mat4 &groundModel, int width, int height)
+	{
+		const LightSet::Light &sun = lights.get(sunLight);
+		shadows.update(view, projection, sun.position, lights.getDirectionalIndex(sunLight));
+		if (shadows.getCascadeCount() == 0)
+		{
+			return;
+		}
 
-	        if (leftArmUp == true) {
-	            limbRot += .4;
-	        }
-	        else {
-	            limbRot -= .4;
-	        }
+		depthProg->bind();
+		glUniformMatrix4fv(depthProg->getUniform("V"), 1, GL_FALSE, value_ptr(shadows.getLightView()));
+		bool staticPass = false;
+		for (int c = 0; c < shadows.getCascadeCount(); c++)
+		{
+			if (! shadows.needsStatic(c))
+			{
+				continue;
+			}
+			if (! staticPass)
+			{
+				pass.begin("static shadows");
+				staticPass = true;
+			}
+			shadows.beginStatic(c);
+			glUniformMatrix4fv(depthProg->getUniform("P"), 1, GL_FALSE, value_ptr(shadows.getProjection(c)));
+			drawCasters(false);
+			setModel(depthProg, groundModel);
+			renderGround();
 		}
-		else {
-			// Reset dummy to just standing
-			limbRot = 0.0;
-			leftArmUp = false;
+
+		pass.begin("dynamic shadows");
+		for (int c = 0; c < shadows.getCascadeCount(); c++)
+		{
+			shadows.beginDynamic(c);
+			glUniformMatrix4fv(depthProg->getUniform("P"), 1, GL_FALSE, value_ptr(shadows.getProjection(c)));
+			drawCasters(true);
 		}
+		shadows.end(width, height);
 	}
 
-	bool CheckCollision(GameObject &one, GameObject &two) // AABB - Circle collision
+	void drawCasters(bool dynamic)
 	{
-	    float dx = one.Position.x - two.Position.x;
-		float dy = one.Position.y - two.Position.y;
-		float dz = one.Position.z - two.Position.z;
-
-		float distance = sqrt(dx*dx + dy*dy + dz*dz);
-
-		return distance <= (one.Radius + two.Radius);
+		for (const DrawList::Item &item : opaque.getItems())
+		{
+			if (item.dynamic == dynamic)
+			{
+				setModel(depthProg, item.model);
+				// The cached static layers stay at full detail, whatever
+				// the view does
+				item.shape->draw(depthProg, dynamic ? item.lod : 0);
+			}
+		}
 	}
 
-	bool GetDistance(GameObject &one, GameObject &two) // AABB - Circle collision
+	// After a depth pre-pass only the visible fragments pass GL_LEQUAL, and
+	// there is no need to write depth again
+	void drawOpaque(const mat4 &projection, const mat4 &groundModel)
 	{
-	    float dx = one.Position.x - two.Position.x;
-		float dy = one.Position.y - two.Position.y;
-		float dz = one.Position.z - two.Position.z;
+		if (depthPrepass)
+		{
+			GLState::depthMask(GL_FALSE);
+		}
+		shared_ptr<Program> bound;
+		int material = -1;
+		for (const DrawList::Item &item : opaque.getItems())
+		{
+			if (item.program != bound)
+			{
+				bound = item.program;
+				bindForDraws(bound, projection);
+				material = -1;
+			}
+			if (item.material != material)
+			{
+				material = item.material;
+				if (bound == texProg)
+				{
+					// Textured draws are the ball's
+					ballTexture->bind();
+				}
+				else
+				{
+					SetMaterial(material, bound);
+				}
+			}
+			setModel(bound, item.model);
+			item.shape->draw(bound, item.lod);
+		}
 
-		float distance = sqrt(dx*dx + dy*dy + dz*dz);
+		bindForDraws(texProg1, projection);
+		glUniform3f(texProg1->getUniform("MatAmb"), .3f, .3f, .3f);
+		glUniform3f(texProg1->getUniform("MatDif"), 1.f, 1.f, 1.f);
+		glUniform3f(texProg1->getUniform("MatSpec"), 0.f, 0.f, 0.f);
+		glUniform1f(texProg1->getUniform("shine"), 1.f);
+		fieldTexture->bind();
+		setModel(texProg1, groundModel);
+		renderGround();
+		texProg1->unbind();
 
-		return distance;
+		GLState::depthMask(GL_TRUE);
 	}
 
 	// helper function to set materials for shading
@@ -1614,37 +1791,313 @@ int main(int argc, char **argv)
 	// Where the resources are loaded from
 	std::string resourceDir = "../resources";
 
-	if (argc >= 2)
+	size_t textureBudgetMB = 0;
+	// --uncapped turns vsync off. --headless renders to a hidden window.
+	// --fps=N advances the clock by exactly 1/N s per frame instead of
+	// reading it, so a run is reproducible however fast it actually goes.
+	bool uncapped = false;
+	bool headless = false;
+	double fixedFps = 0.0;
+	long long maxFrames = -1;
+	// --record=FILE logs all input; --replay=FILE plays such a log back
+	// headless, with the recorded frame times
+	std::string recordPath;
+	std::string replayPath;
+	// --profile prints per-pass timings on exit; --profile=FILE also writes
+	// them as a Chrome trace
+	bool profile = false;
+	std::string tracePath;
+	// --gl-calls counts GL calls and uploaded bytes per frame (C prints the
+	// last frame); --gl-calls=FILE also writes them per frame as CSV
+	bool countGLCalls = false;
+	std::string glCallsPath;
+	// Linked shader binaries are kept here between runs; --shader-cache=DIR
+	// moves it, --no-shader-cache always compiles
+	std::string shaderCacheDir = "shader_cache";
+	// --lights=N adds N coloured point lights over the pitch
+	int floodlights = 0;
+	// --depth-prepass lays down depth before shading anything (Z toggles)
+	bool depthPrepass = false;
+	// --shadow-size=N texels per cascade side, --cascades=N (0 for none)
+	ShadowMaps::Config shadowConfig;
+	// --no-lod draws every shape at full detail (O toggles); --lod-pixels=P
+	// is the largest error a level may have on screen
+	bool useLods = true;
+	float lodPixels = 1.f;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg.compare(0, 17, "--texture-budget=") == 0)
+		{
+			textureBudgetMB = std::stoul(arg.substr(17));
+		}
+		else if (arg == "--uncapped")
+		{
+			uncapped = true;
+		}
+		else if (arg == "--headless")
+		{
+			headless = true;
+		}
+		else if (arg.compare(0, 6, "--fps=") == 0)
+		{
+			fixedFps = std::stod(arg.substr(6));
+		}
+		else if (arg.compare(0, 9, "--frames=") == 0)
+		{
+			maxFrames = std::stoll(arg.substr(9));
+		}
+		else if (arg.compare(0, 9, "--record=") == 0)
+		{
+			recordPath = arg.substr(9);
+		}
+		else if (arg.compare(0, 9, "--replay=") == 0)
+		{
+			replayPath = arg.substr(9);
+		}
+		else if (arg == "--profile")
+		{
+			profile = true;
+		}
+		else if (arg.compare(0, 10, "--profile=") == 0)
+		{
+			profile = true;
+			tracePath = arg.substr(10);
+		}
+		else if (arg.compare(0, 15, "--shader-cache=") == 0)
+		{
+			shaderCacheDir = arg.substr(15);
+		}
+		else if (arg == "--no-shader-cache")
+		{
+			shaderCacheDir.clear();
+		}
+		else if (arg.compare(0, 9, "--lights=") == 0)
+		{
+			floodlights = std::stoi(arg.substr(9));
+		}
+		else if (arg == "--depth-prepass")
+		{
+			depthPrepass = true;
+		}
+		else if (arg.compare(0, 14, "--shadow-size=") == 0)
+		{
+			shadowConfig.resolution = std::stoi(arg.substr(14));
+		}
+		else if (arg.compare(0, 11, "--cascades=") == 0)
+		{
+			shadowConfig.cascades = std::stoi(arg.substr(11));
+		}
+		else if (arg == "--no-lod")
+		{
+			useLods = false;
+		}
+		else if (arg.compare(0, 13, "--lod-pixels=") == 0)
+		{
+			lodPixels = std::stof(arg.substr(13));
+		}
+		else if (arg == "--gl-calls")
+		{
+			countGLCalls = true;
+		}
+		else if (arg.compare(0, 11, "--gl-calls=") == 0)
+		{
+			countGLCalls = true;
+			glCallsPath = arg.substr(11);
+		}
+		else
+		{
+			resourceDir = arg;
+		}
+	}
+	InputLog inputLog;
+	if (! replayPath.empty())
+	{
+		if (! inputLog.load(replayPath))
+		{
+			return 1;
+		}
+		headless = true;
+		if (maxFrames < 0)
+		{
+			maxFrames = inputLog.getFrameCount();
+		}
+	}
+	if (headless && maxFrames < 0)
+	{
+		// Nobody can close a hidden window
+		maxFrames = 600;
+	}
+
+	if (profile)
 	{
-			resourceDir = argv[1];
+		Profiler::enable();
 	}
 
 	Application *application = new Application();
+	if (textureBudgetMB > 0)
+	{
+		application->streamer.setBudget(textureBudgetMB * 1024 * 1024);
+	}
+	application->floodlights = floodlights;
+	application->depthPrepass = depthPrepass;
+	application->shadowConfig = shadowConfig;
+	application->useLods = useLods;
+	application->lodPixels = lodPixels;
 
 	// Your main will always include a similar set up to establish your window
 	// and GL context, etc.
 
 	WindowManager *windowManager = new WindowManager();
-	windowManager->init(512, 512);
-	windowManager->setEventCallbacks(application);
+	windowManager->init(512, 512, ! headless);
+	windowManager->setVsync(! uncapped && ! headless);
 	application->windowManager = windowManager;
+	if (! shaderCacheDir.empty())
+	{
+		ProgramCache::enable(shaderCacheDir);
+	}
+	if (countGLCalls)
+	{
+		GLCalls::install();
+		if (! glCallsPath.empty())
+		{
+			GLCalls::openLog(glCallsPath);
+		}
+	}
+
+	// Input goes to the game directly, through the recorder, or (replaying)
+	// only from the log
+	std::unique_ptr<InputRecorder> recorder;
+	std::unique_ptr<InputReplayer> replayer;
+	if (! replayPath.empty())
+	{
+		replayer.reset(new InputReplayer(inputLog));
+	}
+	else if (! recordPath.empty())
+	{
+		recorder.reset(new InputRecorder(application, inputLog));
+		windowManager->setEventCallbacks(recorder.get());
+	}
+	else
+	{
+		windowManager->setEventCallbacks(application);
+	}
 
 	// This is the code that will likely change program to program as you
 	// may need to initialize or set up different data and state
 
-	application->init(resourceDir);
-	application->initGeom(resourceDir);
+	{
+		Profiler::CpuScope scope("init");
+		application->init(resourceDir);
+	}
+	{
+		Profiler::CpuScope scope("initGeom");
+		application->initGeom(resourceDir);
+	}
+	{
+		Profiler::CpuScope scope("finishPrograms");
+		application->finishPrograms();
+	}
+	ProgramCache::printStats(std::cout);
+	application->prevState = application->captureState();
+	// Loading gets a row of its own
+	GLCalls::endFrame();
+
+	// The game simulates at a fixed 60 Hz; frames render whenever they can
+	FixedTimestep timestep(1.0 / 60.0);
+	double lastTime = glfwGetTime();
+	long long frames = 0;
 
 	// Loop until the user closes the window.
-	while (! glfwWindowShouldClose(windowManager->getHandle()))
+	while (! glfwWindowShouldClose(windowManager->getHandle()) && frames != maxFrames)
 	{
+		Profiler::beginFrame();
+		double now = glfwGetTime();
+		double elapsed;
+		if (replayer)
+		{
+			// The recorded time as is: adding it to this run's clock and
+			// subtracting again would round it differently depending on
+			// when the run started, and change the steps it runs
+			elapsed = replayer->getFrameTime((uint32_t) frames);
+		}
+		else if (fixedFps > 0.0)
+		{
+			// Likewise exact, so every run steps the same
+			elapsed = 1.0 / fixedFps;
+		}
+		else
+		{
+			elapsed = now - lastTime;
+		}
+		lastTime = now;
+		if (recorder)
+		{
+			recorder->beginFrame(elapsed);
+		}
+		int steps = timestep.advance(elapsed);
+		for (int i = 0; i < steps; i++)
+		{
+			application->simulate((float) timestep.getStep());
+		}
+
 		// Render scene.
-		application->render();
+		application->render(timestep.getAlpha());
+		GLState::endFrame();
+		GLCalls::endFrame();
+		frames++;
 
 		// Swap front and back buffers.
-		glfwSwapBuffers(windowManager->getHandle());
+		{
+			Profiler::CpuScope scope("swap");
+			glfwSwapBuffers(windowManager->getHandle());
+		}
 		// Poll for and process events.
 		glfwPollEvents();
+		if (replayer)
+		{
+			replayer->deliver((uint32_t) (frames - 1), windowManager->getHandle(), application);
+		}
+		Profiler::endFrame();
+	}
+
+	if (profile)
+	{
+		Profiler::finish();
+		Profiler::printSummary(std::cout);
+		if (! tracePath.empty() && Profiler::writeChromeTrace(tracePath))
+		{
+			std::cout << "Wrote trace to " << tracePath << std::endl;
+		}
+	}
+
+	if (countGLCalls)
+	{
+		GLCalls::printSummary(std::cout);
+		GLCalls::closeLog();
+	}
+
+	if (recorder)
+	{
+		recorder->finish();
+		inputLog.save(recordPath);
+		std::cout << "Recorded " << inputLog.getFrameCount() << " frames, " << inputLog.getEvents().size() << " input events to " << recordPath << std::endl;
+	}
+
+	application->streamer.printStats(std::cout);
+	if (application->renderedFrames > 0)
+	{
+		const Shape::DrawStats &totals = application->triangleTotals;
+		std::cout << "Triangles per frame: " << totals.triangles / application->renderedFrames << " submitted, "
+			<< totals.fullTriangles / application->renderedFrames << " at full detail" << std::endl;
+	}
+	if (headless)
+	{
+		vec3 player = application->entities.getPosition(application->Player);
+		vec3 ball = application->entities.getPosition(application->Ball);
+		std::cout << frames << " frames, " << timestep.getTicks() << " simulation steps; player at ("
+			<< player.x << ", " << player.z << "), ball at (" << ball.x << ", " << ball.z << ")" << std::endl;
 	}
 
 	// Quit program.
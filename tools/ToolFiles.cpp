@@ -0,0 +1,45 @@
+#include "ToolFiles.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+namespace ToolFiles
+{
+
+std::vector<std::string> listDirectory(const std::string &dir)
+{
+	std::vector<std::string> names;
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	HANDLE h = FindFirstFileA((dir + "\\*").c_str(), &data);
+	if (h != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			names.push_back(data.cFileName);
+		} while (FindNextFileA(h, &data));
+		FindClose(h);
+	}
+#else
+	DIR *d = opendir(dir.c_str());
+	if (d)
+	{
+		while (struct dirent *e = readdir(d))
+		{
+			names.push_back(e->d_name);
+		}
+		closedir(d);
+	}
+#endif
+	return names;
+}
+
+bool endsWith(const std::string &s, const std::string &suffix)
+{
+	return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#ifndef LAB471_TOOLFILES_H_INCLUDED
+#define LAB471_TOOLFILES_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+
+/**
+ * File name helpers shared by the offline tools (texbake, meshbake), which
+ * both walk the resources directory for their inputs.
+ */
+
+namespace ToolFiles
+{
+
+	// Names of the entries in dir, "." and ".." included; empty if it can't
+	// be read
+	std::vector<std::string> listDirectory(const std::string &dir);
+
+	bool endsWith(const std::string &s, const std::string &suffix);
+
+}
+
+#endif // LAB471_TOOLFILES_H_INCLUDED
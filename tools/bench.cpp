@@ -0,0 +1,579 @@
+/**
+ * bench - repeatable engine benchmarks with JSON output
+ *
+ * Runs a fixed set of scenarios and writes one JSON document with the
+ * timings of each, to compare builds against each other:
+ *
+ *   mesh_load/<file>        parse an OBJ and upload its shapes (ms)
+ *   texture_decode/<file>   decode an image with stb_image (ms)
+ *   render/dummies_<N>      N dummies along a fixed camera path (ms per frame,
+ *                           CPU submit + glFinish)
+ *   render/lights_<N>       128 dummies lit by N point lights scattered
+ *                           over them (ms per frame)
+ *   render/lod_dummies_<N>  N dummies at the level of detail their size on
+ *                           screen allows (ms per frame; needs meshbake)
+ *   render/.../triangles    triangles submitted per frame by each of those
+ *   lights/bin_<N>          binning N point lights into the light clusters
+ *                           (ms per frame)
+ *   collision/<N>           broad + narrow phase over N moving spheres (ms
+ *                           per tick)
+ *
+ *   bench <resource dir> [--out=FILE] [--filter=TEXT] [--frames=N] [--repeat=N]
+ *
+ *   --out     Write the JSON here instead of stdout
+ *   --filter  Only run scenarios whose name contains TEXT
+ *   --frames  Frames per render scenario (default 240)
+ *   --repeat  Runs of each load/decode scenario (default 5)
+ *
+ * Mesh loading and rendering need a GL context, from a hidden window; without
+ * one only the CPU scenarios run.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+
+#include <glad/glad.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "stb_image.h"
+#include "tiny_obj_loader.h"
+#include "GLSL.h"
+#include "GLState.h"
+#include "Program.h"
+#include "ShaderVariants.h"
+#include "LightSet.h"
+#include "LightClusters.h"
+#include "MeshLOD.h"
+#include "Shape.h"
+#include "WindowManager.h"
+#include "EntityStore.h"
+#include "BroadPhase.h"
+#include "NarrowPhase.h"
+
+using namespace std;
+using namespace glm;
+
+
+struct Options
+{
+	string resourceDir;
+	string outPath;
+	string filter;
+	int frames = 240;
+	int repeat = 5;
+};
+
+struct Result
+{
+	string name;
+	string unit;
+	vector<double> samples;
+};
+
+static double now()
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool selected(const Options &options, const string &name)
+{
+	return options.filter.empty() || name.find(options.filter) != string::npos;
+}
+
+// Loads an OBJ into initialized shapes; returns false if it can't be read
+static bool loadMesh(const string &path, vector<shared_ptr<Shape>> &shapes, vec3 &min, vec3 &max)
+{
+	vector<tinyobj::shape_t> objShapes;
+	vector<tinyobj::material_t> materials;
+	string errors;
+	if (! tinyobj::LoadObj(objShapes, materials, errors, path.c_str()))
+	{
+		cerr << errors << endl;
+		return false;
+	}
+	// Baked levels of detail, if any
+	vector<MeshLOD::Mesh> lods;
+	MeshLOD::read(MeshLOD::fileNameFor(path), lods, errors);
+	min = vec3(numeric_limits<float>::max());
+	max = vec3(-numeric_limits<float>::max());
+	shapes.clear();
+	for (tinyobj::shape_t &objShape : objShapes)
+	{
+		shared_ptr<Shape> shape = make_shared<Shape>();
+		shape->createShape(objShape);
+		if (shapes.size() < lods.size())
+		{
+			shape->setLods(lods[shapes.size()]);
+		}
+		shape->measure();
+		shape->init();
+		min = glm::min(min, shape->min);
+		max = glm::max(max, shape->max);
+		shapes.push_back(shape);
+	}
+	return true;
+}
+
+static void benchMeshLoad(const Options &options, vector<Result> &results)
+{
+	const char *files[] = {"dummy.obj", "tinker.obj", "sphere.obj", "soccer_ball.obj"};
+	for (const char *file : files)
+	{
+		Result result;
+		result.name = string("mesh_load/") + file;
+		result.unit = "ms";
+		if (! selected(options, result.name))
+		{
+			continue;
+		}
+		for (int i = 0; i < options.repeat; i++)
+		{
+			vector<shared_ptr<Shape>> shapes;
+			vec3 min, max;
+			double start = now();
+			if (! loadMesh(options.resourceDir + "/" + file, shapes, min, max))
+			{
+				break;
+			}
+			glFinish();
+			result.samples.push_back(now() - start);
+		}
+		results.push_back(result);
+	}
+}
+
+static void benchTextureDecode(const Options &options, vector<Result> &results)
+{
+	const char *files[] = {"soccer_field.jpg", "soccer_texture.jpg", "sincity_ft.tga"};
+	for (const char *file : files)
+	{
+		Result result;
+		result.name = string("texture_decode/") + file;
+		result.unit = "ms";
+		if (! selected(options, result.name))
+		{
+			continue;
+		}
+		for (int i = 0; i < options.repeat; i++)
+		{
+			int width, height, channels;
+			double start = now();
+			unsigned char *data = stbi_load((options.resourceDir + "/" + file).c_str(), &width, &height, &channels, 0);
+			double elapsed = now() - start;
+			if (! data)
+			{
+				cerr << "Could not decode " << file << endl;
+				break;
+			}
+			stbi_image_free(data);
+			result.samples.push_back(elapsed);
+		}
+		results.push_back(result);
+	}
+}
+
+struct RenderScenario
+{
+	string name;
+	int dummies;
+	int lights;
+	bool lod;
+};
+
+// Lights scattered over the crowd, each reaching a few dummies around it
+static void placeLights(LightSet &lights, int count, float extent)
+{
+	mt19937 rng(471);
+	uniform_real_distribution<float> place(-.5f * extent, .5f * extent);
+	uniform_real_distribution<float> hue(.2f, 1.f);
+	lights.clear();
+	for (int i = 0; i < count; i++)
+	{
+		LightSet::Light light;
+		light.position = vec3(place(rng), 1.f, place(rng));
+		light.color = vec3(hue(rng), hue(rng), hue(rng));
+		light.range = 3.f;
+		lights.add(light);
+	}
+}
+
+static void benchRender(const Options &options, WindowManager &window, vector<Result> &results)
+{
+	vector<RenderScenario> scenarios;
+	const int crowds[] = {1, 16, 128, 1024};
+	for (int n : crowds)
+	{
+		scenarios.push_back({"render/dummies_" + to_string(n), n, 1, false});
+	}
+	// Same crowd, more lights: the per-light cost of the lit shader
+	const int lightCounts[] = {1, 8, 64, 256, LightSet::MAX_LIGHTS};
+	for (int n : lightCounts)
+	{
+		scenarios.push_back({"render/lights_" + to_string(n), 128, n, false});
+	}
+	// Big crowds, far away: what levels of detail save
+	const int lodCrowds[] = {128, 1024};
+	for (int n : lodCrowds)
+	{
+		scenarios.push_back({"render/lod_dummies_" + to_string(n), n, 1, true});
+	}
+	bool any = false;
+	for (const RenderScenario &scenario : scenarios)
+	{
+		any = any || selected(options, scenario.name);
+	}
+	if (! any)
+	{
+		return;
+	}
+
+	// The game's variant for the dummies
+	ShaderVariants surfaces;
+	surfaces.setTemplate(options.resourceDir + "/surface_vert.glsl", options.resourceDir + "/surface_frag.glsl");
+	shared_ptr<Program> prog = surfaces.get(ShaderVariants::LIT);
+	if (! surfaces.finish())
+	{
+		return;
+	}
+	LightSet lights;
+	lights.init();
+
+	vector<shared_ptr<Shape>> dummy;
+	vec3 min, max;
+	if (! loadMesh(options.resourceDir + "/dummy.obj", dummy, min, max))
+	{
+		return;
+	}
+	// Unit height, standing on y = 0
+	float scale = 1.f / (max.y - min.y);
+	mat4 fit = glm::scale(mat4(1.f), vec3(scale)) * translate(mat4(1.f), vec3(-(min.x + max.x) / 2.f, -min.y, -(min.z + max.z) / 2.f));
+
+	int width, height;
+	glfwGetFramebufferSize(window.getHandle(), &width, &height);
+	GLState::viewport(0, 0, width, height);
+	glEnable(GL_DEPTH_TEST);
+	glClearColor(.12f, .34f, .56f, 1.f);
+
+	for (const RenderScenario &scenario : scenarios)
+	{
+		Result result;
+		result.name = scenario.name;
+		result.unit = "ms";
+		if (! selected(options, result.name))
+		{
+			continue;
+		}
+		Result triangles;
+		triangles.name = scenario.name + "/triangles";
+		triangles.unit = "triangles";
+
+		// A square crowd, one unit apart
+		int n = scenario.dummies;
+		int side = (int) std::ceil(std::sqrt((float) n));
+		float extent = (float) side;
+		mat4 P = perspective(radians(45.f), width / (float) height, .1f, 4.f * extent + 10.f);
+		if (scenario.lights == 1)
+		{
+			lights.clear();
+			LightSet::Light light;
+			light.position = vec3(2.f, 10.f, 2.f);
+			lights.add(light);
+		}
+		else
+		{
+			placeLights(lights, scenario.lights, extent);
+		}
+		// Each dummy part's level, kept between frames for hysteresis
+		vector<int> lodStates(n * dummy.size(), 0);
+		float pixelsPerUnit = .5f * height * P[1][1] * scale;
+
+		const int warmup = 10;
+		for (int frame = -warmup; frame < options.frames; frame++)
+		{
+			double start = now();
+			Shape::resetDrawStats();
+
+			// Circle the crowd once over the run, from the same start every time
+			float angle = 6.2831853f * std::max(frame, 0) / options.frames;
+			vec3 eye(std::cos(angle) * (extent + 2.f), .5f * extent + 1.f, std::sin(angle) * (extent + 2.f));
+			mat4 V = lookAt(eye, vec3(0.f), vec3(0.f, 1.f, 0.f));
+			lights.upload(V, P, width, height);
+
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			prog->bind();
+			glUniformMatrix4fv(prog->getUniform("P"), 1, GL_FALSE, value_ptr(P));
+			glUniformMatrix4fv(prog->getUniform("V"), 1, GL_FALSE, value_ptr(V));
+			glUniform3f(prog->getUniform("MatAmb"), .13f, .13f, .14f);
+			glUniform3f(prog->getUniform("MatDif"), .3f, .3f, .4f);
+			glUniform3f(prog->getUniform("MatSpec"), .3f, .3f, .4f);
+			glUniform1f(prog->getUniform("shine"), 4.f);
+			for (int i = 0; i < n; i++)
+			{
+				vec3 at((i % side) - (side - 1) / 2.f, 0.f, (i / side) - (side - 1) / 2.f);
+				mat4 M = translate(mat4(1.f), at) * fit;
+				mat3 N = transpose(inverse(mat3(V * M)));
+				glUniformMatrix4fv(prog->getUniform("M"), 1, GL_FALSE, value_ptr(M));
+				glUniformMatrix3fv(prog->getUniform("N"), 1, GL_FALSE, value_ptr(N));
+				float distance = std::max(length(eye - at - vec3(0.f, .5f, 0.f)) - .5f, 1e-3f);
+				for (size_t j = 0; j < dummy.size(); j++)
+				{
+					int &lod = lodStates[i * dummy.size() + j];
+					if (scenario.lod)
+					{
+						lod = dummy[j]->pickLod(pixelsPerUnit / distance, 1.f, lod);
+					}
+					dummy[j]->draw(prog, lod);
+				}
+			}
+			prog->unbind();
+			glFinish();
+
+			if (frame >= 0)
+			{
+				result.samples.push_back(now() - start);
+				triangles.samples.push_back((double) Shape::getDrawStats().triangles);
+			}
+			glfwSwapBuffers(window.getHandle());
+		}
+		results.push_back(result);
+		results.push_back(triangles);
+	}
+}
+
+static void benchLightBinning(const Options &options, vector<Result> &results)
+{
+	const int counts[] = {1, 16, 64, 256, LightSet::MAX_LIGHTS};
+	LightClusters clusters;
+	clusters.setProjection(perspective(radians(45.f), 16.f / 9.f, .1f, 100.f));
+	for (int n : counts)
+	{
+		Result result;
+		result.name = "lights/bin_" + to_string(n);
+		result.unit = "ms";
+		if (! selected(options, result.name))
+		{
+			continue;
+		}
+
+		// Spread through the first 40 units of the view, reaching 3 each
+		mt19937 rng(471);
+		uniform_real_distribution<float> across(-1.f, 1.f);
+		uniform_real_distribution<float> depth(1.f, 40.f);
+		vector<vec4> spheres;
+		for (int i = 0; i < n; i++)
+		{
+			float z = depth(rng);
+			spheres.push_back(vec4(across(rng) * z * .7f, across(rng) * z * .4f, -z, 3.f));
+		}
+
+		for (int i = 0; i < options.frames; i++)
+		{
+			double start = now();
+			clusters.build(spheres, 0);
+			result.samples.push_back(now() - start);
+		}
+		results.push_back(result);
+	}
+}
+
+static void benchCollision(const Options &options, vector<Result> &results)
+{
+	const int counts[] = {1000, 10000, 100000};
+	const int ticks = 60;
+	const float radius = .5f;
+	for (int n : counts)
+	{
+		Result result;
+		result.name = "collision/" + to_string(n);
+		result.unit = "ms";
+		if (! selected(options, result.name))
+		{
+			continue;
+		}
+
+		// Same layout every run
+		mt19937 rng(471);
+		float half = .5f * std::sqrt(n * 16.f);
+		uniform_real_distribution<float> place(-half, half);
+		uniform_real_distribution<float> speed(-3.f, 3.f);
+
+		EntityStore store;
+		store.reserve(n);
+		BroadPhase broadPhase(vec2(-half), vec2(half), 4.f * radius);
+		for (int i = 0; i < n; i++)
+		{
+			Entity e = store.create();
+			store.setPosition(e, vec3(place(rng), 0.f, place(rng)));
+			store.setVelocity(e, vec3(speed(rng), 0.f, speed(rng)));
+			store.setRadius(e, radius);
+			broadPhase.add(e);
+		}
+		broadPhase.update(store);
+
+		vector<BroadPhase::Pair> pairs;
+		vector<NarrowPhase::Contact> contacts;
+		NarrowPhase::Batch batch;
+		for (int tick = 0; tick < ticks; tick++)
+		{
+			store.integrate(1.f / 60.f);
+			double start = now();
+			broadPhase.update(store);
+			broadPhase.findPairs(pairs);
+			contacts.clear();
+			NarrowPhase::spheres(store, pairs, contacts, batch);
+			result.samples.push_back(now() - start);
+		}
+		results.push_back(result);
+	}
+}
+
+static string escape(const string &s)
+{
+	string out;
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+		}
+		if ((unsigned char) c >= 0x20)
+		{
+			out += c;
+		}
+	}
+	return out;
+}
+
+static void writeJson(ostream &out, const vector<Result> &results, bool hasGL)
+{
+	const char *renderer = hasGL ? (const char *) glGetString(GL_RENDERER) : nullptr;
+	const char *version = hasGL ? (const char *) glGetString(GL_VERSION) : nullptr;
+
+	out << fixed << setprecision(4);
+	out << "{" << endl;
+	out << "  \"gl_renderer\": \"" << escape(renderer ? renderer : "") << "\"," << endl;
+	out << "  \"gl_version\": \"" << escape(version ? version : "") << "\"," << endl;
+	out << "  \"results\": [";
+	for (size_t r = 0; r < results.size(); r++)
+	{
+		const Result &result = results[r];
+		vector<double> sorted = result.samples;
+		sort(sorted.begin(), sorted.end());
+		double sum = 0.0;
+		for (double v : sorted)
+		{
+			sum += v;
+		}
+		size_t n = sorted.size();
+
+		out << (r == 0 ? "\n" : ",\n") << "    {\"name\": \"" << escape(result.name) << "\", \"unit\": \"" << result.unit
+			<< "\", \"samples\": " << n;
+		if (n > 0)
+		{
+			out << ", \"min\": " << sorted.front() << ", \"median\": " << sorted[n / 2]
+				<< ", \"p95\": " << sorted[std::min(n - 1, (size_t) std::ceil(.95 * n) - 1)]
+				<< ", \"mean\": " << sum / n << ", \"max\": " << sorted.back();
+		}
+		out << "}";
+	}
+	out << endl << "  ]" << endl << "}" << endl;
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg.compare(0, 6, "--out=") == 0)
+		{
+			options.outPath = arg.substr(6);
+		}
+		else if (arg.compare(0, 9, "--filter=") == 0)
+		{
+			options.filter = arg.substr(9);
+		}
+		else if (arg.compare(0, 9, "--frames=") == 0)
+		{
+			options.frames = std::max(1, atoi(arg.c_str() + 9));
+		}
+		else if (arg.compare(0, 9, "--repeat=") == 0)
+		{
+			options.repeat = std::max(1, atoi(arg.c_str() + 9));
+		}
+		else if (arg[0] != '-' && options.resourceDir.empty())
+		{
+			options.resourceDir = arg;
+		}
+		else
+		{
+			cerr << "usage: " << argv[0] << " <resource dir> [--out=FILE] [--filter=TEXT] [--frames=N] [--repeat=N]" << endl;
+			return 1;
+		}
+	}
+	if (options.resourceDir.empty())
+	{
+		options.resourceDir = "../resources";
+	}
+
+	// The window prints the GL version to stdout, where the JSON goes
+	WindowManager window;
+	streambuf *stdoutBuffer = cout.rdbuf(cerr.rdbuf());
+	bool hasGL = window.init(640, 480, false);
+	cout.rdbuf(stdoutBuffer);
+	if (hasGL)
+	{
+		window.setVsync(false);
+	}
+	else
+	{
+		cerr << "No GL context, skipping mesh_load and render" << endl;
+	}
+
+	vector<Result> results;
+	if (hasGL)
+	{
+		benchMeshLoad(options, results);
+	}
+	benchTextureDecode(options, results);
+	if (hasGL)
+	{
+		benchRender(options, window, results);
+	}
+	benchLightBinning(options, results);
+	benchCollision(options, results);
+
+	if (options.outPath.empty())
+	{
+		writeJson(cout, results, hasGL);
+	}
+	else
+	{
+		ofstream out(options.outPath.c_str());
+		writeJson(out, results, hasGL);
+		if (! out)
+		{
+			cerr << "Could not write " << options.outPath << endl;
+			return 1;
+		}
+		cerr << "Wrote " << results.size() << " results to " << options.outPath << endl;
+	}
+	if (hasGL)
+	{
+		window.shutdown();
+	}
+	return 0;
+}
@@ -0,0 +1,217 @@
+/**
+ * broadphase_bench - scaling benchmark for the uniform-grid broad phase
+ *
+ * Scatters N moving spheres over a pitch whose area grows with N (so the
+ * density matches a crowded match) and times BroadPhase::update() plus
+ * findPairs() per tick, against testing every pair, for N from 10 to 100k.
+ * The brute-force column is skipped above --brute-max entities since it is
+ * quadratic; where both run, the overlap counts are checked against each other.
+ * The candidates go through NarrowPhase::spheres, timed next to the one-sqrt-
+ * per-pair test it replaced.
+ *
+ *   broadphase_bench [--ticks=N] [--brute-max=N] [--seed=N]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+
+#include "EntityStore.h"
+#include "BroadPhase.h"
+#include "NarrowPhase.h"
+
+using namespace std;
+using namespace glm;
+
+
+struct Options
+{
+	int ticks = 30;
+	int bruteMax = 10000;
+	unsigned seed = 471;
+};
+
+static const float RADIUS = .5f;
+// Pitch area per entity, in square units
+static const float AREA_PER_ENTITY = 16.f;
+static const float DT = 1.f / 60.f;
+
+static double now()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool overlaps(const EntityStore &store, size_t i, size_t j)
+{
+	float dx = store.posX[i] - store.posX[j];
+	float dy = store.posY[i] - store.posY[j];
+	float dz = store.posZ[i] - store.posZ[j];
+	float r = store.radius[i] + store.radius[j];
+	return dx * dx + dy * dy + dz * dz <= r * r;
+}
+
+// The old CheckCollision, building the same contact on a hit, for comparison
+static bool contactSqrt(const EntityStore &store, const BroadPhase::Pair &pair, vector<NarrowPhase::Contact> &contacts)
+{
+	size_t i = store.indexOf(pair.a);
+	size_t j = store.indexOf(pair.b);
+	vec3 d(store.posX[j] - store.posX[i], store.posY[j] - store.posY[i], store.posZ[j] - store.posZ[i]);
+	float distance = sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+	float r = store.radius[i] + store.radius[j];
+	if (distance > r)
+	{
+		return false;
+	}
+	NarrowPhase::Contact contact;
+	contact.a = pair.a;
+	contact.b = pair.b;
+	contact.normal = distance > 0.f ? d / distance : vec3(0.f, 1.f, 0.f);
+	contact.depth = r - distance;
+	contacts.push_back(contact);
+	return true;
+}
+
+static int bruteForce(const EntityStore &store)
+{
+	int hits = 0;
+	for (size_t i = 0; i < store.size(); i++)
+	{
+		for (size_t j = i + 1; j < store.size(); j++)
+		{
+			hits += overlaps(store, i, j);
+		}
+	}
+	return hits;
+}
+
+static void run(int n, const Options &options)
+{
+	mt19937 rng(options.seed);
+	float half = .5f * sqrt(n * AREA_PER_ENTITY);
+	uniform_real_distribution<float> place(-half, half);
+	uniform_real_distribution<float> speed(-3.f, 3.f);
+
+	EntityStore store;
+	store.reserve(n);
+	BroadPhase broadPhase(vec2(-half), vec2(half), 4.f * RADIUS);
+	for (int i = 0; i < n; i++)
+	{
+		Entity e = store.create();
+		store.setPosition(e, vec3(place(rng), 0.f, place(rng)));
+		store.setVelocity(e, vec3(speed(rng), 0.f, speed(rng)));
+		store.setRadius(e, RADIUS);
+		broadPhase.add(e);
+	}
+
+	vector<BroadPhase::Pair> pairs;
+	vector<NarrowPhase::Contact> contacts;
+	vector<NarrowPhase::Contact> sqrtContacts;
+	NarrowPhase::Batch batch;
+	double gridTime = 0.0;
+	double narrowTime = 0.0;
+	double sqrtTime = 0.0;
+	double refiled = 0.0;
+	int hits = 0;
+
+	// The first update files everything; time the steady state after it
+	broadPhase.update(store);
+	for (int tick = 0; tick < options.ticks; tick++)
+	{
+		store.integrate(DT);
+
+		double start = now();
+		broadPhase.update(store);
+		broadPhase.findPairs(pairs);
+		gridTime += now() - start;
+		refiled += broadPhase.getStats().refiled;
+
+		// Both tests gather the same positions; warm the cache first so neither
+		// pays for the misses alone
+		sqrtContacts.clear();
+		for (size_t p = 0; p < pairs.size(); p++)
+		{
+			contactSqrt(store, pairs[p], sqrtContacts);
+		}
+
+		start = now();
+		contacts.clear();
+		NarrowPhase::spheres(store, pairs, contacts, batch);
+		narrowTime += now() - start;
+		hits = (int) contacts.size();
+
+		start = now();
+		sqrtContacts.clear();
+		for (size_t p = 0; p < pairs.size(); p++)
+		{
+			contactSqrt(store, pairs[p], sqrtContacts);
+		}
+		sqrtTime += now() - start;
+		if (sqrtContacts.size() != contacts.size())
+		{
+			cerr << "narrow phase found " << hits << " contacts, sqrt test " << sqrtContacts.size() << endl;
+		}
+	}
+	gridTime /= options.ticks;
+	narrowTime /= options.ticks;
+	sqrtTime /= options.ticks;
+	refiled /= options.ticks;
+
+	cout << setw(8) << n << setw(12) << fixed << setprecision(3) << gridTime * 1000.0
+		<< setw(12) << narrowTime * 1000.0 << setw(12) << sqrtTime * 1000.0 << setw(12) << pairs.size() << setw(10) << hits << setw(11) << setprecision(1) << 100.0 * refiled / n << "%";
+
+	if (n <= options.bruteMax)
+	{
+		double start = now();
+		int bruteHits = bruteForce(store);
+		double bruteTime = now() - start;
+		cout << setw(12) << setprecision(3) << bruteTime * 1000.0;
+		if (bruteHits != hits)
+		{
+			cout << "  MISMATCH (" << bruteHits << " overlaps)";
+		}
+	}
+	else
+	{
+		cout << setw(12) << "-";
+	}
+	cout << endl;
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], "--ticks=", 8) == 0)
+		{
+			options.ticks = max(1, atoi(argv[i] + 8));
+		}
+		else if (strncmp(argv[i], "--brute-max=", 12) == 0)
+		{
+			options.bruteMax = atoi(argv[i] + 12);
+		}
+		else if (strncmp(argv[i], "--seed=", 7) == 0)
+		{
+			options.seed = (unsigned) strtoul(argv[i] + 7, nullptr, 10);
+		}
+		else
+		{
+			cerr << "usage: " << argv[0] << " [--ticks=N] [--brute-max=N] [--seed=N]" << endl;
+			return 1;
+		}
+	}
+
+	cout << setw(8) << "entities" << setw(12) << "grid ms" << setw(12) << "narrow ms" << setw(12) << "sqrt ms" << setw(12) << "candidates" << setw(10) << "overlaps"
+		<< setw(12) << "refiled" << setw(12) << "brute ms" << endl;
+	const int counts[] = {10, 100, 1000, 10000, 100000};
+	for (int n : counts)
+	{
+		run(n, options);
+	}
+	return 0;
+}
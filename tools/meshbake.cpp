@@ -0,0 +1,196 @@
+/**
+ * meshbake - offline level-of-detail builder
+ *
+ * Loads every OBJ in the resources directory and simplifies each of its
+ * shapes with MeshSimplifier into successively coarser levels, written to a
+ * .lod file next to the OBJ. At startup Shape picks these up and the game
+ * draws a coarser level the smaller a shape is on screen.
+ *
+ * It also reports how well each OBJ uses a 16 entry vertex cache, in file
+ * order and after the reordering Shape does at load (MeshOptimizer): ACMR,
+ * vertices transformed per triangle, and ATVR, per distinct vertex. Then
+ * overdraw, fragments shaded per pixel covered, seen along the axes.
+ *
+ *   meshbake <resource dir> [--levels=N] [--ratio=R] [--force]
+ *
+ *   --levels  Levels below the full mesh (default 3)
+ *   --ratio   Triangles kept from one level to the next, in (0, 1)
+ *             (default 0.5)
+ *   --force   Rebuild even if the .lod is newer than its OBJ
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#include "tiny_obj_loader.h"
+#include "MeshLOD.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ToolFiles.h"
+
+using namespace std;
+
+
+struct Options
+{
+	int levels = 3;
+	float ratio = .5f;
+	bool force = false;
+};
+
+// Below this a level is not worth having
+static const size_t MIN_TRIANGLES = 8;
+
+static bool isUpToDate(const string &output, const string &input)
+{
+	struct stat out, in;
+	return stat(output.c_str(), &out) == 0 && stat(input.c_str(), &in) == 0 && in.st_mtime <= out.st_mtime;
+}
+
+// Vertex cache use and overdraw of the full meshes, as loaded and as Shape
+// reorders them
+static void report(const string &input, const vector<tinyobj::shape_t> &shapes)
+{
+	MeshOptimizer::CacheStats before, after;
+	MeshOptimizer::OverdrawStats overdrawBefore, overdrawAfter;
+	for (const tinyobj::shape_t &shape : shapes)
+	{
+		const tinyobj::mesh_t &mesh = shape.mesh;
+		size_t vertexCount = mesh.positions.size() / 3;
+		before += MeshOptimizer::analyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+		overdrawBefore += MeshOptimizer::analyzeOverdraw(mesh.indices.data(), mesh.indices.size(), mesh.positions);
+
+		vector<unsigned int> indices = mesh.indices;
+		vector<size_t> clusters;
+		vector<unsigned int> remap;
+		MeshOptimizer::optimizeVertexCache(indices.data(), indices.size(), vertexCount, MeshOptimizer::CACHE_SIZE, &clusters);
+		MeshOptimizer::optimizeOverdraw(indices.data(), indices.size(), mesh.positions, clusters);
+		// The overdraw doesn't depend on vertex numbering
+		overdrawAfter += MeshOptimizer::analyzeOverdraw(indices.data(), indices.size(), mesh.positions);
+		MeshOptimizer::optimizeVertexFetch(indices, vertexCount, remap);
+		after += MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertexCount);
+	}
+	cout << "cache       " << input << fixed << setprecision(3)
+		<< " (ACMR " << before.acmr() << " -> " << after.acmr()
+		<< ", ATVR " << before.atvr() << " -> " << after.atvr()
+		<< ", overdraw " << overdrawBefore.overdraw() << " -> " << overdrawAfter.overdraw() << ")" << endl;
+	cout.unsetf(ios::fixed);
+}
+
+static bool bake(const string &input, const Options &opts)
+{
+	vector<tinyobj::shape_t> shapes;
+	vector<tinyobj::material_t> materials;
+	string errors;
+	if (! tinyobj::LoadObj(shapes, materials, errors, input.c_str()))
+	{
+		cerr << "could not load " << input << ": " << errors << endl;
+		return false;
+	}
+	report(input, shapes);
+
+	string output = MeshLOD::fileNameFor(input);
+	if (! opts.force && isUpToDate(output, input))
+	{
+		cout << "up to date  " << output << endl;
+		return true;
+	}
+
+	vector<MeshLOD::Mesh> meshes;
+	// Triangles of all shapes at each level, for the summary
+	vector<size_t> totals(opts.levels + 1, 0);
+	vector<float> errorsAt(opts.levels + 1, 0.f);
+	for (const tinyobj::shape_t &shape : shapes)
+	{
+		const tinyobj::mesh_t &mesh = shape.mesh;
+		MeshLOD::Mesh baked;
+		baked.vertexCount = (unsigned int) (mesh.positions.size() / 3);
+		baked.indexCount = (unsigned int) mesh.indices.size();
+
+		size_t triangles = mesh.indices.size() / 3;
+		totals[0] += triangles;
+		MeshSimplifier simplifier(mesh.positions, mesh.normals, mesh.texcoords, mesh.indices);
+		for (int level = 1; level <= opts.levels; level++)
+		{
+			size_t target = (size_t) (triangles * opts.ratio);
+			if (target < MIN_TRIANGLES)
+			{
+				break;
+			}
+			MeshLOD::Level lod;
+			lod.error = simplifier.simplify(target, lod.indices);
+			// Stuck well short of the target: no better than the last level
+			size_t reached = lod.indices.size() / 3;
+			if (reached > triangles - (triangles - target) / 2)
+			{
+				break;
+			}
+			triangles = reached;
+			totals[level] += triangles;
+			errorsAt[level] = std::max(errorsAt[level], lod.error);
+			baked.levels.push_back(lod);
+		}
+		meshes.push_back(baked);
+	}
+
+	if (! MeshLOD::write(output, meshes))
+	{
+		cerr << "could not write " << output << endl;
+		return false;
+	}
+	cout << "baked       " << output << " (" << shapes.size() << " shape(s), triangles " << totals[0];
+	for (int level = 1; level <= opts.levels && totals[level] > 0; level++)
+	{
+		cout << " / " << totals[level] << " (error " << setprecision(3) << errorsAt[level] << ")";
+	}
+	cout << ")" << endl;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	string dir = "../resources";
+	Options opts;
+
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg.compare(0, 9, "--levels=") == 0)
+		{
+			opts.levels = std::max(std::stoi(arg.substr(9)), 1);
+		}
+		else if (arg.compare(0, 8, "--ratio=") == 0)
+		{
+			opts.ratio = std::stof(arg.substr(8));
+		}
+		else if (arg == "--force")
+		{
+			opts.force = true;
+		}
+		else
+		{
+			dir = arg;
+		}
+	}
+	// At 1 or more no level would be smaller than the last (and the stuck
+	// check in bake() would underflow); NaN fails both tests
+	if (! (opts.ratio > 0.f && opts.ratio < 1.f))
+	{
+		cerr << "--ratio must be between 0 and 1, exclusive" << endl;
+		return 1;
+	}
+
+	bool ok = true;
+	for (const string &name : ToolFiles::listDirectory(dir))
+	{
+		if (ToolFiles::endsWith(name, ".obj"))
+		{
+			ok &= bake(dir + "/" + name, opts);
+		}
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,227 @@
+/**
+ * texbake - offline texture preprocessor
+ *
+ * Decodes every texture in the resources directory once, flips it into
+ * OpenGL row order, builds the full mip chain and writes a KTX file next to
+ * the source image. At startup Texture::init and the skybox loader map these
+ * files and upload them directly instead of decoding JPEG/TGA data.
+ *
+ *   texbake <resource dir> [--kaiser] [--bc1] [--force]
+ *
+ *   --kaiser  Kaiser-windowed mip filter instead of the SSE2 box filter
+ *   --bc1     Block-compress to BC1 (4 bpp). Needs EXT_texture_compression_s3tc
+ *             at runtime; otherwise the runtime falls back to the source image.
+ *   --force   Rebuild even if the .ktx is newer than its source
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <sys/stat.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include "ImageMips.h"
+#include "KTX.h"
+#include "ToolFiles.h"
+
+using namespace std;
+
+
+struct Options
+{
+	ImageMips::Filter filter = ImageMips::BOX;
+	bool bc1 = false;
+	bool force = false;
+};
+
+static bool fileExists(const string &path)
+{
+	struct stat st;
+	return stat(path.c_str(), &st) == 0;
+}
+
+static bool isUpToDate(const string &output, const vector<string> &inputs)
+{
+	struct stat out;
+	if (stat(output.c_str(), &out) != 0)
+	{
+		return false;
+	}
+	for (const string &in : inputs)
+	{
+		struct stat st;
+		if (stat(in.c_str(), &st) != 0 || st.st_mtime > out.st_mtime)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Holds the encoded bytes for each level/face so the KTX image can point at them
+struct EncodedImage
+{
+	KTX::Image image;
+	vector<vector<unsigned char>> storage;
+};
+
+static bool encodeFaces(const vector<string> &faceFiles, const Options &opts, EncodedImage &out)
+{
+	vector<vector<ImageMips::Level>> chains;
+	for (const string &file : faceFiles)
+	{
+		int w, h, n;
+		// Flip into GL row order, matching the stbi path in Texture::init
+		stbi_set_flip_vertically_on_load(true);
+		unsigned char *rgba = stbi_load(file.c_str(), &w, &h, &n, 4);
+		if (! rgba)
+		{
+			cerr << "could not decode " << file << endl;
+			return false;
+		}
+		chains.push_back(vector<ImageMips::Level>());
+		ImageMips::buildChain(rgba, w, h, opts.filter, chains.back());
+		stbi_image_free(rgba);
+
+		if (chains.back()[0].width != chains[0][0].width || chains.back()[0].height != chains[0][0].height)
+		{
+			cerr << file << " does not match the size of " << faceFiles[0] << endl;
+			return false;
+		}
+	}
+
+	KTX::Image &image = out.image;
+	image.width = chains[0][0].width;
+	image.height = chains[0][0].height;
+	image.faces = (int) chains.size();
+	if (opts.bc1)
+	{
+		image.glType = 0;
+		image.glFormat = 0;
+		image.glInternalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	}
+	else
+	{
+		image.glType = GL_UNSIGNED_BYTE;
+		image.glFormat = GL_RGB;
+		image.glInternalFormat = GL_RGB8;
+	}
+	image.glBaseInternalFormat = GL_RGB;
+
+	// Encode everything first; storage must not reallocate once we take pointers
+	size_t levelCount = chains[0].size();
+	out.storage.reserve(levelCount * chains.size());
+	for (size_t level = 0; level < levelCount; level++)
+	{
+		for (size_t face = 0; face < chains.size(); face++)
+		{
+			const ImageMips::Level &src = chains[face][level];
+			out.storage.push_back(opts.bc1 ? ImageMips::compressBC1(src) : ImageMips::toPaddedRGB(src));
+		}
+	}
+	for (size_t level = 0; level < levelCount; level++)
+	{
+		KTX::Level lvl;
+		lvl.width = chains[0][level].width;
+		lvl.height = chains[0][level].height;
+		lvl.faceSize = out.storage[level * chains.size()].size();
+		for (size_t face = 0; face < chains.size(); face++)
+		{
+			lvl.faces.push_back(out.storage[level * chains.size() + face].data());
+		}
+		image.levels.push_back(lvl);
+	}
+	return true;
+}
+
+static bool bake(const vector<string> &inputs, const string &output, const Options &opts)
+{
+	if (! opts.force && isUpToDate(output, inputs))
+	{
+		cout << "up to date  " << output << endl;
+		return true;
+	}
+
+	EncodedImage encoded;
+	if (! encodeFaces(inputs, opts, encoded))
+	{
+		return false;
+	}
+	if (! KTX::write(output, encoded.image))
+	{
+		cerr << "could not write " << output << endl;
+		return false;
+	}
+
+	size_t bytes = 0;
+	for (const vector<unsigned char> &s : encoded.storage)
+	{
+		bytes += s.size();
+	}
+	cout << "baked       " << output << " (" << encoded.image.width << "x" << encoded.image.height
+		<< ", " << encoded.image.faces << " face(s), " << encoded.image.levels.size() << " levels, "
+		<< KTX::formatName(encoded.image.glInternalFormat) << ", " << bytes / 1024 << " KiB)" << endl;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	string dir = "../resources";
+	Options opts;
+
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if (arg == "--kaiser")
+		{
+			opts.filter = ImageMips::KAISER;
+		}
+		else if (arg == "--bc1")
+		{
+			opts.bc1 = true;
+		}
+		else if (arg == "--force")
+		{
+			opts.force = true;
+		}
+		else
+		{
+			dir = arg;
+		}
+	}
+
+	bool ok = true;
+	for (const string &name : ToolFiles::listDirectory(dir))
+	{
+		// 2D textures: foo.jpg -> foo.ktx
+		if (ToolFiles::endsWith(name, ".jpg") || ToolFiles::endsWith(name, ".png"))
+		{
+			string stem = name.substr(0, name.find_last_of('.'));
+			ok &= bake({ dir + "/" + name }, dir + "/" + stem + ".ktx", opts);
+		}
+		// Skyboxes: foo_{lf,rt,up,dn,bk,ft}.tga -> foo.ktx cube map, in
+		// KTX face order (+X, -X, +Y, -Y, +Z, -Z) as create_cube_map binds them
+		else if (ToolFiles::endsWith(name, "_ft.tga"))
+		{
+			string prefix = dir + "/" + name.substr(0, name.size() - strlen("_ft.tga"));
+			vector<string> faces = {
+				prefix + "_lf.tga", prefix + "_rt.tga", prefix + "_up.tga",
+				prefix + "_dn.tga", prefix + "_bk.tga", prefix + "_ft.tga"
+			};
+			bool complete = true;
+			for (const string &f : faces)
+			{
+				complete &= fileExists(f);
+			}
+			if (complete)
+			{
+				ok &= bake(faces, prefix + ".ktx", opts);
+			}
+		}
+	}
+
+	return ok ? 0 : 1;
+}